@@ -0,0 +1,481 @@
+#pragma once
+
+typedef struct AotFunction AotFunction;
+
+// Ahead of time backend. Every function in Program->functions is written out as a C function with the
+// JitFunction signature, where stack slots and locals are C locals and jumps are labels, and gcc builds
+// it into a standalone program. The generated file includes main.c, so the script is still compiled at
+// startup to set up globals, constants and natives. aot_install then swaps in the generated functions,
+// which call each other through jit_call like JIT code does. Slots are written back to the VM stack at
+// calls and at loop safepoints, which is where the collector looks for them, and read again after since
+// young objects move.
+
+struct AotFunction {
+    JitFunction code;
+    uint64 hash; // Of the bytecode it was generated from
+};
+
+// Set by the generated program before it runs main.c's main
+AotFunction* _aot_functions = NULL;
+size_t _aot_function_count = 0;
+Program* _aot_program = NULL;
+
+// Where main.c is, the generated file is built with it on the include path. build.bat passes the absolute
+// path, so -aot works from any directory.
+#ifndef CYNEP_SOURCE_DIR
+#define CYNEP_SOURCE_DIR "."
+#endif
+
+#pragma region GENERATED_CODE
+
+// Used by the generated functions, same fast paths as the interpreter
+#define AOT_ADD(op1, op2) (IS_NUMBER(op1) && IS_NUMBER(op2) ? NUMBER_VAL(AS_C_DOUBLE(op1) + AS_C_DOUBLE(op2)) : VM_Add(op1, op2))
+#define AOT_ARITHMETIC(op1, operation, op2) NUMBER_VAL(AS_C_DOUBLE(op1) operation AS_C_DOUBLE(op2))
+#define AOT_COMPARE(opcode, op1, operation, op2) \
+    (IS_NUMBER(op1) && IS_NUMBER(op2) ? AS_C_DOUBLE(op1) operation AS_C_DOUBLE(op2) : VM_Compare(opcode, op1, op2))
+#define AOT_BOOL(condition) ((condition) ? TRUE_VAL : FALSE_VAL)
+
+RuntimeValue AOT_GetMember(RuntimeValue instance_value, uint64 index){
+    TypeInstanceObject instance = AS_TYPEINSTANCE(instance_value);
+    return Member_Get(&instance, index).value;
+}
+
+#pragma endregion
+
+#pragma region TRANSLATION
+
+static uint64 _aot_hash(FunctionObject* fn){
+    return hash_bytes((char*)fn->code, array_length(fn->code));
+}
+
+static char* _aot_compare_operator(uint8_t opcode){
+    switch (opcode)
+    {
+        case OP_LT: return "<";
+        case OP_GT: return ">";
+        case OP_LE: return "<=";
+        case OP_GE: return ">=";
+        case OP_EQ: return "==";
+        case OP_NE: return "!=";
+    }
+
+    return NULL;
+}
+
+// Change in stack depth, for the instructions that do not end the function
+static int64 _aot_stack_effect(uint8_t opcode, uint64 operand){
+    switch (opcode)
+    {
+        case OP_CONST:
+        case OP_GET_GLOBAL:
+        case OP_GET_LOCAL:
+        case OP_ADD_LOCAL_CONST:
+        case OP_CONST_SET_LOCAL:
+            return 1;
+
+        case OP_LOAD_LOCAL2:
+            return 2;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_LT:
+        case OP_GT:
+        case OP_LE:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE:
+        case OP_JMP_IF_FALSE:
+        case OP_POP:
+        case OP_STORE_LOCAL:
+        case OP_STORE_GLOBAL:
+            return -1;
+
+        case OP_JMP_IF_NOT_LT:
+        case OP_JMP_IF_NOT_GT:
+        case OP_JMP_IF_NOT_LE:
+        case OP_JMP_IF_NOT_GE:
+        case OP_JMP_IF_NOT_EQ:
+        case OP_JMP_IF_NOT_NE:
+            return -2;
+
+        case OP_SCOPE_EXIT:
+        case OP_CALL:
+            return -(int64)operand; // A call pops the callee and arguments and pushes the result
+
+        default:
+            return 0;
+    }
+}
+
+// Numbers, null, booleans and short strings are written as literals so gcc can fold them, objects are read
+// at runtime
+static void _aot_constant(FILE* out, FunctionObject* fn, uint64 index){
+    RuntimeValue value = fn->constants[index];
+
+    if(IS_OBJ(value)){
+        fprintf(out, "constants[%llu]", index);
+    }
+    else{
+        fprintf(out, "0x%016llxULL", value);
+    }
+}
+
+// Stack depth before every instruction, -1 for code that can not be reached. The compiler only emits
+// structured control flow, so depths are known from a single forward pass.
+static int64* _aot_stack_depths(FunctionObject* fn, int64* max_depth){
+    size_t length = array_length(fn->code);
+    int64* depths = malloc((length + 1) * sizeof(int64));
+
+    for (size_t i = 0; i <= length; i++) {
+        depths[i] = -1;
+    }
+
+    depths[0] = fn->arity;
+    *max_depth = fn->arity;
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&fn->code[offset])) {
+        uint8_t* code = &fn->code[offset];
+        bool wide = code[0] == OP_WIDE;
+        uint8_t opcode = Opcode_Generic(code[wide]);
+        uint64 operand = Instruction_Operand(code);
+        size_t next = offset + Instruction_Length(code);
+
+        if(depths[offset] < 0){
+            continue;
+        }
+
+        int64 depth = depths[offset] + _aot_stack_effect(opcode, operand);
+        *max_depth = depth > *max_depth ? depth : *max_depth;
+
+        if(Opcode_IsJump(opcode)){
+            size_t target = Jump_Target(fn->code, offset);
+
+            if(depths[target] < 0){
+                depths[target] = depth;
+            }
+        }
+
+        if(opcode != OP_JMP && opcode != OP_RETURN && opcode != OP_HALT && depths[next] < 0){
+            depths[next] = depth;
+        }
+    }
+
+    return depths;
+}
+
+// Writes slots first to last back to their place in the VM stack
+static void _aot_spill(FILE* out, int64 first, int64 last){
+    for (int64 i = first; i <= last; i++) {
+        fprintf(out, "bp[%lld] = s%lld; ", i, i);
+    }
+}
+
+// Reads slots back after a collection, which may have moved what they point to
+static void _aot_reload(FILE* out, int64 first, int64 last){
+    for (int64 i = first; i <= last; i++) {
+        fprintf(out, "s%lld = bp[%lld]; ", i, i);
+    }
+}
+
+static void _aot_function(FILE* out, Program* global, size_t function_index){
+    FunctionObject* fn = global->functions[function_index];
+    size_t length = array_length(fn->code);
+
+    int64 max_depth;
+    int64* depths = _aot_stack_depths(fn, &max_depth);
+
+    bool* targets = calloc(length + 1, sizeof(bool));
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&fn->code[offset])) {
+        uint8_t* code = &fn->code[offset];
+
+        if(Opcode_IsJump(code[code[0] == OP_WIDE])){
+            targets[Jump_Target(fn->code, offset)] = true;
+        }
+    }
+
+    fprintf(out, "static RuntimeValue* aot_%llu_%s(VM* vm, RuntimeValue* bp, RuntimeValue* sp){\n", (uint64)function_index, fn->name);
+    fprintf(out, "    GlobalVar* globals = _aot_program->globals;\n");
+    fprintf(out, "    RuntimeValue* constants = _aot_program->functions[%llu]->constants;\n", (uint64)function_index);
+
+    for (int64 i = 0; i < max_depth; i++) {
+        if(i < fn->arity){
+            fprintf(out, "    RuntimeValue s%lld = bp[%lld];\n", i, i);
+        }
+        else{
+            fprintf(out, "    RuntimeValue s%lld = NULL_VAL;\n", i);
+        }
+    }
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&fn->code[offset])) {
+        uint8_t* code = &fn->code[offset];
+        bool wide = code[0] == OP_WIDE;
+        uint8_t opcode = Opcode_Generic(code[wide]);
+        uint64 operand = Instruction_Operand(code);
+        uint8_t second = Instruction_Second(code); // Superinstructions only
+        size_t target = Opcode_IsJump(opcode) ? Jump_Target(fn->code, offset) : 0;
+        int64 top = depths[offset] - 1;
+
+        if(targets[offset]){
+            fprintf(out, "L%llu:\n", (uint64)offset);
+        }
+
+        if(depths[offset] < 0){
+            continue;
+        }
+
+        fprintf(out, "    ");
+
+        switch (opcode)
+        {
+            case OP_CONST: {
+                fprintf(out, "s%lld = ", top + 1);
+                _aot_constant(out, fn, operand);
+                fprintf(out, ";\n");
+                break;
+            }
+
+            case OP_ADD: {
+                fprintf(out, "s%lld = AOT_ADD(s%lld, s%lld);\n", top - 1, top - 1, top);
+                break;
+            }
+
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV: {
+                char* operation = opcode == OP_SUB ? "-" : opcode == OP_MUL ? "*" : "/";
+                fprintf(out, "s%lld = AOT_ARITHMETIC(s%lld, %s, s%lld);\n", top - 1, top - 1, operation, top);
+                break;
+            }
+
+            case OP_LT:
+            case OP_GT:
+            case OP_LE:
+            case OP_GE:
+            case OP_EQ:
+            case OP_NE: {
+                fprintf(out, "s%lld = AOT_BOOL(AOT_COMPARE(%d, s%lld, %s, s%lld));\n", top - 1, opcode, top - 1, _aot_compare_operator(opcode), top);
+                break;
+            }
+
+            case OP_JMP_IF_NOT_LT:
+            case OP_JMP_IF_NOT_GT:
+            case OP_JMP_IF_NOT_LE:
+            case OP_JMP_IF_NOT_GE:
+            case OP_JMP_IF_NOT_EQ:
+            case OP_JMP_IF_NOT_NE: {
+                uint8_t compare = OP_LT + (opcode - OP_JMP_IF_NOT_LT);
+                fprintf(out, "if(!AOT_COMPARE(%d, s%lld, %s, s%lld)) goto L%llu;\n", compare, top - 1, _aot_compare_operator(compare), top, (uint64)target);
+                break;
+            }
+
+            case OP_JMP_IF_FALSE: {
+                fprintf(out, "if(s%lld != TRUE_VAL) goto L%llu;\n", top, (uint64)target);
+                break;
+            }
+
+            case OP_JMP: {
+                // Loops are safepoints, the collector sees the frame once it is written back to the VM stack
+                if(target < offset){
+                    fprintf(out, "if(_gc_pending){ ");
+                    _aot_spill(out, 0, top);
+                    fprintf(out, "gc_safepoint(vm, &bp[%lld]); ", top + 1);
+                    _aot_reload(out, 0, top);
+                    fprintf(out, "}\n    ");
+                }
+
+                fprintf(out, "goto L%llu;\n", (uint64)target);
+                break;
+            }
+
+            case OP_GET_GLOBAL: {
+                fprintf(out, "s%lld = globals[%llu].value;\n", top + 1, operand);
+                break;
+            }
+
+            case OP_SET_GLOBAL:
+            case OP_STORE_GLOBAL: {
+                fprintf(out, "globals[%llu].value = s%lld; GLOBAL_BARRIER(_aot_program, %llu);\n", operand, top, operand);
+                break;
+            }
+
+            case OP_GET_LOCAL: {
+                fprintf(out, "s%lld = s%llu;\n", top + 1, operand);
+                break;
+            }
+
+            case OP_SET_LOCAL:
+            case OP_STORE_LOCAL: {
+                fprintf(out, "s%llu = s%lld;\n", operand, top);
+                break;
+            }
+
+            case OP_CALL: {
+                // The callee and its arguments go on the VM stack above this frame, the result comes back below sp.
+                // The rest of the frame is written back too and read again after, the callee may collect.
+                int64 first = top - operand;
+
+                fprintf(out, "{ ");
+                _aot_spill(out, 0, top);
+                fprintf(out, "\n");
+
+                fprintf(out, "        s%lld = jit_call(vm, &bp[%lld], %llu)[-1];\n", first, top + 1, operand);
+
+                if(first > 0){
+                    fprintf(out, "        ");
+                    _aot_reload(out, 0, first - 1);
+                    fprintf(out, "\n");
+                }
+
+                fprintf(out, "    }\n");
+                break;
+            }
+
+            case OP_RETURN: {
+                // Same as the interpreter, the result replaces the last operand slots of the frame
+                int64 result = operand > 0 ? top + 1 - operand : top;
+                fprintf(out, "bp[%lld] = s%lld; return &bp[%lld];\n", result, top, result + 1);
+                break;
+            }
+
+            case OP_HALT: {
+                // Only main halts, the caller pops the result
+                fprintf(out, "bp[%lld] = s%lld; return &bp[%lld];\n", top, top, top + 1);
+                break;
+            }
+
+            case OP_GET_MEMBER: {
+                fprintf(out, "s%lld = AOT_GetMember(s%lld, %llu);\n", top, top, operand);
+                break;
+            }
+
+            case OP_INC_LOCAL: {
+                fprintf(out, "s%llu = AOT_ADD(s%llu, ", operand, operand);
+                _aot_constant(out, fn, second);
+                fprintf(out, ");\n");
+                break;
+            }
+
+            case OP_INC_GLOBAL: {
+                fprintf(out, "globals[%llu].value = AOT_ADD(globals[%llu].value, ", operand, operand);
+                _aot_constant(out, fn, second);
+                fprintf(out, "); GLOBAL_BARRIER(_aot_program, %llu);\n", operand);
+                break;
+            }
+
+            case OP_ADD_LOCAL_CONST: {
+                fprintf(out, "s%lld = AOT_ADD(s%llu, ", top + 1, operand);
+                _aot_constant(out, fn, second);
+                fprintf(out, ");\n");
+                break;
+            }
+
+            case OP_LOAD_LOCAL2: {
+                fprintf(out, "s%lld = s%llu; s%lld = s%u;\n", top + 1, operand, top + 2, second);
+                break;
+            }
+
+            case OP_CONST_SET_LOCAL: {
+                fprintf(out, "s%lld = ", top + 1);
+                _aot_constant(out, fn, operand);
+                fprintf(out, "; s%u = s%lld;\n", second, top + 1);
+                break;
+            }
+
+            default: {
+                // POP and SCOPE_EXIT only move the stack depth
+                fprintf(out, ";\n");
+                break;
+            }
+        }
+    }
+
+    if(targets[length]){
+        fprintf(out, "L%llu:\n    ;\n", (uint64)length);
+    }
+
+    fprintf(out, "    return sp;\n}\n\n");
+
+    free(depths);
+    free(targets);
+}
+
+// Writes name.aot.c and builds it into the executable name.aot, which runs the script it was made from
+// from the current directory. Returns false if gcc failed.
+bool aot_build(Program* global, char* name){
+    char source_path[256];
+    char binary_path[256];
+    snprintf(source_path, sizeof(source_path), "%s.aot.c", name);
+    snprintf(binary_path, sizeof(binary_path), "%s.aot", name);
+
+    FILE* out = fopen(source_path, "w");
+
+    if(out == NULL){
+        printf("\033[0;31mAOT: Could not write %s.\033[0m\n", source_path);
+        return false;
+    }
+
+    fprintf(out, "// Generated from %s.cynep, regenerate with -aot after changing the script.\n\n", name);
+    fprintf(out, "#define main cynep_main\n#include \"main.c\"\n#undef main\n\n");
+
+    size_t count = array_length(global->functions);
+
+    for (size_t i = 0; i < count; i++) {
+        _aot_function(out, global, i);
+    }
+
+    fprintf(out, "static AotFunction functions[%llu] = {\n", (uint64)count);
+
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "    { aot_%llu_%s, 0x%016llxULL },\n", (uint64)i, global->functions[i]->name, _aot_hash(global->functions[i]));
+    }
+
+    fprintf(out, "};\n\n");
+    fprintf(out, "int main(int argc, char** argv){\n");
+    fprintf(out, "    _aot_functions = functions;\n");
+    fprintf(out, "    _aot_function_count = %llu;\n", (uint64)count);
+    fprintf(out, "    return cynep_main(argc, argv);\n");
+    fprintf(out, "}\n");
+
+    fclose(out);
+
+    char command[1024];
+    snprintf(command, sizeof(command), "gcc -O2 -w -I\"%s\" \"%s\" -o \"%s\" -lpthread -lm", CYNEP_SOURCE_DIR, source_path, binary_path);
+    printf("AOT: %s\n", command);
+
+    if(system(command) != 0){
+        printf("\033[0;31mAOT: gcc failed, set CYNEP_SOURCE_DIR to the directory of main.c when building cynep.\033[0m\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Replaces the bytecode of every function with its generated C function when running as an AOT build.
+// The bytecode has to be the same as when the code was generated.
+void aot_install(Program* global){
+    if(_aot_functions == NULL){
+        return;
+    }
+
+    if(_aot_function_count != array_length(global->functions)){
+        printf("\033[0;31mAOT: The script has changed since it was compiled ahead of time.\033[0m\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < _aot_function_count; i++) {
+        if(_aot_functions[i].hash != _aot_hash(global->functions[i])){
+            printf("\033[0;31mAOT: Function %s has changed since it was compiled ahead of time.\033[0m\n", global->functions[i]->name);
+            exit(1);
+        }
+
+        global->functions[i]->jit_code = _aot_functions[i].code;
+        global->functions[i]->jit_state = Jit_Compiled;
+    }
+
+    _aot_program = global;
+}
+
+#pragma endregion
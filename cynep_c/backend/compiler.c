@@ -3,12 +3,23 @@
 size_t      Get_Offset(FunctionObject* co);
 size_t      Numeric_Const_Index(FunctionObject* co, float64 value);
 size_t      locals_in_scope(FunctionObject* co);
-int64_t     String_Const_Index(FunctionObject* co, char* string);
-void        compile(AstNode* statement, Program* global);
-void        generate(FunctionObject* co, AstNode* statement, Program* global);
+int64_t     String_Const_Index(FunctionObject* co, Symbol string);
+void        compile(Ast* ast, Program* global);
+void        generate(FunctionObject* co, Ast* ast, NodeIndex statement, Program* global);
+void        generate_call(FunctionObject* co, Ast* ast, NodeIndex call, Program* global);
+int64_t     Value_Const_Index(FunctionObject* co, RuntimeValue value);
+bool        Evaluate_Constant(FunctionObject* co, Ast* ast, NodeIndex expression, Program* global, RuntimeValue* result);
+bool        emit_evaluated(FunctionObject* co, Ast* ast, NodeIndex expression, Program* global);
+bool        Function_IsPure(Program* global, FunctionObject* fn);
 void        emit_opcode(FunctionObject* co, uint8_t code);
-void        Write_Address_At_Offset(FunctionObject* co, size_t offset, uint64_t value);
-void        emit_64(FunctionObject* co, uint64_t value);
+void        emit_8(FunctionObject* co, uint8_t value);
+void        emit_16(FunctionObject* co, uint16_t value);
+void        emit_index(FunctionObject* co, uint8_t code, uint64_t index);
+size_t      emit_jump(FunctionObject* co, uint8_t code);
+size_t      emit_test(FunctionObject* co, Ast* ast, NodeIndex test, Program* global);
+uint8_t     Compare_Opcode(OperatorKind operator);
+void        Write_Jump_At_Offset(FunctionObject* co, size_t offset, size_t target);
+void        Relax_Jumps(FunctionObject* co);
 void        emit_return(FunctionObject* co, Program* global, uint64_t vars_declared_in_scope);
 bool        is_global_scope(FunctionObject* co);
 
@@ -29,44 +40,45 @@ RuntimeValue Create_CodeObjectValue(char* name, size_t arity, Program* program){
     return value;
 }
 
-void compile(AstNode* statement, Program* program)
+void compile(Ast* ast, Program* program)
 {
     int64 compile_begin = timestamp();
 
-    generate(NULL, statement, program);
+    generate(NULL, ast, ast->root, program);
 
     int64 compile_end = timestamp();
     printf("Compiling: %d ms\n", compile_end/1000-compile_begin/1000);
 }
 
-void generate(FunctionObject* co, AstNode* statement, Program* program){
-    switch (statement->type)
+void generate(FunctionObject* co, Ast* ast, NodeIndex statement, Program* program){
+    switch (Ast_Type(ast, statement))
     {
         case AST_BinaryExpression:{
-            BinaryExpression expression = *(BinaryExpression*)statement;
+            BinaryExpression expression = *AST_GET(ast, statement, BinaryExpression);
 
-            generate(co, (AstNode*)expression.left, program);
-            generate(co, (AstNode*)expression.right, program);
-
-            if(expression.operator[0] == '+'){
-                emit_opcode(co, OP_ADD);
-            }
-            else if(expression.operator[0] == '-'){
-                emit_opcode(co, OP_SUB);
+            // Literal arithmetic is already folded, what is left to evaluate here involves consts
+            if(!is_global_scope(co) && array_length(program->const_values) > 0 && emit_evaluated(co, ast, statement, program)){
+                break;
             }
-            else if(expression.operator[0] == '*'){
-                emit_opcode(co, OP_MUL);
-            }
-            else if(expression.operator[0] == '/'){
-                emit_opcode(co, OP_DIV);
+
+            generate(co, ast, expression.left, program);
+            generate(co, ast, expression.right, program);
+
+            switch (expression.operator)
+            {
+                case Operator_Add:      emit_opcode(co, OP_ADD); break;
+                case Operator_Subtract: emit_opcode(co, OP_SUB); break;
+                case Operator_Multiply: emit_opcode(co, OP_MUL); break;
+                case Operator_Divide:   emit_opcode(co, OP_DIV); break;
+                default: break; // TODO: Modulo
             }
             break;
         }
         
         case AST_ReturnStatement: {
-            ReturnStatement expression = *(ReturnStatement*)statement;
+            ReturnStatement expression = *AST_GET(ast, statement, ReturnStatement);
 
-            generate(co, (AstNode*)expression.value, program);
+            generate(co, ast, expression.value, program);
 
             // Since we quit the whole function we exit scope with all locals in function
             // TODO: This should probably be all locals in current scope or lower?
@@ -86,7 +98,7 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
         }
 
         case AST_MemberExpression: {
-            MemberExpression expression = *(MemberExpression*)statement;
+            MemberExpression expression = *AST_GET(ast, statement, MemberExpression);
 
             // Emit object first
             // Borde köra Gen på object sen
@@ -96,82 +108,49 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
             // Emit(co, OP_GET_LOCAL);
             // Emit64(co, local_index);
 
-            generate(co, (AstNode*)expression.object, program);
+            generate(co, ast, expression.object, program);
 
-            // Läs tillbaka senast emittade och kolla typ?
-            // ! IMPORTANT! Read back 64 bit. 
-            uint8_t address = co->code[array_length(co->code) - 8]; // Read back address
-            uint8_t code = co->code[array_length(co->code) - 9]; // läs tillbaka opcode
+            // Operands are variable width now, so check the object node instead of reading back the last opcode
+            Identifier* object = AST_GET(ast, expression.object, Identifier);
 
-            if(code == OP_GET_LOCAL){
-                LocalVar assd = Local_Get(co, address); // Check type and use when getting typeinfo
+            if(object->node.type == AST_Identifier && Local_GetIndex(co, object->name) != -1){
+                LocalVar assd = Local_Get(co, Local_GetIndex(co, object->name)); // Check type and use when getting typeinfo
                 // Maybe it should have a typeinfo pointer on it
                 int asd = 0;
             }
             else{
                 printf("\033[0;31mCompiler: Implement global in member expression \033[0m\n");
-                exit(0);
+                exit(1);
             }
 
             // Then member, borde alltid vara identifier?
-            Identifier member = *(Identifier*)expression.member;
+            Identifier member = *AST_GET(ast, expression.member, Identifier);
 
-            int64 typeinfo_index = Global_GetIndex(program, "player");
+            int64 typeinfo_index = Global_GetIndex(program, symbol_intern_string("player"));
             GlobalVar typeinfovar = Global_Get(program, typeinfo_index);
             TypeInfoObject type_info = AS_TYPEINFO(typeinfovar.value);
 
             int64 member_index = Member_GetIndex(&type_info, member.name);
 
-            emit_opcode(co, OP_GET_MEMBER);
-            emit_64(co, member_index);
+            emit_index(co, OP_GET_MEMBER, member_index);
 
             break;
         }
         
         case AST_ComparisonExpression: {
-            BinaryExpression expression = *(BinaryExpression*)statement;
+            BinaryExpression expression = *AST_GET(ast, statement, BinaryExpression);
 
-            generate(co, (AstNode*)expression.left, program);
-            generate(co, (AstNode*)expression.right, program);
-
-            if(expression.operator[0] == '>'
-            && expression.operator[1] == NULL_CHAR){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_GT);
-            }
-            else if(expression.operator[0] == '<'
-            && expression.operator[1] == NULL_CHAR){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_LT);
-            }
-            else if(expression.operator[0] == '=' 
-                 && expression.operator[1] == '='){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_EQ);
-            }
-            else if(expression.operator[0] == '>' 
-                 && expression.operator[1] == '='){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_GE);
-            }
-            else if(expression.operator[0] == '<' 
-                 && expression.operator[1] == '='){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_LE);
-            }
+            generate(co, ast, expression.left, program);
+            generate(co, ast, expression.right, program);
 
-            else if(expression.operator[0] == '!' 
-                 && expression.operator[1] == '='){
-                emit_opcode(co, OP_CMP);
-                emit_opcode(co, OP_CMP_NE);
-            }
+            emit_opcode(co, Compare_Opcode(expression.operator));
             break;
         }
 
         case AST_TypeDefinition: {
-            TypeDeclaration typeDeclaration = *(TypeDeclaration*)statement;
+            TypeDeclaration typeDeclaration = *AST_GET(ast, statement, TypeDeclaration);
 
-            RuntimeValue typeInfoValue = Alloc_TypeInfo(&typeDeclaration);
+            RuntimeValue typeInfoValue = Alloc_TypeInfo(ast, &typeDeclaration);
             TypeInfoObject* typeInfo = (TypeInfoObject*)AS_C_OBJ(typeInfoValue);
 
             MemberInfo asd = typeInfo->members[0];
@@ -182,65 +161,54 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
         }
 
         case AST_IfStatement: {
-            IfStatement expression = *(IfStatement*)statement;
-
-            generate(co, (AstNode*)expression.test, program); // Emit test
-            emit_opcode(co, OP_JMP_IF_FALSE); 
+            IfStatement expression = *AST_GET(ast, statement, IfStatement);
 
-            emit_64(co, 0); // 64 bit for alternate address
-            size_t else_jmp_address = Get_Offset(co) - 8; // 8 bytes for 64 bit
+            size_t else_jmp_address = emit_test(co, ast, expression.test, program); // Emit test
 
-            generate(co, (AstNode*)expression.consequent, program); // Emit consequent
+            generate(co, ast, expression.consequent, program); // Emit consequent
 
-            emit_opcode(co, OP_JMP); 
-            emit_64(co, 0); // 64 bit for end address
-            size_t end_address = Get_Offset(co) - 8; // 8 bytes for 64 bit
+            size_t end_address = emit_jump(co, OP_JMP);
 
             // Patch else branch address
             size_t else_branch_address = Get_Offset(co);
-            Write_Address_At_Offset(co, else_jmp_address, else_branch_address);
+            Write_Jump_At_Offset(co, else_jmp_address, else_branch_address);
 
-            if(expression.alternate != NULL){
+            if(expression.alternate != NODE_NONE){
                 // Emit alternate if present
-                generate(co, (AstNode*)expression.alternate, program); 
+                generate(co, ast, expression.alternate, program); 
             }
 
             // Patch end of "if" address
             size_t end_branch_address = Get_Offset(co);
-            Write_Address_At_Offset(co, end_address, end_branch_address);
+            Write_Jump_At_Offset(co, end_address, end_branch_address);
 
             break;
         }
 
         case AST_WhileStatement: {
-            WhileStatement expression = *(WhileStatement*)statement;
+            WhileStatement expression = *AST_GET(ast, statement, WhileStatement);
 
             size_t loop_start_address = Get_Offset(co);
 
-            generate(co, (AstNode*)expression.test, program); // Emit test
+            size_t loop_end_jmp_address = emit_test(co, ast, expression.test, program); // Emit test
 
-            emit_opcode(co, OP_JMP_IF_FALSE); 
-            size_t loop_end_jmp_address = Get_Offset(co);
-            emit_64(co, 0);
+            generate(co, ast, expression.body, program); // Emit block
 
-            generate(co, (AstNode*)expression.body, program); // Emit block
-
-            emit_opcode(co, OP_JMP); 
-            size_t end_address = Get_Offset(co);
-            emit_64(co, loop_start_address);
+            size_t end_address = emit_jump(co, OP_JMP);
+            Write_Jump_At_Offset(co, end_address, loop_start_address);
 
             // Patch end
             size_t end_branch_address = Get_Offset(co);
-            Write_Address_At_Offset(co, loop_end_jmp_address, end_branch_address);
+            Write_Jump_At_Offset(co, loop_end_jmp_address, end_branch_address);
 
             break;
         }
 
         case AST_FunctionDeclaration: {
-            FunctionDeclaration functionDeclaration = *(FunctionDeclaration*)statement;
+            FunctionDeclaration functionDeclaration = *AST_GET(ast, statement, FunctionDeclaration);
 
-            char* name = functionDeclaration.name;
-            size_t arity = functionDeclaration.args->count;
+            char* name = symbol_name(functionDeclaration.name);
+            size_t arity = functionDeclaration.args.count;
 
             RuntimeValue coValue = Create_CodeObjectValue(name, arity, program);
             FunctionObject* new_co = &AS_FUNCTION(coValue);
@@ -249,18 +217,15 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
 
             new_co->scope_level = 1;
 
-            ListNode* current_node = functionDeclaration.args->first;
-            while (current_node != NULL)
+            for (size_t i = 0; i < functionDeclaration.args.count; i++)
             {
-                Identifier* identifier = ((Identifier*)current_node->value);
+                Identifier* identifier = AST_GET(ast, Ast_Child(ast, functionDeclaration.args, i), Identifier);
                 Local_Define(new_co, identifier->name);
-                current_node = current_node->next;
             }
             new_co->scope_level = 0;
 
             // Generate body
-            AstNode* functionBody = (AstNode*)functionDeclaration.body;
-            generate(new_co, functionBody, program);
+            generate(new_co, ast, functionDeclaration.body, program);
 
             // Here goes cleanup if we add functions without block as body
 
@@ -269,11 +234,17 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
             // TODO: Pass number of top level var declarations here (maybe not? They should be popped by scope exit)
             emit_return(new_co, program, 0);
 
+            Relax_Jumps(new_co);
+            Peephole_Optimize(new_co);
+
+            // Decided once the body is complete, calls compiled after this can then be evaluated early
+            new_co->purity = Function_IsPure(program, new_co) ? Purity_Pure : Purity_Impure;
+
             break;
         }
 
         case AST_BlockStatement:{
-            BlockStatement blockStatement = *(BlockStatement*)statement;
+            BlockStatement blockStatement = *AST_GET(ast, statement, BlockStatement);
 
             // Scope begin
             uint8_t saved_scope = 0;
@@ -282,18 +253,15 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
                 co->scope_level++;
             }
 
-            ListNode* current_node = blockStatement.body->first;
-            while (current_node != NULL)
+            for (size_t i = 0; i < blockStatement.body.count; i++)
             {
-                AstNode* current_astNode = ((AstNode*)current_node->value);
+                NodeIndex current_node = Ast_Child(ast, blockStatement.body, i);
 
-                generate(co, current_node->value, program);
+                generate(co, ast, current_node, program);
 
-                if(current_astNode->type == AST_AssignmentExpression){
+                if(Ast_Type(ast, current_node) == AST_AssignmentExpression){
                     emit_opcode(co, OP_POP);
                 }
-
-                current_node = current_node->next;
             }
 
             // Scope exit
@@ -303,12 +271,11 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
                 // TODO: Do not emit this if previous instruction was an explicit return
                 uint64 vars_declared_in_scope_count = locals_in_scope(co);
 
-                array_popn(co->locals, vars_declared_in_scope_count);
+                Local_PopScope(co, vars_declared_in_scope_count);
                 
                 
                 if(vars_declared_in_scope_count > 0 || co->arity > 0){
-                    emit_opcode(co, OP_SCOPE_EXIT);
-                    emit_64(co, vars_declared_in_scope_count);
+                    emit_index(co, OP_SCOPE_EXIT, vars_declared_in_scope_count);
                 }
 
                 co->scope_level = saved_scope;
@@ -318,35 +285,36 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
         }
 
         case AST_NumericLiteral: {
-            NumericLiteral expression = *(NumericLiteral*)statement;
+            NumericLiteral expression = *AST_GET(ast, statement, NumericLiteral);
 
-            size_t index = Numeric_Const_Index(co, expression.value);
+            size_t index = Numeric_Const_Index(co, NumericLiteral_Value(&expression));
 
-            emit_opcode(co, OP_CONST);
-            emit_64(co, index);
+            emit_index(co, OP_CONST, index);
 
             break;
         }
 
         case AST_StringLiteral: {
-            StringLiteral expression = *(StringLiteral*)statement;
+            StringLiteral expression = *AST_GET(ast, statement, StringLiteral);
 
             size_t index = String_Const_Index(co, expression.value);
 
-            emit_opcode(co, OP_CONST);
-            emit_64(co, index);
+            emit_index(co, OP_CONST, index);
 
             break;
         }
 
         case AST_Identifier: {
-            Identifier identifier = *(Identifier*)statement;
+            Identifier identifier = *AST_GET(ast, statement, Identifier);
 
             // Handle scoped variables
             int64 local_index = Local_GetIndex(co, identifier.name);
             if(local_index != -1){
-                emit_opcode(co, OP_GET_LOCAL);
-                emit_64(co, local_index);
+                emit_index(co, OP_GET_LOCAL, local_index);
+            }
+            else if(Const_GetIndex(program, identifier.name) != -1){
+                RuntimeValue value = program->const_values[Const_GetIndex(program, identifier.name)];
+                emit_index(co, OP_CONST, Value_Const_Index(co, value));
             }
             else{
                 // No local, try global
@@ -354,17 +322,16 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
 
                 if(global_index == -1){
                     printf("\033[0;31mCompiler: Reference error \033[0m\n");
-                    exit(0);
+                    exit(1);
                 }
 
-                emit_opcode(co, OP_GET_GLOBAL);
-                emit_64(co, global_index);
+                emit_index(co, OP_GET_GLOBAL, global_index);
             }
             break;
         }
 
         case AST_VariableDeclaration: {
-            VariableDeclaration variableDeclaration = *(VariableDeclaration*)statement;
+            VariableDeclaration variableDeclaration = *AST_GET(ast, statement, VariableDeclaration);
 
             if(is_global_scope(co))
             { 
@@ -372,38 +339,66 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
                 // TODO: We need to set global value here. Needs to be numericliteral or stringliteral.
             }
             else{
-                if(variableDeclaration.value != NULL){
-                    generate(co, (AstNode*)variableDeclaration.value, program);
+                if(variableDeclaration.value != NODE_NONE){
+                    generate(co, ast, variableDeclaration.value, program);
                 }
                 else{
                     // Emit null if no value
-                    int64 global_index = Global_GetIndex(program, "null");
-                    emit_opcode(co, OP_GET_GLOBAL);
-                    emit_64(co, global_index);
+                    int64 global_index = Global_GetIndex(program, symbol_intern_string("null"));
+                    emit_index(co, OP_GET_GLOBAL, global_index);
                 }
 
                 Local_Define(co, variableDeclaration.name); // This should return index directly
                 int64 index = Local_GetIndex(co, variableDeclaration.name);
 
-                emit_opcode(co, OP_SET_LOCAL);
-                emit_64(co, index);
+                emit_index(co, OP_SET_LOCAL, index);
             }
 
             break;
         }
 
+        case AST_ConstDeclaration: {
+            ConstDeclaration constDeclaration = *AST_GET(ast, statement, ConstDeclaration);
+            char* name = symbol_name(constDeclaration.name);
+
+            if(!is_global_scope(co)){
+                printf("\033[0;31mCompiler: const %s must be declared at top level \033[0m\n", name);
+                exit(1);
+            }
+
+            if(Const_GetIndex(program, constDeclaration.name) != -1 || Global_GetIndex(program, constDeclaration.name) != -1){
+                printf("\033[0;31mCompiler: %s is already declared \033[0m\n", name);
+                exit(1);
+            }
+
+            // Consts take no space at runtime, every use compiles to the value
+            RuntimeValue value;
+
+            if(!Evaluate_Constant(co, ast, constDeclaration.value, program, &value) || (IS_OBJ(value) && AS_C_OBJ(value)->objectType != ObjectType_String)){
+                printf("\033[0;31mCompiler: Value of const %s can not be computed at compile time \033[0m\n", name);
+                exit(1);
+            }
+
+            Const_Define(program, constDeclaration.name, value);
+
+            break;
+        }
+
         case AST_AssignmentExpression: {
-            AssignmentExpression assignmentExpression = *(AssignmentExpression*)statement; 
-            Identifier* identifier = (Identifier*)assignmentExpression.assignee; // TODO: Handle member expressions
+            AssignmentExpression assignmentExpression = *AST_GET(ast, statement, AssignmentExpression); 
+            Identifier* identifier = AST_GET(ast, assignmentExpression.assignee, Identifier); // TODO: Handle member expressions
 
             // Emit value
-            generate(co, (AstNode*)assignmentExpression.value, program);
+            generate(co, ast, assignmentExpression.value, program);
 
             // 1. Locals
             int64 local_index = Local_GetIndex(co, identifier->name);
             if(local_index != -1){
-                emit_opcode(co, OP_SET_LOCAL);
-                emit_64(co, local_index);
+                emit_index(co, OP_SET_LOCAL, local_index);
+            }
+            else if(Const_GetIndex(program, identifier->name) != -1){
+                printf("\033[0;31mCompiler: Cannot assign to const %s \033[0m\n", symbol_name(identifier->name));
+                exit(1);
             }
             else{
                 // 2. Globals
@@ -411,57 +406,62 @@ void generate(FunctionObject* co, AstNode* statement, Program* program){
 
                 if(global_index == -1){
                     printf("\033[0;31mCompiler: Reference error \033[0m\n");
-                    exit(0);
+                    exit(1);
                 }
 
-                emit_opcode(co, OP_SET_GLOBAL);
-                emit_64(co, global_index);
+                emit_index(co, OP_SET_GLOBAL, global_index);
             }
 
             break;
         }
 
         case AST_CallExpression:{
-            CallExpression callExpression = *(CallExpression*)statement; 
-
-
-            // uint8_t address = co->code[co->code_last - 8]; // Read back function global address
-
-            // TODO: IMPORTANT! Valitade arity for native and user defined functions. Example (native):
-            /*
-            NativeFunctionObject native_fn = AS_NATIVE_FUNCTION(Global_Get(global, address).value);
-
-            if(native_fn.arity != callExpression.args->count){
-                printf("\033[0;31mCompiler: Reference error. Arity mismatch. \033[0m\n");
-                exit(0);
+            // Calls to pure functions with constant arguments are run now and replaced by their result
+            if(!is_global_scope(co) && emit_evaluated(co, ast, statement, program)){
+                break;
             }
-            */
 
-            ListNode* cursor = callExpression.args->first;
-            while (cursor != NULL)
-            {
-                generate(co, (AstNode*)cursor->value, program);
-                cursor = cursor->next;
-            }
-
-            // Emit function
-            generate(co, (AstNode*)callExpression.callee, program);
-
-            emit_opcode(co, OP_CALL);
-            emit_64(co, callExpression.args->count);
-            
+            generate_call(co, ast, statement, program);
             break;
         }
 
         default: {
             printf("\033[0;31mCompiler error: Unknown AST node \033[0m\n");
-            exit(0);
+            exit(1);
             break;
         }
 
     }
 }
 
+// Plain call, arguments first and the callee on top
+void generate_call(FunctionObject* co, Ast* ast, NodeIndex call, Program* program){
+    CallExpression callExpression = *AST_GET(ast, call, CallExpression);
+
+
+        // uint8_t address = co->code[co->code_last - 8]; // Read back function global address
+
+        // TODO: IMPORTANT! Valitade arity for native and user defined functions. Example (native):
+        /*
+        NativeFunctionObject native_fn = AS_NATIVE_FUNCTION(Global_Get(global, address).value);
+
+        if(native_fn.arity != callExpression.args->count){
+            printf("\033[0;31mCompiler: Reference error. Arity mismatch. \033[0m\n");
+            exit(1);
+        }
+        */
+
+        for (size_t i = 0; i < callExpression.args.count; i++)
+        {
+            generate(co, ast, Ast_Child(ast, callExpression.args, i), program);
+        }
+
+        // Emit function
+        generate(co, ast, callExpression.callee, program);
+
+        emit_index(co, OP_CALL, callExpression.args.count);
+}
+
 bool is_global_scope(FunctionObject* co){
     return co == NULL;
 }
@@ -487,68 +487,460 @@ void emit_return(FunctionObject* co, Program* global, uint64_t vars_declared_in_
         emit_opcode(co, OP_HALT);
     }
     else{
-        emit_opcode(co, OP_RETURN);
-        emit_64(co, vars_declared_in_scope);
+        emit_index(co, OP_RETURN, vars_declared_in_scope);
     }
 }
 
 size_t Numeric_Const_Index(FunctionObject* co, double value){
-    for (size_t i = 0; i < array_length(co->constants); i++)
-    {
-        if(!IS_NUMBER(co->constants[i])){
-            continue;
-        }
-        if(AS_C_DOUBLE(co->constants[i]) == value){
-            return i;
+    return Value_Const_Index(co, NUMBER_VAL(value));
+}
+
+// Index of any value that can live in the constant pool, or -1 for objects other than strings
+int64 Value_Const_Index(FunctionObject* co, RuntimeValue value){
+    if(IS_OBJ(value)){
+        if(AS_C_OBJ(value)->objectType == ObjectType_String){
+            return String_Const_Index(co, symbol_intern_string(AS_STRING(value).string));
         }
+
+        return -1;
     }
 
-    array_push(co->constants, NUMBER_VAL(value));
+    // Numbers, booleans, null and short strings are keyed on their NaN-boxed bits, other strings on their contents
+    int64 index = table_get_int(&co->constant_table, value);
 
-    return array_length(co->constants) - 1; 
-}
+    if(index != -1){
+        return index;
+    }
 
-int64 String_Const_Index(FunctionObject* co, char* string){
-    for (size_t i = 0; i < array_length(co->constants); i++)
-    {
-        if(!IS_OBJ(co->constants[i])){
-            continue;
-        }
+    array_push(co->constants, value);
+    index = array_length(co->constants) - 1;
+    table_set_int(&co->constant_table, value, index);
+
+    return index; 
+}
 
-        StringObject* strObj = (StringObject*)AS_C_OBJ(co->constants[i]);
+int64 String_Const_Index(FunctionObject* co, Symbol string){
+    int64 index = table_get_int(&co->string_constant_table, string);
 
-        if(strcmp(string, strObj->string) == 0){
-            return i;
-        }
+    if(index != -1){
+        return index;
     }
 
-    array_push(co->constants, Alloc_String(string));
+    // Every function shares the one string object with these contents
+    array_push(co->constants, Intern_String(symbol_name(string)));
+    index = array_length(co->constants) - 1;
+    table_set_int(&co->string_constant_table, string, index);
 
-    return array_length(co->constants) - 1;
+    return index;
 }
 
 size_t Get_Offset(FunctionObject* co){
     return array_length(co->code);
 }
 
-// void Write_Byte_At_Offset(CodeObject* co, size_t offset, uint8_t value){
-//     co->code[offset] = value;
-// }
+// Writes a 16 bit jump operand at offset. Jumps are relative to the end of the operand. Jumps that are
+// too far are left for Relax_Jumps.
+void Write_Jump_At_Offset(FunctionObject* co, size_t offset, size_t target){
+    int64 relative = (int64)target - (int64)(offset + 2);
+
+    if(relative < INT16_MIN || relative > INT16_MAX){
+        JumpFixup far_jump = { offset - 1, target };
+        array_push(co->far_jumps, far_jump);
+        return;
+    }
+
+    Write_Jump(co->code, offset - 1, target);
+}
 
-// Writes 64 bit
-void Write_Address_At_Offset(FunctionObject* co, size_t offset, uint64_t value){
-    memcpy(&co->code[offset], &value, sizeof( uint64_t ));
+static bool _jump_fits(size_t* new_offsets, size_t offset, size_t target){
+    int64 relative = (int64)new_offsets[target] - (int64)(new_offsets[offset] + 3);
+    return relative >= INT16_MIN && relative <= INT16_MAX;
+}
+
+// Gives the jumps that did not fit in 16 bits the OP_WIDE form with a 32 bit offset. That moves the code after
+// them, which can push other jumps out of range, so jumps are widened until every one fits. Runs once the
+// function is complete, before anything else looks at its code.
+void Relax_Jumps(FunctionObject* co){
+    if(array_length(co->far_jumps) == 0){
+        return;
+    }
+
+    size_t length = array_length(co->code);
+    size_t* targets = malloc((length + 1) * sizeof(size_t)); // Old offset of a jump -> old target
+    size_t* new_offsets = malloc((length + 1) * sizeof(size_t)); // Old instruction offset -> new offset
+    bool* wide = calloc(length + 1, sizeof(bool));
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+        if(Opcode_IsJump(co->code[offset])){
+            targets[offset] = Jump_Target(co->code, offset);
+        }
+    }
+
+    for (size_t i = 0; i < array_length(co->far_jumps); i++) {
+        targets[co->far_jumps[i].offset] = co->far_jumps[i].target;
+        wide[co->far_jumps[i].offset] = true;
+    }
+
+    // Jumps only ever get wider, so this stops
+    bool changed = true;
+
+    while(changed){
+        size_t new_offset = 0;
+
+        for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+            new_offsets[offset] = new_offset;
+            new_offset += Instruction_Length(&co->code[offset]) + (wide[offset] ? 3 : 0);
+        }
+
+        new_offsets[length] = new_offset;
+        changed = false;
+
+        for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+            if(Opcode_IsJump(co->code[offset]) && !wide[offset] && !_jump_fits(new_offsets, offset, targets[offset])){
+                wide[offset] = true;
+                changed = true;
+            }
+        }
+    }
+
+    uint8_t* code = NULL;
+    arrsetcap(code, new_offsets[length]);
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+        size_t instruction_length = Instruction_Length(&co->code[offset]);
+
+        if(wide[offset]){
+            array_push(code, OP_WIDE);
+            array_push(code, co->code[offset]);
+            memset(arraddnptr(code, 4), 0, 4);
+        }
+        else{
+            memcpy(arraddnptr(code, instruction_length), &co->code[offset], instruction_length);
+        }
+    }
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+        if(Opcode_IsJump(co->code[offset])){
+            Write_Jump(code, new_offsets[offset], new_offsets[targets[offset]]);
+        }
+    }
+
+    arrfree(co->code);
+    co->code = code;
+
+    arrfree(co->far_jumps);
+    free(targets);
+    free(new_offsets);
+    free(wide);
 }
 
 void emit_opcode(FunctionObject* co, uint8_t code){
     array_push(co->code, code);
 }
 
-void emit_64(FunctionObject* co, uint64_t value){
-    uint8_t* loc = arraddnptr(co->code, 8);
-    memcpy(loc, &value, sizeof( uint64_t ));
+void emit_8(FunctionObject* co, uint8_t value){
+    array_push(co->code, value);
+}
+
+void emit_16(FunctionObject* co, uint16_t value){
+    array_push(co->code, value & 0xFF);
+    array_push(co->code, value >> 8);
+}
+
+// Emits an instruction with an index operand. Uses the OP_WIDE form when the index does not fit in a byte.
+void emit_index(FunctionObject* co, uint8_t code, uint64_t index){
+    if(index <= UINT8_MAX){
+        emit_opcode(co, code);
+        emit_8(co, index);
+    }
+    else if(index <= UINT16_MAX){
+        emit_opcode(co, OP_WIDE);
+        emit_opcode(co, code);
+        emit_16(co, index);
+    }
+    else{
+        printf("\033[0;31mCompiler: Operand %llu too large for %s \033[0m\n", index, opcodeToString(code));
+        exit(1);
+    }
+}
+
+// Emits a jump with a placeholder operand. Returns the operand offset for Write_Jump_At_Offset.
+size_t emit_jump(FunctionObject* co, uint8_t code){
+    emit_opcode(co, code);
+    emit_16(co, 0);
+
+    return Get_Offset(co) - 2;
 }
 
+uint8_t Compare_Opcode(OperatorKind operator){
+    switch (operator)
+    {
+        case Operator_Less:         return OP_LT;
+        case Operator_Greater:      return OP_GT;
+        case Operator_LessEqual:    return OP_LE;
+        case Operator_GreaterEqual: return OP_GE;
+        case Operator_Equal:        return OP_EQ;
+        case Operator_NotEqual:     return OP_NE;
+        default: {
+            printf("\033[0;31mCompiler: %s is not a comparison \033[0m\n", _operator_names[operator]);
+            exit(1);
+        }
+    }
+}
+
+// Emits the test of an if or while and the jump taken when it is false. A comparison becomes a single
+// compare and branch, anything else is evaluated to a value and tested with JMP_IF_FALSE.
+size_t emit_test(FunctionObject* co, Ast* ast, NodeIndex test, Program* program){
+    if(Ast_Type(ast, test) == AST_ComparisonExpression){
+        ComparisonExpression expression = *AST_GET(ast, test, ComparisonExpression);
+
+        generate(co, ast, expression.left, program);
+        generate(co, ast, expression.right, program);
+
+        return emit_jump(co, OP_JMP_IF_NOT_LT + (Compare_Opcode(expression.operator) - OP_LT));
+    }
+
+    generate(co, ast, test, program);
+
+    return emit_jump(co, OP_JMP_IF_FALSE);
+}
+
+#pragma region COMPILE_TIME_EVALUATION
+
+// Set while a throwaway function is generated. Everything in it runs on the scratch VM anyway.
+static bool _generating_thunk = false;
+
+// Built only from literals, consts and calls to global functions. Whether the called functions are pure
+// is decided on the bytecode by Function_IsPure.
+bool Is_Constant_Expression(FunctionObject* co, Ast* ast, NodeIndex expression, Program* program){
+    switch (Ast_Type(ast, expression))
+    {
+        case AST_NumericLiteral:
+        case AST_StringLiteral: {
+            return true;
+        }
+
+        case AST_Identifier: {
+            Symbol name = AST_GET(ast, expression, Identifier)->name;
+
+            if(!is_global_scope(co) && Local_GetIndex(co, name) != -1){
+                return false;
+            }
+
+            return Const_GetIndex(program, name) != -1;
+        }
+
+        case AST_BinaryExpression:
+        case AST_ComparisonExpression: {
+            BinaryExpression binary = *AST_GET(ast, expression, BinaryExpression);
+
+            return Is_Constant_Expression(co, ast, binary.left, program) && Is_Constant_Expression(co, ast, binary.right, program);
+        }
+
+        case AST_CallExpression: {
+            CallExpression call = *AST_GET(ast, expression, CallExpression);
+
+            if(Ast_Type(ast, call.callee) != AST_Identifier){
+                return false;
+            }
+
+            Symbol name = AST_GET(ast, call.callee, Identifier)->name;
+
+            if((!is_global_scope(co) && Local_GetIndex(co, name) != -1) || Global_GetIndex(program, name) == -1){
+                return false;
+            }
+
+            for (size_t i = 0; i < call.args.count; i++)
+            {
+                if(!Is_Constant_Expression(co, ast, Ast_Child(ast, call.args, i), program)){
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        default: {
+            return false;
+        }
+    }
+}
+
+// Only functions and the null/true/false builtins are assumed to keep the value they were compiled with,
+// every other global may be reassigned at runtime.
+static bool _is_constant_global(Program* program, GlobalVar var){
+    if(var.name == symbol_intern_string("null") || var.name == symbol_intern_string("true") || var.name == symbol_intern_string("false")){
+        return true;
+    }
+
+    return IS_OBJ(var.value) && (AS_C_OBJ(var.value)->objectType == ObjectType_Code || AS_C_OBJ(var.value)->objectType == ObjectType_NativeFunction);
+}
+
+// Pure code only touches its own stack frame. It reads no mutable globals, writes no globals or members,
+// and only calls pure functions and whitelisted natives by name with a matching argument count.
+// Loops and recursion are allowed, evaluation runs with a budget.
+bool Function_IsPure(Program* program, FunctionObject* fn){
+    size_t offset = 0;
+    int64 callee_arity = -1; // Set when the previous instruction loaded a callable pure function
+
+    while(offset < array_length(fn->code)){
+        uint64_t operand = Instruction_Operand(&fn->code[offset]);
+        uint8_t opcode = fn->code[offset++];
+        size_t index_width = 1;
+
+        if(opcode == OP_WIDE){
+            opcode = fn->code[offset++];
+            index_width = 2;
+        }
+
+        int64 arity = -1;
+
+        switch (opcode)
+        {
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_POP: {
+                break;
+            }
+
+            case OP_LT:
+            case OP_GT:
+            case OP_LE:
+            case OP_GE:
+            case OP_EQ:
+            case OP_NE: {
+                break;
+            }
+
+            case OP_JMP:
+            case OP_JMP_IF_FALSE:
+            case OP_JMP_IF_NOT_LT:
+            case OP_JMP_IF_NOT_GT:
+            case OP_JMP_IF_NOT_LE:
+            case OP_JMP_IF_NOT_GE:
+            case OP_JMP_IF_NOT_EQ:
+            case OP_JMP_IF_NOT_NE: {
+                offset += index_width == 2 ? 4 : 2; // 32 bit offset after OP_WIDE
+                break;
+            }
+
+            case OP_CONST:
+            case OP_GET_LOCAL:
+            case OP_SET_LOCAL:
+            case OP_STORE_LOCAL:
+            case OP_SCOPE_EXIT:
+            case OP_RETURN: {
+                offset += index_width;
+                break;
+            }
+
+            case OP_INC_LOCAL:
+            case OP_ADD_LOCAL_CONST:
+            case OP_LOAD_LOCAL2:
+            case OP_CONST_SET_LOCAL: {
+                offset += 2;
+                break;
+            }
+
+            case OP_GET_GLOBAL: {
+                GlobalVar var = Global_Get(program, operand);
+
+                if(!_is_constant_global(program, var)){
+                    return false;
+                }
+
+                if(IS_OBJ(var.value) && AS_C_OBJ(var.value)->objectType == ObjectType_Code){
+                    FunctionObject* callee = (FunctionObject*)AS_C_OBJ(var.value);
+
+                    // Recursion is decided together with the function itself
+                    if(callee == fn || callee->purity == Purity_Pure){
+                        arity = callee->arity;
+                    }
+                }
+                else if(IS_OBJ(var.value) && AS_C_OBJ(var.value)->objectType == ObjectType_NativeFunction){
+                    NativeFunctionObject* native = (NativeFunctionObject*)AS_C_OBJ(var.value);
+
+                    if(native->pure){
+                        arity = native->arity;
+                    }
+                }
+
+                offset += index_width;
+                break;
+            }
+
+            case OP_CALL: {
+                if(callee_arity == -1 || callee_arity != operand){
+                    return false;
+                }
+
+                offset += index_width;
+                break;
+            }
+
+            default: {
+                // Global writes, members and HALT, which only main has
+                return false;
+            }
+        }
+
+        callee_arity = arity;
+    }
+
+    return true;
+}
+
+// Compiles expression into a throwaway function and runs it on a scratch VM
+bool Evaluate_Constant(FunctionObject* co, Ast* ast, NodeIndex expression, Program* program, RuntimeValue* result){
+    if(!Is_Constant_Expression(co, ast, expression, program)){
+        return false;
+    }
+
+    RuntimeValue thunk_value = Alloc_Function("(const)", 0);
+    FunctionObject* thunk = &AS_FUNCTION(thunk_value);
+
+    _generating_thunk = true;
+    generate(thunk, ast, expression, program);
+    _generating_thunk = false;
+
+    emit_index(thunk, OP_RETURN, 0);
+
+    bool evaluated = Function_IsPure(program, thunk) && vm_evaluate(program, thunk, result);
+
+    arrfree(thunk->code);
+    arrfree(thunk->constants);
+    arrfree(thunk->locals);
+    table_free(&thunk->local_table);
+    table_free(&thunk->constant_table);
+    table_free(&thunk->string_constant_table);
+    slab_free(thunk, sizeof(FunctionObject));
+
+    return evaluated;
+}
+
+// Emits the value of expression as a single constant if it can be computed now
+bool emit_evaluated(FunctionObject* co, Ast* ast, NodeIndex expression, Program* program){
+    RuntimeValue value;
+
+    if(_generating_thunk || !Evaluate_Constant(co, ast, expression, program, &value)){
+        return false;
+    }
+
+    int64 index = Value_Const_Index(co, value);
+
+    if(index == -1){
+        return false;
+    }
+
+    emit_index(co, OP_CONST, index);
+
+    return true;
+}
+
+#pragma endregion
+
 #pragma region DISASSEMBLER
 
 char* opcodeToString(uint8_t opcode){
@@ -560,7 +952,12 @@ char* opcodeToString(uint8_t opcode){
         case OP_SUB: return "SUB";
         case OP_MUL: return "MUL";
         case OP_DIV: return "DIV";
-        case OP_CMP: return "CMP";
+        case OP_LT: return "LT";
+        case OP_GT: return "GT";
+        case OP_LE: return "LE";
+        case OP_GE: return "GE";
+        case OP_EQ: return "EQ";
+        case OP_NE: return "NE";
         case OP_JMP_IF_FALSE: return "JMP_IF_FALSE";
         case OP_JMP: return "JMP";
         case OP_POP: return "POP";
@@ -572,119 +969,175 @@ char* opcodeToString(uint8_t opcode){
         case OP_SCOPE_EXIT: return "SCOPE_EXIT";
         case OP_RETURN: return "RETURN";
         case OP_GET_MEMBER: return "GET_MEMBER";
+        case OP_WIDE: return "WIDE";
+        case OP_INC_LOCAL: return "INC_LOCAL";
+        case OP_INC_GLOBAL: return "INC_GLOBAL";
+        case OP_ADD_LOCAL_CONST: return "ADD_LOCAL_CONST";
+        case OP_LOAD_LOCAL2: return "LOAD_LOCAL2";
+        case OP_CONST_SET_LOCAL: return "CONST_SET_LOCAL";
+        case OP_STORE_LOCAL: return "STORE_LOCAL";
+        case OP_STORE_GLOBAL: return "STORE_GLOBAL";
+        case OP_JMP_IF_NOT_LT: return "JMP_IF_NOT_LT";
+        case OP_JMP_IF_NOT_GT: return "JMP_IF_NOT_GT";
+        case OP_JMP_IF_NOT_LE: return "JMP_IF_NOT_LE";
+        case OP_JMP_IF_NOT_GE: return "JMP_IF_NOT_GE";
+        case OP_JMP_IF_NOT_EQ: return "JMP_IF_NOT_EQ";
+        case OP_JMP_IF_NOT_NE: return "JMP_IF_NOT_NE";
+        case OP_ADD_NUM: return "ADD_NUM";
+        case OP_ADD_STR: return "ADD_STR";
+        case OP_LT_NUM: return "LT_NUM";
+        case OP_GT_NUM: return "GT_NUM";
+        case OP_LE_NUM: return "LE_NUM";
+        case OP_GE_NUM: return "GE_NUM";
+        case OP_EQ_NUM: return "EQ_NUM";
+        case OP_NE_NUM: return "NE_NUM";
+        case OP_JMP_IF_NOT_LT_NUM: return "JMP_IF_NOT_LT_NUM";
+        case OP_JMP_IF_NOT_GT_NUM: return "JMP_IF_NOT_GT_NUM";
+        case OP_JMP_IF_NOT_LE_NUM: return "JMP_IF_NOT_LE_NUM";
+        case OP_JMP_IF_NOT_GE_NUM: return "JMP_IF_NOT_GE_NUM";
+        case OP_JMP_IF_NOT_EQ_NUM: return "JMP_IF_NOT_EQ_NUM";
+        case OP_JMP_IF_NOT_NE_NUM: return "JMP_IF_NOT_NE_NUM";
+        case OP_INC_LOCAL_NUM: return "INC_LOCAL_NUM";
+        case OP_INC_GLOBAL_NUM: return "INC_GLOBAL_NUM";
+        case OP_ADD_LOCAL_CONST_NUM: return "ADD_LOCAL_CONST_NUM";
         default: {
             return "NOT IMPLEMENTED";
         }
     }
 }
 
-char* cmpCodeToString(uint8_t cmpcode){
-    switch (cmpcode)
-    {
-        case OP_CMP_GT: return "GT";
-        case OP_CMP_LT: return "LT";
-        case OP_CMP_EQ: return "EQ";
-        case OP_CMP_GE: return "GE";
-        case OP_CMP_LE: return "LE";
-        case OP_CMP_NE: return "NE";
-        default: return "NOT IMPLEMENTED";
-    }
-}
-
 void Disassemble(Program* global){
 
     for (size_t i = 0; i < array_length(global->functions); i++)
     {
         FunctionObject* co = global->functions[i];
 
-    printf("\n------------------ %s DISASSEMBLY ------------------\n\n", co->name);
+    printf("\n------------------ %s DISASSEMBLY (%llu bytes) ------------------\n\n", co->name, (uint64)array_length(co->code));
 
 size_t offset = 0;
     while(offset < array_length(co->code)){
-        uint8_t opcode = co->code[offset];
-        uint64_t args;
+        size_t instruction_offset = offset;
+        uint8_t opcode = co->code[offset++];
+        bool wide = false;
+
+        if(opcode == OP_WIDE){
+            wide = true;
+            opcode = co->code[offset++];
+        }
 
-        memcpy(&args, &co->code[offset + 1], sizeof(uint64_t));
+        // Index operands are 8 bit, or 16 bit after OP_WIDE
+        uint64_t args = Instruction_Operand(&co->code[instruction_offset]);
+        size_t index_width = wide ? 2 : 1;
 
-        uint8_t small_args = co->code[offset + 1];
+        uint8_t small_args = (uint8_t)args;
+        size_t jump_width = wide ? 4 : 2;
 
         char* opcode_string = opcodeToString(opcode);
+        opcode = Opcode_Generic(opcode); // Quickened opcodes have the operands of their generic one
 
-        printf("0x%04X", offset);
-        printf("%-10s", "\t");
+        printf("0x%04X", instruction_offset);
+        printf("%-10s", wide ? "\tW" : "\t");
         printf("%-20s", opcode_string);
 
         if(opcode == OP_CONST){
             printf("0x%04X", args);
             printf(" (%s)", RuntimeValue_ToString(co->constants[args]));
-            offset += 8;
+            offset += index_width;
         }
 
         if(opcode == OP_GET_MEMBER){
-            printf("0x%04X", args);
-            printf(" (%s)", RuntimeValue_ToString(co->constants[args]));
-            offset += 8;
-        }
-
-        if(opcode == OP_CMP){
-            printf("0x%01X", small_args);
-            printf("%-4s", " ");
-            printf("(%s)", cmpCodeToString(small_args));    
-            offset += 1;
+            printf("%-7u", args);
+            offset += index_width;
         }
 
         if(opcode == OP_GET_GLOBAL){
             printf("%-7u", args);
-            printf("(%s)", Global_Get(global, args).name);
-            offset += 8;
+            printf("(%s)", symbol_name(Global_Get(global, args).name));
+            offset += index_width;
         }
 
         if(opcode == OP_SET_GLOBAL){
             printf("%-7u", args);
-            printf("(%s)", Global_Get(global, args).name);
-            offset += 8;
+            printf("(%s)", symbol_name(Global_Get(global, args).name));
+            offset += index_width;
         }
 
         if(opcode == OP_GET_LOCAL){
             printf("%-7u", args);
-            printf("(%s)", Local_Get(co, args).name);
-            offset += 8;
+            printf("(%s)", symbol_name(Local_Get(co, args).name));
+            offset += index_width;
         }
 
         if(opcode == OP_SET_LOCAL){
             printf("%-7u", args);
-            printf("(%s)", Local_Get(co, args).name);
-            offset += 8;
+            printf("(%s)", symbol_name(Local_Get(co, args).name));
+            offset += index_width;
         }
 
         if(opcode == OP_SCOPE_EXIT){
             printf("%-7u", args);
-            // printf("(%s)", Global_Get(global, args).name);
-            offset += 8;
+            offset += index_width;
         }
 
         if(opcode == OP_RETURN){
             printf("%-7u", args);
-            // printf("(%s)", Global_Get(global, args).name);
-            offset += 8;
+            offset += index_width;
         }
 
         if(opcode == OP_JMP){
-            printf("0x%04X", args);
-            offset += 8;
+            printf("0x%04X", Jump_Target(co->code, instruction_offset));
+            offset += jump_width;
         }
 
         if(opcode == OP_CALL){
             printf("%-7u", args);
-            offset += 8;
+            offset += index_width;
         }
 
-        if(opcode == OP_JMP_IF_FALSE){
-            printf("0x%04X", args);
-            offset += 8;
+        if(opcode == OP_JMP_IF_FALSE || (opcode >= OP_JMP_IF_NOT_LT && opcode <= OP_JMP_IF_NOT_NE)){
+            printf("0x%04X", Jump_Target(co->code, instruction_offset));
+            offset += jump_width;
+        }
+
+        // Superinstructions always have one byte operands
+        uint8_t second_arg = Instruction_Second(&co->code[instruction_offset]);
+
+        if(opcode == OP_INC_LOCAL || opcode == OP_ADD_LOCAL_CONST){
+            printf("%-7u", small_args);
+            printf("(%s) + %s", symbol_name(Local_Get(co, small_args).name), RuntimeValue_ToString(co->constants[second_arg]));
+            offset += 2;
+        }
+
+        if(opcode == OP_INC_GLOBAL){
+            printf("%-7u", small_args);
+            printf("(%s) + %s", symbol_name(Global_Get(global, small_args).name), RuntimeValue_ToString(co->constants[second_arg]));
+            offset += 2;
+        }
+
+        if(opcode == OP_LOAD_LOCAL2){
+            printf("%-7u", small_args);
+            printf("(%s) %u (%s)", symbol_name(Local_Get(co, small_args).name), second_arg, symbol_name(Local_Get(co, second_arg).name));
+            offset += 2;
+        }
+
+        if(opcode == OP_CONST_SET_LOCAL){
+            printf("0x%04X", small_args);
+            printf(" (%s) -> %u (%s)", RuntimeValue_ToString(co->constants[small_args]), second_arg, symbol_name(Local_Get(co, second_arg).name));
+            offset += 2;
+        }
+
+        if(opcode == OP_STORE_LOCAL){
+            printf("%-7u", small_args);
+            printf("(%s)", symbol_name(Local_Get(co, small_args).name));
+            offset += 1;
+        }
+
+        if(opcode == OP_STORE_GLOBAL){
+            printf("%-7u", small_args);
+            printf("(%s)", symbol_name(Global_Get(global, small_args).name));
+            offset += 1;
         }
 
-        offset++;
         printf("\n");
     }
 
@@ -0,0 +1,396 @@
+#pragma once
+
+typedef struct Heap Heap;
+typedef struct GCStats GCStats;
+
+// Generational collector for the objects a running script allocates, strings and type instances.
+// Functions, natives and type infos live as long as their Program and are never collected.
+//
+// New objects are bumped out of the nursery, a fixed region that a minor collection empties by copying
+// whatever survived into the old space. Old objects are single slab blocks, linked into the heap registry
+// through Object.next, and collected by mark and sweep once the old space has doubled since the last
+// major collection. A young object keeps its forwarding address in Object.next once it has been copied.
+//
+// Allocating never collects. When the nursery runs low or the old space is due, a collection is left
+// pending and runs at the next safepoint, a backward jump or a call, where every live value is on the VM
+// stack. Roots are the VM stack up to sp, the functions on the callstack, Program->globals, the const
+// values and the constant pools of Program->functions. Minor collections only look at the stack and at
+// the globals whose card was dirtied by a store since the last one. The nursery is emptied before a
+// program starts, so constant pools and const values never point into it while it runs.
+
+struct GCStats {
+    uint64 collections; // Major
+    uint64 minor_collections;
+    uint64 bytes_live; // Left in the old space after the last major collection
+    uint64 bytes_promoted; // Copied out of the nursery
+    uint64 bytes_reclaimed; // By major collections
+    uint64 objects_freed;
+    int64 pause_total; // Microseconds
+    int64 pause_max;
+    int64 minor_pause_total;
+    int64 minor_pause_max;
+};
+
+struct Heap {
+    Object* objects; // Registry of the old space
+    size_t bytes; // In the old space right now
+    size_t next_collection; // Old space size that makes a major collection due
+    uint8_t* nursery;
+    uint8_t* nursery_top; // Next free byte
+    uint8_t* nursery_end;
+    Object** promoted; // Copied by the running minor collection, their fields are still to be scanned
+    GCStats stats;
+};
+
+#define GC_MIN_THRESHOLD (1024 * 1024)
+#define GC_GROWTH 2 // The next collection is due once the live heap has grown this many times
+#define GC_NURSERY_SIZE (512 * 1024)
+#define GC_NURSERY_RESERVE (64 * 1024) // Left for what is allocated between asking for a collection and the safepoint
+#define GC_OBJECT_ALIGN 8
+
+#define IS_YOUNG(object) ((uint8_t*)(object) >= _heap.nursery && (uint8_t*)(object) < _heap.nursery_end)
+
+Heap _heap = { .objects = NULL, .bytes = 0, .next_collection = GC_MIN_THRESHOLD };
+
+// Off puts every object straight into the old space
+bool _gc_nursery_enabled = true;
+
+// Registers an object the collector owns, size is everything that is freed with it
+void gc_track(Object* object, size_t size){
+    object->marked = false;
+    object->next = _heap.objects;
+    _heap.objects = object;
+    _heap.bytes += size;
+
+    if(_heap.bytes >= _heap.next_collection){
+        _gc_pending = true;
+    }
+}
+
+// Memory for an object of size bytes, from the nursery if it still fits there
+Object* gc_alloc(size_t size){
+    if(_heap.nursery == NULL && _gc_nursery_enabled){
+        _heap.nursery = malloc(GC_NURSERY_SIZE);
+        _heap.nursery_top = _heap.nursery;
+        _heap.nursery_end = _heap.nursery + GC_NURSERY_SIZE;
+    }
+
+    size_t aligned = (size + GC_OBJECT_ALIGN - 1) & ~(size_t)(GC_OBJECT_ALIGN - 1);
+
+    if(_gc_nursery_enabled){
+        if(aligned <= (size_t)(_heap.nursery_end - _heap.nursery_top)){
+            Object* object = (Object*)_heap.nursery_top;
+            _heap.nursery_top += aligned;
+
+            if(_heap.nursery_top > _heap.nursery_end - GC_NURSERY_RESERVE){
+                _gc_pending = true;
+            }
+
+            object->marked = false;
+            object->next = NULL;
+            return object;
+        }
+
+        // Full, or too large for it
+        _gc_pending = true;
+    }
+
+    return gc_alloc_old(size);
+}
+
+// Memory for an object that is never moved
+Object* gc_alloc_old(size_t size){
+    Object* object = slab_alloc(size);
+    gc_track(object, size);
+    return object;
+}
+
+// Bytes of the block an object was allocated in, strings and instances keep their characters and members in it
+static size_t _gc_object_size(Object* object){
+    switch (object->objectType)
+    {
+        case ObjectType_String: {
+            StringObject* string = (StringObject*)object;
+            return sizeof(StringObject) + string->length + 1;
+        }
+
+        case ObjectType_TypeInstance: {
+            TypeInstanceObject* instance = (TypeInstanceObject*)object;
+            return sizeof(TypeInstanceObject) + instance->members_length * sizeof(MemberVar);
+        }
+
+        // Functions, natives and types are never allocated through the collector
+        default: {
+            printf("\033[0;31mGC: Object type %d is not managed by the collector\033[0m\n", object->objectType);
+            exit(1);
+        }
+    }
+}
+
+#pragma region MINOR
+
+// Copies a young object to the old space once, later calls return the copy
+static Object* _gc_promote(Object* object){
+    if(object->next != NULL){
+        return object->next;
+    }
+
+    size_t size = _gc_object_size(object);
+    Object* copy = slab_alloc(size);
+    memcpy(copy, object, size);
+
+    // Characters and members come along, the pointers to them have to follow
+    if(object->objectType == ObjectType_String){
+        ((StringObject*)copy)->string = (char*)((StringObject*)copy + 1);
+    }
+    else{
+        ((TypeInstanceObject*)copy)->members = (MemberVar*)((TypeInstanceObject*)copy + 1);
+        array_push(_heap.promoted, copy);
+    }
+
+    gc_track(copy, size);
+    object->next = copy;
+
+    _heap.stats.bytes_promoted += size;
+
+    return copy;
+}
+
+// Points slot at the old copy when it holds a young object
+static inline void _gc_evacuate(RuntimeValue* slot){
+    if(IS_OBJ(*slot) && IS_YOUNG(AS_C_OBJ(*slot))){
+        *slot = OBJ_VAL(_gc_promote(AS_C_OBJ(*slot)));
+    }
+}
+
+// Promoted instances may still point into the nursery, strings point at nothing
+static void _gc_scan_promoted(){
+    while(array_length(_heap.promoted) > 0){
+        TypeInstanceObject* instance = (TypeInstanceObject*)array_pop(_heap.promoted);
+
+        for (size_t i = 0; i < instance->members_length; i++) {
+            _gc_evacuate(&instance->members[i].value);
+        }
+    }
+}
+
+// Empties the nursery. Everything reachable from [stack, sp) and the dirty global cards is copied to the
+// old space, so the work is proportional to what survives. all_roots also looks at every global, the
+// const values and the constant pools, for when the nursery may hold things the compiler made.
+static void _gc_minor(Program* global, RuntimeValue* stack, RuntimeValue* sp, bool all_roots){
+    int64 begin = timestamp();
+
+    for (RuntimeValue* slot = stack; slot < sp; slot++) {
+        _gc_evacuate(slot);
+    }
+
+    size_t global_count = array_length(global->globals);
+
+    for (size_t card = 0; card < array_length(global->global_cards); card++) {
+        if(!global->global_cards[card] && !all_roots){
+            continue;
+        }
+
+        global->global_cards[card] = 0;
+
+        for (size_t i = card << GC_CARD_SHIFT; i < global_count && i < (card + 1) << GC_CARD_SHIFT; i++) {
+            _gc_evacuate(&global->globals[i].value);
+        }
+    }
+
+    if(all_roots){
+        for (size_t i = 0; i < array_length(global->const_values); i++) {
+            _gc_evacuate(&global->const_values[i]);
+        }
+
+        for (size_t i = 0; i < array_length(global->functions); i++) {
+            FunctionObject* fn = global->functions[i];
+
+            for (size_t j = 0; j < array_length(fn->constants); j++) {
+                _gc_evacuate(&fn->constants[j]);
+            }
+        }
+    }
+
+    _gc_scan_promoted();
+
+    _heap.nursery_top = _heap.nursery;
+
+    int64 pause = timestamp() - begin;
+
+    _heap.stats.minor_collections++;
+    _heap.stats.minor_pause_total += pause;
+    _heap.stats.minor_pause_max = pause > _heap.stats.minor_pause_max ? pause : _heap.stats.minor_pause_max;
+}
+
+// Moves everything the compiler left in the nursery to the old space. Runs before a program starts, so
+// nothing that is compiled into code can move later on.
+void gc_tenure(Program* global){
+    if(_heap.nursery != NULL){
+        _gc_minor(global, NULL, NULL, true);
+    }
+
+    _gc_pending = _heap.bytes >= _heap.next_collection;
+}
+
+#pragma endregion
+
+#pragma region MAJOR
+
+static void _gc_mark_value(RuntimeValue value){
+    if(!IS_OBJ(value)){
+        return;
+    }
+
+    Object* object = AS_C_OBJ(value);
+
+    if(object->objectType != ObjectType_String && object->objectType != ObjectType_TypeInstance){
+        return;
+    }
+
+    if(object->marked){
+        return;
+    }
+
+    object->marked = true;
+
+    if(object->objectType == ObjectType_TypeInstance){
+        TypeInstanceObject* instance = (TypeInstanceObject*)object;
+
+        for (size_t i = 0; i < instance->members_length; i++) {
+            _gc_mark_value(instance->members[i].value);
+        }
+    }
+}
+
+static void _gc_mark_function(FunctionObject* fn){
+    for (size_t i = 0; i < array_length(fn->constants); i++) {
+        _gc_mark_value(fn->constants[i]);
+    }
+}
+
+// Returns the bytes given back
+static size_t _gc_free(Object* object){
+    size_t size = _gc_object_size(object);
+
+    // The intern table is weak
+    if(object->objectType == ObjectType_String && ((StringObject*)object)->interned){
+        String_Unintern((StringObject*)object);
+    }
+
+    slab_free(object, size);
+
+    return size;
+}
+
+static void _gc_sweep(){
+    Object** link = &_heap.objects;
+
+    while(*link != NULL){
+        Object* object = *link;
+
+        if(object->marked){
+            object->marked = false;
+            link = &object->next;
+            continue;
+        }
+
+        *link = object->next;
+
+        size_t size = _gc_free(object);
+        _heap.bytes -= size;
+        _heap.stats.bytes_reclaimed += size;
+        _heap.stats.objects_freed++;
+    }
+}
+
+// Mark and sweep of the old space, runs right after a minor collection so nothing is young
+static void _gc_major(Program* global, RuntimeValue* stack, RuntimeValue* sp, Frame* frames, Frame* csp){
+    int64 begin = timestamp();
+
+    for (RuntimeValue* slot = stack; slot < sp; slot++) {
+        _gc_mark_value(*slot);
+    }
+
+    for (Frame* frame = frames; frame < csp; frame++) {
+        _gc_mark_function(frame->fn);
+    }
+
+    for (size_t i = 0; i < array_length(global->globals); i++) {
+        _gc_mark_value(global->globals[i].value);
+    }
+
+    for (size_t i = 0; i < array_length(global->const_values); i++) {
+        _gc_mark_value(global->const_values[i]);
+    }
+
+    for (size_t i = 0; i < array_length(global->functions); i++) {
+        _gc_mark_function(global->functions[i]);
+    }
+
+    _gc_sweep();
+
+    _heap.next_collection = _heap.bytes * GC_GROWTH > GC_MIN_THRESHOLD ? _heap.bytes * GC_GROWTH : GC_MIN_THRESHOLD;
+
+    int64 pause = timestamp() - begin;
+
+    _heap.stats.collections++;
+    _heap.stats.bytes_live = _heap.bytes;
+    _heap.stats.pause_total += pause;
+    _heap.stats.pause_max = pause > _heap.stats.pause_max ? pause : _heap.stats.pause_max;
+}
+
+#pragma endregion
+
+// Collects everything that is not reachable from global or the values in [stack, sp). frames up to csp
+// are the callstack of the VM, NULL for engines that keep none. Objects move, values in the stack and
+// the globals are updated.
+void gc_collect(Program* global, RuntimeValue* stack, RuntimeValue* sp, Frame* frames, Frame* csp){
+    _gc_minor(global, stack, sp, false);
+
+    if(_heap.bytes >= _heap.next_collection){
+        _gc_major(global, stack, sp, frames, csp);
+    }
+
+    _gc_pending = false;
+}
+
+// Called by the interpreter, JIT and AOT code when a collection is pending. sp is the top of the running
+// frame, everything below it is live.
+void gc_safepoint(VM* vm, RuntimeValue* sp){
+    // Compile time evaluation runs before the program is complete, it leaves the collection for later
+    if(!vm->gc){
+        return;
+    }
+
+    gc_collect(vm->global, vm->stack, sp, vm->callstack, vm->csp);
+}
+
+// Frees every object the collector owns, once the program they belong to is done with
+void gc_free_all(){
+    while(_heap.objects != NULL){
+        Object* object = _heap.objects;
+        _heap.objects = object->next;
+        _gc_free(object);
+    }
+
+    _heap.bytes = 0;
+    _heap.next_collection = GC_MIN_THRESHOLD;
+    _heap.nursery_top = _heap.nursery;
+    _gc_pending = false;
+}
+
+GCStats gc_stats(){
+    return _heap.stats;
+}
+
+void gc_print_stats(){
+    GCStats stats = gc_stats();
+
+    printf("\n------------------ GC (%llu minor, %llu major) ------------------\n", stats.minor_collections, stats.collections);
+    printf("Live: %llu KB, old space: %llu KB\n", stats.bytes_live / 1024, (uint64)_heap.bytes / 1024);
+    printf("Promoted: %llu KB\n", stats.bytes_promoted / 1024);
+    printf("Reclaimed: %llu KB in %llu objects\n", stats.bytes_reclaimed / 1024, stats.objects_freed);
+    printf("Minor pause: %lld us total, %lld us max\n", stats.minor_pause_total, stats.minor_pause_max);
+    printf("Major pause: %lld us total, %lld us max\n", stats.pause_total, stats.pause_max);
+}
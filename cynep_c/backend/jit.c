@@ -0,0 +1,746 @@
+#pragma once
+
+typedef struct Jit Jit;
+typedef struct JitFixup JitFixup;
+
+// Baseline JIT for Linux x86-64. A hot function's bytecode is translated one instruction at a time into
+// machine code that works on the same VM stack and locals as the interpreter, so the two can call each
+// other freely. Numbers are checked and computed inline, strings, natives and members call back into
+// the runtime. Functions are compiled once their call and back-edge counter passes JIT_HOT_THRESHOLD.
+// A frame that is still interpreted moves into the machine code at its next backward jump (OSR), which
+// is how the loop in main, called only once, gets compiled.
+//
+// Register use in JIT code:
+//   rbx  VM stack pointer, next free slot
+//   r12  base pointer, local 0
+//   r13  TRUE_VAL
+//   r14  globals
+//   r15  VM
+//   rbp  QUIET_NAN, for number checks
+// All of them are callee saved, so runtime calls only clobber scratch registers.
+
+RuntimeValue*   jit_call(VM* vm, RuntimeValue* sp, uint64 arg_count);
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct JitFixup {
+    size_t position; // Of the rel32 in the machine code
+    size_t target; // Bytecode offset
+};
+
+struct Jit {
+    uint8_t* code;
+    JitFixup* fixups;
+    size_t* native_offsets; // Bytecode offset -> machine code offset
+    JitLoop* loops; // Entries are machine code offsets until installed
+    Program* global;
+};
+
+#pragma region X86_64
+
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RSP 4
+#define RBP 5
+#define RSI 6
+#define RDI 7
+#define R12 12
+#define R13 13
+#define R14 14
+#define R15 15
+
+#define XMM0 0
+#define XMM1 1
+
+#define CC_P  0xA
+#define CC_NP 0xB
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_AE 0x3
+#define CC_A  0x7
+
+static void _jit_byte(Jit* jit, uint8_t value){
+    array_push(jit->code, value);
+}
+
+static void _jit_u32(Jit* jit, uint32_t value){
+    memcpy(arraddnptr(jit->code, 4), &value, 4);
+}
+
+static void _jit_u64(Jit* jit, uint64_t value){
+    memcpy(arraddnptr(jit->code, 8), &value, 8);
+}
+
+// One instruction with a ModRM operand. Opcodes above 0xFF are two bytes starting with 0x0F. rm is a
+// register, or a base register with a 32 bit displacement when memory is set.
+static void _jit_op(Jit* jit, uint8_t prefix, bool wide, uint16_t opcode, int reg, int rm, bool memory, int32_t disp){
+    if(prefix != 0){
+        _jit_byte(jit, prefix);
+    }
+
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+
+    if(rex != 0x40){
+        _jit_byte(jit, rex);
+    }
+
+    if(opcode > 0xFF){
+        _jit_byte(jit, opcode >> 8);
+    }
+
+    _jit_byte(jit, opcode & 0xFF);
+
+    if(memory){
+        _jit_byte(jit, 0x80 | ((reg & 7) << 3) | (rm & 7));
+
+        if((rm & 7) == RSP){
+            _jit_byte(jit, 0x24); // SIB for rsp and r12 bases
+        }
+
+        _jit_u32(jit, disp);
+    }
+    else{
+        _jit_byte(jit, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+}
+
+static void _jit_load(Jit* jit, int reg, int base, int32_t disp)  { _jit_op(jit, 0, true, 0x8B, reg, base, true, disp); }
+static void _jit_store(Jit* jit, int base, int32_t disp, int reg) { _jit_op(jit, 0, true, 0x89, reg, base, true, disp); }
+static void _jit_mov(Jit* jit, int dst, int src)                  { _jit_op(jit, 0, true, 0x89, src, dst, false, 0); }
+static void _jit_and(Jit* jit, int dst, int src)                  { _jit_op(jit, 0, true, 0x21, src, dst, false, 0); }
+static void _jit_cmp(Jit* jit, int first, int second)             { _jit_op(jit, 0, true, 0x39, second, first, false, 0); }
+static void _jit_add(Jit* jit, int dst, int src)                  { _jit_op(jit, 0, true, 0x01, src, dst, false, 0); }
+
+static void _jit_add_imm(Jit* jit, int reg, int32_t value){
+    if(value == 0){
+        return;
+    }
+
+    _jit_op(jit, 0, true, 0x81, value > 0 ? 0 : 5, reg, false, 0);
+    _jit_u32(jit, value > 0 ? value : -value);
+}
+
+static void _jit_mov_imm(Jit* jit, int reg, uint64_t value){
+    _jit_byte(jit, 0x48 | ((reg & 8) ? 1 : 0));
+    _jit_byte(jit, 0xB8 + (reg & 7));
+    _jit_u64(jit, value);
+}
+
+static void _jit_push(Jit* jit, int reg){
+    if(reg & 8) _jit_byte(jit, 0x41);
+    _jit_byte(jit, 0x50 + (reg & 7));
+}
+
+static void _jit_pop(Jit* jit, int reg){
+    if(reg & 8) _jit_byte(jit, 0x41);
+    _jit_byte(jit, 0x58 + (reg & 7));
+}
+
+static void _jit_call(Jit* jit, void* function){
+    _jit_mov_imm(jit, RAX, (uint64_t)(uintptr_t)function);
+    _jit_op(jit, 0, false, 0xFF, 2, RAX, false, 0);
+}
+
+static void _jit_movq_to_xmm(Jit* jit, int xmm, int reg)   { _jit_op(jit, 0x66, true, 0x0F6E, xmm, reg, false, 0); }
+static void _jit_movq_from_xmm(Jit* jit, int reg, int xmm) { _jit_op(jit, 0x66, true, 0x0F7E, xmm, reg, false, 0); }
+static void _jit_sse(Jit* jit, uint16_t opcode, int xmm, int other) { _jit_op(jit, 0xF2, false, opcode, xmm, other, false, 0); }
+static void _jit_ucomisd(Jit* jit, int first, int second)  { _jit_op(jit, 0x66, false, 0x0F2E, first, second, false, 0); }
+static void _jit_setcc(Jit* jit, int cc, int reg)           { _jit_op(jit, 0, false, 0x0F90 | cc, 0, reg, false, 0); }
+
+// Returns the position of the rel32 to patch
+static size_t _jit_jcc(Jit* jit, int cc){
+    _jit_byte(jit, 0x0F);
+    _jit_byte(jit, 0x80 | cc);
+    _jit_u32(jit, 0);
+
+    return array_length(jit->code) - 4;
+}
+
+static size_t _jit_jmp(Jit* jit){
+    _jit_byte(jit, 0xE9);
+    _jit_u32(jit, 0);
+
+    return array_length(jit->code) - 4;
+}
+
+// Points the rel32 at position to the current end of the code
+static void _jit_bind(Jit* jit, size_t position){
+    int32_t relative = (int32_t)(array_length(jit->code) - (position + 4));
+    memcpy(&jit->code[position], &relative, 4);
+}
+
+static void _jit_jump_to(Jit* jit, size_t position, size_t target){
+    JitFixup fixup = { position, target };
+    array_push(jit->fixups, fixup);
+}
+
+#pragma endregion
+
+#pragma region TEMPLATES
+
+#define JIT_SLOT(i) ((int32_t)((i) * sizeof(RuntimeValue)))
+#define JIT_GLOBAL(i) ((int32_t)((i) * sizeof(GlobalVar) + offsetof(GlobalVar, value)))
+
+// Jumps to the returned position when reg is not a number, clobbers rdx
+static size_t _jit_check_number(Jit* jit, int reg){
+    _jit_mov(jit, RDX, reg);
+    _jit_and(jit, RDX, RBP);
+    _jit_cmp(jit, RDX, RBP);
+
+    return _jit_jcc(jit, CC_E);
+}
+
+static void _jit_push_value(Jit* jit, int reg){
+    _jit_store(jit, RBX, 0, reg);
+    _jit_add_imm(jit, RBX, 8);
+}
+
+// rax = rax + rcx. The number check of rcx is left out when it is known to be a number.
+static void _jit_add_values(Jit* jit, bool second_is_number){
+    size_t first_slow = _jit_check_number(jit, RAX);
+    size_t second_slow = second_is_number ? 0 : _jit_check_number(jit, RCX);
+
+    _jit_movq_to_xmm(jit, XMM0, RAX);
+    _jit_movq_to_xmm(jit, XMM1, RCX);
+    _jit_sse(jit, 0x0F58, XMM0, XMM1);
+    _jit_movq_from_xmm(jit, RAX, XMM0);
+    size_t done = _jit_jmp(jit);
+
+    _jit_bind(jit, first_slow);
+    if(!second_is_number) _jit_bind(jit, second_slow);
+
+    _jit_mov(jit, RDI, RAX);
+    _jit_mov(jit, RSI, RCX);
+    _jit_call(jit, VM_Add);
+
+    _jit_bind(jit, done);
+}
+
+// al = rax <compare> rcx, opcode is one of OP_LT..OP_NE
+static void _jit_compare_values(Jit* jit, uint8_t opcode){
+    size_t first_slow = _jit_check_number(jit, RAX);
+    size_t second_slow = _jit_check_number(jit, RCX);
+
+    _jit_movq_to_xmm(jit, XMM0, RAX);
+    _jit_movq_to_xmm(jit, XMM1, RCX);
+
+    // Unordered sets ZF, PF and CF, so A and AE are false for NaN like in C. Less is greater swapped.
+    switch (opcode)
+    {
+        case OP_LT: _jit_ucomisd(jit, XMM1, XMM0); _jit_setcc(jit, CC_A, RAX);  break;
+        case OP_LE: _jit_ucomisd(jit, XMM1, XMM0); _jit_setcc(jit, CC_AE, RAX); break;
+        case OP_GT: _jit_ucomisd(jit, XMM0, XMM1); _jit_setcc(jit, CC_A, RAX);  break;
+        case OP_GE: _jit_ucomisd(jit, XMM0, XMM1); _jit_setcc(jit, CC_AE, RAX); break;
+        case OP_EQ: {
+            _jit_ucomisd(jit, XMM0, XMM1);
+            _jit_setcc(jit, CC_E, RAX);
+            _jit_setcc(jit, CC_NP, RCX);
+            _jit_op(jit, 0, false, 0x20, RCX, RAX, false, 0); // and al, cl
+            break;
+        }
+        case OP_NE: {
+            _jit_ucomisd(jit, XMM0, XMM1);
+            _jit_setcc(jit, CC_NE, RAX);
+            _jit_setcc(jit, CC_P, RCX);
+            _jit_op(jit, 0, false, 0x08, RCX, RAX, false, 0); // or al, cl
+            break;
+        }
+    }
+
+    size_t done = _jit_jmp(jit);
+
+    _jit_bind(jit, first_slow);
+    _jit_bind(jit, second_slow);
+
+    _jit_mov(jit, RSI, RAX);
+    _jit_mov(jit, RDX, RCX);
+    _jit_mov_imm(jit, RDI, opcode);
+    _jit_call(jit, VM_Compare);
+
+    _jit_bind(jit, done);
+}
+
+static void _jit_prologue(Jit* jit, Program* global){
+    _jit_push(jit, RBX);
+    _jit_push(jit, RBP);
+    _jit_push(jit, R12);
+    _jit_push(jit, R13);
+    _jit_push(jit, R14);
+    _jit_push(jit, R15);
+    _jit_add_imm(jit, RSP, -8); // Keeps calls 16 byte aligned
+
+    _jit_mov(jit, R15, RDI);
+    _jit_mov(jit, R12, RSI);
+    _jit_mov(jit, RBX, RDX);
+    _jit_mov_imm(jit, RBP, QUIET_NAN);
+    _jit_mov_imm(jit, R13, TRUE_VAL);
+    _jit_mov_imm(jit, R14, (uint64_t)(uintptr_t)global->globals);
+}
+
+// Returns the stack pointer
+static void _jit_epilogue(Jit* jit){
+    _jit_mov(jit, RAX, RBX);
+    _jit_add_imm(jit, RSP, 8);
+    _jit_pop(jit, R15);
+    _jit_pop(jit, R14);
+    _jit_pop(jit, R13);
+    _jit_pop(jit, R12);
+    _jit_pop(jit, RBP);
+    _jit_pop(jit, RBX);
+    _jit_byte(jit, 0xC3);
+}
+
+// GLOBAL_BARRIER for a store to global index. The card table is complete once the program is compiled,
+// so its address is a constant. Clobbers rcx.
+static void _jit_global_barrier(Jit* jit, uint64 index){
+    _jit_mov_imm(jit, RCX, (uint64_t)(uintptr_t)&jit->global->global_cards[index >> GC_CARD_SHIFT]);
+    _jit_op(jit, 0, false, 0xC6, 0, RCX, true, 0); // mov byte [rcx], 1
+    _jit_byte(jit, 1);
+}
+
+// Collects if the heap asked for it. Everything is on the VM stack already. Objects may move, but no
+// register holds one across a safepoint.
+static void _jit_safepoint(Jit* jit){
+    _jit_mov_imm(jit, RAX, (uint64_t)(uintptr_t)&_gc_pending);
+    _jit_op(jit, 0, false, 0x0FB6, RAX, RAX, true, 0); // movzx eax, byte [rax]
+    _jit_op(jit, 0, false, 0x84, RAX, RAX, false, 0); // test al, al
+    size_t skip = _jit_jcc(jit, CC_E);
+
+    _jit_mov(jit, RDI, R15);
+    _jit_mov(jit, RSI, RBX);
+    _jit_call(jit, gc_safepoint);
+
+    _jit_bind(jit, skip);
+}
+
+static RuntimeValue _jit_get_member(RuntimeValue instance_value, uint64 index){
+    TypeInstanceObject instance = AS_TYPEINSTANCE(instance_value);
+    return Member_Get(&instance, index).value;
+}
+
+// Emits the instruction at offset, returns false for instructions the JIT does not handle
+static bool _jit_instruction(Jit* jit, FunctionObject* fn, size_t offset){
+    uint8_t* code = &fn->code[offset];
+    bool wide = code[0] == OP_WIDE;
+    uint8_t opcode = Opcode_Generic(code[wide]);
+
+    uint64 operand = Instruction_Operand(code);
+    uint8_t second = Instruction_Second(code); // Superinstructions only
+    size_t target = Opcode_IsJump(opcode) ? Jump_Target(fn->code, offset) : 0;
+
+    switch (opcode)
+    {
+        case OP_CONST: {
+            _jit_mov_imm(jit, RAX, fn->constants[operand]);
+            _jit_push_value(jit, RAX);
+            break;
+        }
+
+        case OP_ADD: {
+            _jit_load(jit, RAX, RBX, -16);
+            _jit_load(jit, RCX, RBX, -8);
+            _jit_add_values(jit, false);
+            _jit_store(jit, RBX, -16, RAX);
+            _jit_add_imm(jit, RBX, -8);
+            break;
+        }
+
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV: {
+            // Like the interpreter, these assume numbers
+            uint16_t sse = opcode == OP_SUB ? 0x0F5C : opcode == OP_MUL ? 0x0F59 : 0x0F5E;
+
+            _jit_op(jit, 0xF2, false, 0x0F10, XMM0, RBX, true, -16);
+            _jit_op(jit, 0xF2, false, sse, XMM0, RBX, true, -8);
+            _jit_op(jit, 0xF2, false, 0x0F11, XMM0, RBX, true, -16);
+            _jit_add_imm(jit, RBX, -8);
+            break;
+        }
+
+        case OP_LT:
+        case OP_GT:
+        case OP_LE:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE: {
+            _jit_load(jit, RAX, RBX, -16);
+            _jit_load(jit, RCX, RBX, -8);
+            _jit_compare_values(jit, opcode);
+
+            // FALSE_VAL + 1 is TRUE_VAL
+            _jit_op(jit, 0, false, 0x0FB6, RAX, RAX, false, 0); // movzx eax, al
+            _jit_mov_imm(jit, RCX, FALSE_VAL);
+            _jit_add(jit, RAX, RCX);
+            _jit_store(jit, RBX, -16, RAX);
+            _jit_add_imm(jit, RBX, -8);
+            break;
+        }
+
+        case OP_JMP_IF_NOT_LT:
+        case OP_JMP_IF_NOT_GT:
+        case OP_JMP_IF_NOT_LE:
+        case OP_JMP_IF_NOT_GE:
+        case OP_JMP_IF_NOT_EQ:
+        case OP_JMP_IF_NOT_NE: {
+            _jit_load(jit, RAX, RBX, -16);
+            _jit_load(jit, RCX, RBX, -8);
+            _jit_add_imm(jit, RBX, -16);
+            _jit_compare_values(jit, OP_LT + (opcode - OP_JMP_IF_NOT_LT));
+
+            _jit_op(jit, 0, false, 0x84, RAX, RAX, false, 0); // test al, al
+            _jit_jump_to(jit, _jit_jcc(jit, CC_E), target);
+            break;
+        }
+
+        case OP_JMP_IF_FALSE: {
+            _jit_add_imm(jit, RBX, -8);
+            _jit_load(jit, RAX, RBX, 0);
+            _jit_cmp(jit, RAX, R13);
+            _jit_jump_to(jit, _jit_jcc(jit, CC_NE), target);
+            break;
+        }
+
+        case OP_JMP: {
+            // Loops end in a backward jump, which is a safepoint like in the interpreter
+            if(target < offset){
+                _jit_safepoint(jit);
+            }
+
+            _jit_jump_to(jit, _jit_jmp(jit), target);
+
+            // The interpreter may enter at the loop header
+            if(target < offset){
+                JitLoop loop = { target, NULL };
+                array_push(jit->loops, loop);
+            }
+            break;
+        }
+
+        case OP_POP: {
+            _jit_add_imm(jit, RBX, -8);
+            break;
+        }
+
+        case OP_GET_GLOBAL: {
+            _jit_load(jit, RAX, R14, JIT_GLOBAL(operand));
+            _jit_push_value(jit, RAX);
+            break;
+        }
+
+        case OP_SET_GLOBAL: {
+            _jit_load(jit, RAX, RBX, -8);
+            _jit_store(jit, R14, JIT_GLOBAL(operand), RAX);
+            _jit_global_barrier(jit, operand);
+            break;
+        }
+
+        case OP_GET_LOCAL: {
+            _jit_load(jit, RAX, R12, JIT_SLOT(operand));
+            _jit_push_value(jit, RAX);
+            break;
+        }
+
+        case OP_SET_LOCAL: {
+            _jit_load(jit, RAX, RBX, -8);
+            _jit_store(jit, R12, JIT_SLOT(operand), RAX);
+            break;
+        }
+
+        case OP_SCOPE_EXIT: {
+            _jit_add_imm(jit, RBX, -JIT_SLOT(operand));
+            break;
+        }
+
+        case OP_CALL: {
+            _jit_mov(jit, RDI, R15);
+            _jit_mov(jit, RSI, RBX);
+            _jit_mov_imm(jit, RDX, operand);
+            _jit_call(jit, jit_call);
+            _jit_mov(jit, RBX, RAX);
+            break;
+        }
+
+        case OP_RETURN: {
+            // The result replaces everything the frame pushed, same as the interpreter
+            if(operand > 0){
+                _jit_load(jit, RAX, RBX, -8);
+                _jit_store(jit, RBX, -JIT_SLOT(operand), RAX);
+                _jit_add_imm(jit, RBX, -JIT_SLOT(operand - 1));
+            }
+
+            _jit_epilogue(jit);
+            break;
+        }
+
+        case OP_GET_MEMBER: {
+            _jit_load(jit, RDI, RBX, -8);
+            _jit_mov_imm(jit, RSI, operand);
+            _jit_call(jit, _jit_get_member);
+            _jit_store(jit, RBX, -8, RAX);
+            break;
+        }
+
+        case OP_INC_LOCAL:
+        case OP_ADD_LOCAL_CONST: {
+            RuntimeValue constant = fn->constants[second];
+
+            _jit_load(jit, RAX, R12, JIT_SLOT(operand));
+            _jit_mov_imm(jit, RCX, constant);
+            _jit_add_values(jit, IS_NUMBER(constant));
+
+            if(opcode == OP_INC_LOCAL){
+                _jit_store(jit, R12, JIT_SLOT(operand), RAX);
+            }
+            else{
+                _jit_push_value(jit, RAX);
+            }
+            break;
+        }
+
+        case OP_INC_GLOBAL: {
+            RuntimeValue constant = fn->constants[second];
+
+            _jit_load(jit, RAX, R14, JIT_GLOBAL(operand));
+            _jit_mov_imm(jit, RCX, constant);
+            _jit_add_values(jit, IS_NUMBER(constant));
+            _jit_store(jit, R14, JIT_GLOBAL(operand), RAX);
+            _jit_global_barrier(jit, operand);
+            break;
+        }
+
+        case OP_LOAD_LOCAL2: {
+            _jit_load(jit, RAX, R12, JIT_SLOT(operand));
+            _jit_load(jit, RCX, R12, JIT_SLOT(second));
+            _jit_store(jit, RBX, 0, RAX);
+            _jit_store(jit, RBX, 8, RCX);
+            _jit_add_imm(jit, RBX, 16);
+            break;
+        }
+
+        case OP_CONST_SET_LOCAL: {
+            _jit_mov_imm(jit, RAX, fn->constants[operand]);
+            _jit_push_value(jit, RAX);
+            _jit_store(jit, R12, JIT_SLOT(second), RAX);
+            break;
+        }
+
+        case OP_STORE_LOCAL: {
+            _jit_add_imm(jit, RBX, -8);
+            _jit_load(jit, RAX, RBX, 0);
+            _jit_store(jit, R12, JIT_SLOT(operand), RAX);
+            break;
+        }
+
+        case OP_STORE_GLOBAL: {
+            _jit_add_imm(jit, RBX, -8);
+            _jit_load(jit, RAX, RBX, 0);
+            _jit_store(jit, R14, JIT_GLOBAL(operand), RAX);
+            _jit_global_barrier(jit, operand);
+            break;
+        }
+
+        case OP_HALT: {
+            // Only main halts, and main is only ever entered through a loop. The interpreter pops the result.
+            _jit_epilogue(jit);
+            break;
+        }
+
+        default: {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#pragma endregion
+
+#pragma region JIT
+
+static FILE* _jit_perf_map = NULL;
+
+// perf looks up symbols for anonymous executable memory in /tmp/perf-<pid>.map
+static void _jit_perf_map_add(void* start, size_t size, char* name){
+    if(_jit_perf_map == NULL){
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+        _jit_perf_map = fopen(path, "w");
+
+        if(_jit_perf_map == NULL){
+            return;
+        }
+    }
+
+    fprintf(_jit_perf_map, "%llx %llx jit:%s\n", (uint64)(uintptr_t)start, (uint64)size, name);
+    fflush(_jit_perf_map);
+}
+
+static void* _jit_install(uint8_t* code, size_t size){
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapped = (size + page - 1) & ~(page - 1);
+
+    void* memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(memory == MAP_FAILED){
+        return NULL;
+    }
+
+    memcpy(memory, code, size);
+
+    // Never writable and executable at the same time
+    if(mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0){
+        munmap(memory, mapped);
+        return NULL;
+    }
+
+    return memory;
+}
+
+bool jit_compile(VM* vm, FunctionObject* fn){
+    size_t length = array_length(fn->code);
+
+    Jit jit;
+    jit.code = NULL;
+    jit.fixups = NULL;
+    jit.native_offsets = malloc((length + 1) * sizeof(size_t));
+    jit.loops = NULL;
+    jit.global = vm->global;
+
+    fn->jit_state = Jit_Failed;
+
+    _jit_prologue(&jit, vm->global);
+
+    bool supported = true;
+
+    for (size_t offset = 0; offset < length && supported; offset += Instruction_Length(&fn->code[offset])) {
+        jit.native_offsets[offset] = array_length(jit.code);
+        supported = _jit_instruction(&jit, fn, offset);
+    }
+
+    jit.native_offsets[length] = array_length(jit.code);
+
+    // OSR entry, the same frame setup as a call but continuing at the address passed in rcx
+    size_t osr = array_length(jit.code);
+    _jit_prologue(&jit, vm->global);
+    _jit_op(&jit, 0, false, 0xFF, 4, RCX, false, 0);
+
+    if(supported){
+        for (size_t i = 0; i < array_length(jit.fixups); i++) {
+            int32_t relative = (int32_t)(jit.native_offsets[jit.fixups[i].target] - (jit.fixups[i].position + 4));
+            memcpy(&jit.code[jit.fixups[i].position], &relative, 4);
+        }
+
+        fn->jit_code = (JitFunction)_jit_install(jit.code, array_length(jit.code));
+
+        if(fn->jit_code != NULL){
+            for (size_t i = 0; i < array_length(jit.loops); i++) {
+                jit.loops[i].entry = (uint8_t*)fn->jit_code + jit.native_offsets[jit.loops[i].offset];
+            }
+
+            fn->jit_osr = (JitOsrFunction)((uint8_t*)fn->jit_code + osr);
+            fn->jit_loops = jit.loops;
+            jit.loops = NULL;
+            fn->jit_state = Jit_Compiled;
+            _jit_perf_map_add(fn->jit_code, array_length(jit.code), fn->name);
+        }
+    }
+
+    arrfree(jit.code);
+    arrfree(jit.fixups);
+    arrfree(jit.loops);
+    free(jit.native_offsets);
+
+    return fn->jit_state == Jit_Compiled;
+}
+
+void* jit_loop_entry(FunctionObject* fn, size_t offset){
+    for (size_t i = 0; i < array_length(fn->jit_loops); i++) {
+        if(fn->jit_loops[i].offset == offset){
+            return fn->jit_loops[i].entry;
+        }
+    }
+
+    return NULL;
+}
+
+#pragma endregion
+
+#else
+
+// No native tier on other platforms, every function stays interpreted
+bool jit_compile(VM* vm, FunctionObject* fn){
+    fn->jit_state = Jit_Failed;
+    return false;
+}
+
+void* jit_loop_entry(FunctionObject* fn, size_t offset){
+    return NULL;
+}
+
+#endif
+
+// OP_CALL from JIT code. Pops the callee and its arguments off sp, pushes the result and returns sp.
+// Natives and compiled functions are called directly, anything else runs on a nested interpreter.
+RuntimeValue* jit_call(VM* vm, RuntimeValue* sp, uint64 arg_count){
+    static uint8_t halt[] = { OP_HALT };
+
+    if(_gc_pending){
+        gc_safepoint(vm, sp);
+    }
+
+    RuntimeValue callee = *(--sp);
+
+    if(IS_OBJ(callee) && AS_C_OBJ(callee)->objectType == ObjectType_NativeFunction){
+        NativeFunctionObject native = AS_NATIVE_FUNCTION(callee);
+        RuntimeValue args[arg_count];
+
+        for (size_t i = 0; i < arg_count; i++) {
+            args[i] = *(--sp);
+        }
+
+        RuntimeValue (*fun_ptr)() = native.func_ptr;
+        *sp++ = (*fun_ptr)(arg_count, &args);
+
+        return sp;
+    }
+
+    FunctionObject* fn = (FunctionObject*)AS_C_OBJ(callee);
+
+    // Calls between compiled functions nest on the C stack, they still count against the VM call stack
+    if(vm->csp == &vm->callstack[STACK_LIMIT - 1] || sp > &vm->stack[STACK_LIMIT - 64]){
+        VM_Exception("Stack overflow.");
+    }
+
+    if(fn->jit_state == Jit_Cold && ++fn->hotness >= JIT_HOT_THRESHOLD){
+        jit_compile(vm, fn);
+    }
+
+    *vm->csp = (Frame){ .ra = halt, .bp = vm->bp, .fn = vm->fn };
+    vm->csp++;
+
+    if(fn->jit_code != NULL){
+        sp = fn->jit_code(vm, sp - arg_count, sp);
+        vm->csp--;
+
+        return sp;
+    }
+
+    // Returning from fn lands on the halt, which hands the result back here
+    vm->fn = fn;
+    vm->bp = sp - arg_count;
+    vm->ip = &fn->code[0];
+    vm->sp = sp;
+
+    RuntimeValue result = vm_interp(vm, vm->global);
+
+    sp = vm->sp;
+    *sp++ = result;
+
+    return sp;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+typedef struct Instruction Instruction;
+
+// Bytecode peephole pass, run on every function once it is generated. Common sequences are replaced by
+// the superinstructions defined in runtime.c, which saves a dispatch per instruction fused away.
+// The code shrinks, so jumps are re-targeted afterwards. A sequence is never fused across a jump target.
+
+bool _peephole_enabled = true;
+
+struct Instruction {
+    size_t offset;
+    uint8_t opcode; // Opcode after a WIDE prefix
+    bool wide;
+    bool target; // Some jump lands here
+};
+
+static Instruction* _peephole_decode(FunctionObject* co) {
+    Instruction* instructions = NULL;
+    size_t length = array_length(co->code);
+    bool* targets = calloc(length + 1, sizeof(bool));
+
+    for (size_t offset = 0; offset < length; offset += Instruction_Length(&co->code[offset])) {
+        Instruction instruction;
+        instruction.offset = offset;
+        instruction.wide = co->code[offset] == OP_WIDE;
+        instruction.opcode = co->code[offset + instruction.wide];
+        instruction.target = false;
+
+        if(Opcode_IsJump(instruction.opcode)) {
+            targets[Jump_Target(co->code, offset)] = true;
+        }
+
+        array_push(instructions, instruction);
+    }
+
+    for (size_t i = 0; i < array_length(instructions); i++) {
+        instructions[i].target = targets[instructions[i].offset];
+    }
+
+    free(targets);
+
+    return instructions;
+}
+
+// True if the count instructions from first have these opcodes, none is wide and only the first is a jump target
+static bool _peephole_match(Instruction* instructions, size_t first, uint8_t* opcodes, size_t count) {
+    if(first + count > array_length(instructions)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Instruction instruction = instructions[first + i];
+
+        if(instruction.opcode != opcodes[i] || instruction.wide || (i > 0 && instruction.target)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Operand byte of the i:th instruction of a match
+#define PEEPHOLE_OPERAND(i) (co->code[instructions[first + (i)].offset + 1])
+
+// Tries every pattern at first, longest first. Writes the replacement to code and returns the number of
+// instructions it replaces, or 0 if nothing matched.
+static size_t _peephole_fuse(FunctionObject* co, Instruction* instructions, size_t first, uint8_t** code) {
+    static uint8_t inc_local[] = { OP_GET_LOCAL, OP_CONST, OP_ADD, OP_SET_LOCAL, OP_POP };
+    static uint8_t inc_global[] = { OP_GET_GLOBAL, OP_CONST, OP_ADD, OP_SET_GLOBAL, OP_POP };
+    static uint8_t add_local_const[] = { OP_GET_LOCAL, OP_CONST, OP_ADD };
+    static uint8_t load_local2[] = { OP_GET_LOCAL, OP_GET_LOCAL };
+    static uint8_t const_set_local[] = { OP_CONST, OP_SET_LOCAL };
+    static uint8_t store_local[] = { OP_SET_LOCAL, OP_POP };
+    static uint8_t store_global[] = { OP_SET_GLOBAL, OP_POP };
+
+    // i = i + c, only when the same variable is read and written
+    if(_peephole_match(instructions, first, inc_local, 5) && PEEPHOLE_OPERAND(0) == PEEPHOLE_OPERAND(3)) {
+        array_push(*code, OP_INC_LOCAL);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        array_push(*code, PEEPHOLE_OPERAND(1));
+        return 5;
+    }
+
+    if(_peephole_match(instructions, first, inc_global, 5) && PEEPHOLE_OPERAND(0) == PEEPHOLE_OPERAND(3)) {
+        array_push(*code, OP_INC_GLOBAL);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        array_push(*code, PEEPHOLE_OPERAND(1));
+        return 5;
+    }
+
+    if(_peephole_match(instructions, first, add_local_const, 3)) {
+        array_push(*code, OP_ADD_LOCAL_CONST);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        array_push(*code, PEEPHOLE_OPERAND(1));
+        return 3;
+    }
+
+    if(_peephole_match(instructions, first, load_local2, 2)) {
+        array_push(*code, OP_LOAD_LOCAL2);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        array_push(*code, PEEPHOLE_OPERAND(1));
+        return 2;
+    }
+
+    if(_peephole_match(instructions, first, const_set_local, 2)) {
+        array_push(*code, OP_CONST_SET_LOCAL);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        array_push(*code, PEEPHOLE_OPERAND(1));
+        return 2;
+    }
+
+    if(_peephole_match(instructions, first, store_local, 2)) {
+        array_push(*code, OP_STORE_LOCAL);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        return 2;
+    }
+
+    if(_peephole_match(instructions, first, store_global, 2)) {
+        array_push(*code, OP_STORE_GLOBAL);
+        array_push(*code, PEEPHOLE_OPERAND(0));
+        return 2;
+    }
+
+    return 0;
+}
+
+#undef PEEPHOLE_OPERAND
+
+void Peephole_Optimize(FunctionObject* co) {
+    if(!_peephole_enabled || array_length(co->code) == 0) {
+        return;
+    }
+
+    size_t length = array_length(co->code);
+    Instruction* instructions = _peephole_decode(co);
+
+    uint8_t* code = NULL;
+    JumpFixup* fixups = NULL;
+    size_t* new_offsets = malloc((length + 1) * sizeof(size_t)); // Old instruction offset -> new offset
+
+    arrsetcap(code, length);
+
+    size_t i = 0;
+    while(i < array_length(instructions)) {
+        Instruction instruction = instructions[i];
+        new_offsets[instruction.offset] = array_length(code);
+
+        size_t fused = _peephole_fuse(co, instructions, i, &code);
+
+        if(fused > 0) {
+            i += fused;
+            continue;
+        }
+
+        size_t instruction_length = Instruction_Length(&co->code[instruction.offset]);
+
+        // Offset in the new code, target in the old one
+        if(Opcode_IsJump(instruction.opcode)) {
+            JumpFixup fixup;
+            fixup.offset = array_length(code);
+            fixup.target = Jump_Target(co->code, instruction.offset);
+            array_push(fixups, fixup);
+        }
+
+        memcpy(arraddnptr(code, instruction_length), &co->code[instruction.offset], instruction_length);
+        i++;
+    }
+
+    new_offsets[length] = array_length(code);
+
+    // Only shorter, so every jump still fits in the form it has
+    for (size_t j = 0; j < array_length(fixups); j++) {
+        Write_Jump(code, fixups[j].offset, new_offsets[fixups[j].target]);
+    }
+
+    arrfree(co->code);
+    co->code = code;
+
+    arrfree(instructions);
+    arrfree(fixups);
+    free(new_offsets);
+}
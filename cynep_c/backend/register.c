@@ -0,0 +1,1028 @@
+#pragma once
+
+typedef struct RegisterCompiler RegisterCompiler;
+typedef struct RegisterLocal RegisterLocal;
+typedef struct RegisterFrame RegisterFrame;
+typedef struct RegisterVM RegisterVM;
+
+// Second execution engine. Instructions address the slots of the frame directly, so i = i + 1 is a
+// single ADDK instead of a load, a constant, an add, a store and a pop. Runs from the same AST and the
+// Program the stack compiler has already filled in with globals, types, consts and purity.
+
+bool            register_compile(Ast* ast, Program* global);
+RuntimeValue    register_exec(RegisterVM* vm, Program* global, bool count);
+void            Register_Disassemble(Program* global);
+
+#pragma region REGISTER_BYTECODE
+
+// Instructions are 32 bit words: opcode, A, B, C. A is the destination, B and C the sources.
+// Bx is the 16 bit field made of B and C. Jumps are followed by a word holding a signed offset in words,
+// relative to the end of the jump. K forms take C as an index into the constant pool.
+#define ROP_MOVE        0  // A = B
+#define ROP_LOADK       1  // A = K[Bx]
+#define ROP_GETGLOBAL   2  // A = G[Bx]
+#define ROP_SETGLOBAL   3  // G[Bx] = A
+#define ROP_ADD         4  // A = B + C
+#define ROP_SUB         5
+#define ROP_MUL         6
+#define ROP_DIV         7
+#define ROP_ADDK        8  // A = B + K[C]
+#define ROP_SUBK        9
+#define ROP_MULK        10
+#define ROP_DIVK        11
+#define ROP_LT          12 // A = B < C, same order as OP_LT..OP_NE
+#define ROP_GT          13
+#define ROP_LE          14
+#define ROP_GE          15
+#define ROP_EQ          16
+#define ROP_NE          17
+#define ROP_LTK         18 // A = B < K[C]
+#define ROP_GTK         19
+#define ROP_LEK         20
+#define ROP_GEK         21
+#define ROP_EQK         22
+#define ROP_NEK         23
+#define ROP_JMP         24 // jump
+#define ROP_JMPF        25 // jump if A is false
+#define ROP_JNLT        26 // jump unless B < C
+#define ROP_JNGT        27
+#define ROP_JNLE        28
+#define ROP_JNGE        29
+#define ROP_JNEQ        30
+#define ROP_JNNE        31
+#define ROP_JNLTK       32 // jump unless B < K[C]
+#define ROP_JNGTK       33
+#define ROP_JNLEK       34
+#define ROP_JNGEK       35
+#define ROP_JNEQK       36
+#define ROP_JNNEK       37
+#define ROP_CALL        38 // A = A(A+1 .. A+B), the callee frame starts at A+1
+#define ROP_RETURN      39 // return A
+#define ROP_GETMEMBER   40 // A = B.members[C]
+
+#define ROP_COUNT       41
+
+#define REGISTER_LIMIT 256 // Slots per frame, operands are one byte
+
+#define RI_OP(word) ((word) & 0xFF)
+#define RI_A(word)  (((word) >> 8) & 0xFF)
+#define RI_B(word)  (((word) >> 16) & 0xFF)
+#define RI_C(word)  ((word) >> 24)
+#define RI_BX(word) ((word) >> 16)
+
+#define RI_ABC(op, a, b, c) ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 24))
+#define RI_ABX(op, a, bx)   ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(bx) << 16))
+
+static inline bool Register_IsJump(uint8_t opcode){
+    return opcode >= ROP_JMP && opcode <= ROP_JNNEK;
+}
+
+#pragma endregion
+
+#pragma region REGISTER_COMPILER
+
+// Slots are handed out in one linear pass over the tree. Locals get the next free slot when they are
+// declared and give it back when their block ends, temporaries live above the locals for as long as the
+// expression that needs them. Each slot is held for exactly one interval and freed slots are reused by
+// the next interval, so the frame is as large as the most slots live at any point.
+
+#define REGISTER_ANY -1 // No destination asked for, the value may stay where it already is
+
+struct RegisterLocal {
+    Symbol name;
+    uint8_t slot;
+    int64 shadowed; // Index of the local this one shadows, or -1
+};
+
+struct RegisterCompiler {
+    Ast* ast;
+    Program* program;
+    FunctionObject* fn;
+    RegisterLocal* locals; // In declaration order, innermost last
+    Table local_table; // Symbol -> index of the innermost local with that name
+    size_t top; // First free slot
+    bool too_large; // Some operand does not fit its one byte field, the function stays on the stack engine
+};
+
+static uint8_t _reg_expression(RegisterCompiler* rc, NodeIndex node, int dest);
+static void _reg_statement(RegisterCompiler* rc, NodeIndex node);
+
+static void _reg_emit(RegisterCompiler* rc, uint32_t word){
+    array_push(rc->fn->register_code, word);
+}
+
+static uint8_t _reg_alloc(RegisterCompiler* rc){
+    // Compiling goes on with slot 0 so the tree is still walked, the code is thrown away afterwards
+    if(rc->top >= REGISTER_LIMIT){
+        rc->too_large = true;
+        return 0;
+    }
+
+    uint8_t slot = rc->top++;
+
+    if(rc->top > rc->fn->register_count){
+        rc->fn->register_count = rc->top;
+    }
+
+    return slot;
+}
+
+static uint8_t _reg_target(RegisterCompiler* rc, int dest){
+    return dest == REGISTER_ANY ? _reg_alloc(rc) : dest;
+}
+
+static int64 _reg_local(RegisterCompiler* rc, Symbol name){
+    int64 index = table_get_int(&rc->local_table, name);
+    return index == -1 ? -1 : rc->locals[index].slot;
+}
+
+static void _reg_define_local(RegisterCompiler* rc, Symbol name, uint8_t slot){
+    RegisterLocal local;
+    local.name = name;
+    local.slot = slot;
+    local.shadowed = table_get_int(&rc->local_table, name);
+
+    array_push(rc->locals, local);
+    table_set_int(&rc->local_table, name, array_length(rc->locals) - 1);
+}
+
+static void _reg_pop_locals(RegisterCompiler* rc, size_t count){
+    while(array_length(rc->locals) > count){
+        RegisterLocal local = array_pop(rc->locals);
+        table_set_int(&rc->local_table, local.name, local.shadowed);
+    }
+}
+
+static int64 _reg_constant(RegisterCompiler* rc, RuntimeValue value){
+    int64 index = Value_Const_Index(rc->fn, value);
+
+    if(index > UINT16_MAX){
+        printf("\033[0;31mCompiler: Too many constants in %s \033[0m\n", rc->fn->name);
+        exit(1);
+    }
+
+    return index;
+}
+
+// Constant index of a literal or const, or -1 if node is something else
+static int64 _reg_constant_operand(RegisterCompiler* rc, NodeIndex node){
+    Ast* ast = rc->ast;
+
+    switch (Ast_Type(ast, node))
+    {
+        case AST_NumericLiteral: {
+            return _reg_constant(rc, NUMBER_VAL(NumericLiteral_Value(AST_GET(ast, node, NumericLiteral))));
+        }
+        case AST_StringLiteral: {
+            return String_Const_Index(rc->fn, AST_GET(ast, node, StringLiteral)->value);
+        }
+        case AST_Identifier: {
+            Symbol name = AST_GET(ast, node, Identifier)->name;
+
+            if(_reg_local(rc, name) == -1 && Const_GetIndex(rc->program, name) != -1){
+                return _reg_constant(rc, rc->program->const_values[Const_GetIndex(rc->program, name)]);
+            }
+
+            return -1;
+        }
+        default: {
+            return -1;
+        }
+    }
+}
+
+// Locals of the register compiler are not known to the stack compiler, they must not reach Evaluate_Constant
+static bool _reg_reads_no_locals(RegisterCompiler* rc, NodeIndex node){
+    Ast* ast = rc->ast;
+
+    switch (Ast_Type(ast, node))
+    {
+        case AST_NumericLiteral:
+        case AST_StringLiteral: {
+            return true;
+        }
+        case AST_Identifier: {
+            return _reg_local(rc, AST_GET(ast, node, Identifier)->name) == -1;
+        }
+        case AST_BinaryExpression:
+        case AST_ComparisonExpression: {
+            BinaryExpression binary = *AST_GET(ast, node, BinaryExpression);
+            return _reg_reads_no_locals(rc, binary.left) && _reg_reads_no_locals(rc, binary.right);
+        }
+        case AST_CallExpression: {
+            CallExpression call = *AST_GET(ast, node, CallExpression);
+
+            for (size_t i = 0; i < call.args.count; i++) {
+                if(!_reg_reads_no_locals(rc, Ast_Child(ast, call.args, i))){
+                    return false;
+                }
+            }
+
+            return _reg_reads_no_locals(rc, call.callee);
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+// Same compile time evaluation as the stack compiler, the value is loaded with a single LOADK
+static bool _reg_evaluated(RegisterCompiler* rc, NodeIndex node, int dest, uint8_t* result){
+    RuntimeValue value;
+
+    if(!_reg_reads_no_locals(rc, node) || !Evaluate_Constant(NULL, rc->ast, node, rc->program, &value)){
+        return false;
+    }
+
+    int64 index = Value_Const_Index(rc->fn, value);
+
+    if(index == -1 || index > UINT16_MAX){
+        return false;
+    }
+
+    *result = _reg_target(rc, dest);
+    _reg_emit(rc, RI_ABX(ROP_LOADK, *result, index));
+
+    return true;
+}
+
+static uint8_t _reg_move(RegisterCompiler* rc, uint8_t source, int dest){
+    if(dest == REGISTER_ANY || dest == source){
+        return source;
+    }
+
+    _reg_emit(rc, RI_ABC(ROP_MOVE, dest, source, 0));
+    return dest;
+}
+
+// Both operands of a binary instruction. Returns true when the right one is a constant index in right.
+static bool _reg_operands(RegisterCompiler* rc, BinaryExpression expression, uint8_t* left, uint8_t* right){
+    *left = _reg_expression(rc, expression.left, REGISTER_ANY);
+
+    int64 constant = _reg_constant_operand(rc, expression.right);
+
+    if(constant != -1 && constant <= UINT8_MAX){
+        *right = constant;
+        return true;
+    }
+
+    *right = _reg_expression(rc, expression.right, REGISTER_ANY);
+    return false;
+}
+
+static uint8_t _reg_arithmetic(RegisterCompiler* rc, NodeIndex node, int dest){
+    BinaryExpression expression = *AST_GET(rc->ast, node, BinaryExpression);
+    uint8_t result;
+
+    if(array_length(rc->program->const_values) > 0 && _reg_evaluated(rc, node, dest, &result)){
+        return result;
+    }
+
+    uint8_t opcode;
+
+    switch (expression.operator)
+    {
+        case Operator_Add:      opcode = ROP_ADD; break;
+        case Operator_Subtract: opcode = ROP_SUB; break;
+        case Operator_Multiply: opcode = ROP_MUL; break;
+        case Operator_Divide:   opcode = ROP_DIV; break;
+        default: {
+            printf("\033[0;31mCompiler: Operator %s is not supported \033[0m\n", _operator_names[expression.operator]);
+            exit(1);
+        }
+    }
+
+    size_t top = rc->top;
+    uint8_t left, right;
+
+    if(_reg_operands(rc, expression, &left, &right)){
+        opcode += ROP_ADDK - ROP_ADD;
+    }
+
+    // Operands are read before the result is written, so the result may reuse their temporaries
+    rc->top = top;
+    result = _reg_target(rc, dest);
+
+    _reg_emit(rc, RI_ABC(opcode, result, left, right));
+
+    return result;
+}
+
+static uint8_t _reg_comparison(RegisterCompiler* rc, NodeIndex node, int dest){
+    BinaryExpression expression = *AST_GET(rc->ast, node, BinaryExpression);
+    uint8_t opcode = ROP_LT + (Compare_Opcode(expression.operator) - OP_LT);
+
+    size_t top = rc->top;
+    uint8_t left, right;
+
+    if(_reg_operands(rc, expression, &left, &right)){
+        opcode += ROP_LTK - ROP_LT;
+    }
+
+    rc->top = top;
+    uint8_t result = _reg_target(rc, dest);
+
+    _reg_emit(rc, RI_ABC(opcode, result, left, right));
+
+    return result;
+}
+
+static uint8_t _reg_call(RegisterCompiler* rc, NodeIndex node, int dest){
+    CallExpression call = *AST_GET(rc->ast, node, CallExpression);
+    uint8_t result;
+
+    if(_reg_evaluated(rc, node, dest, &result)){
+        return result;
+    }
+
+    // Callee and arguments go in consecutive slots on top of everything live
+    size_t top = rc->top;
+    uint8_t base = _reg_alloc(rc);
+
+    _reg_expression(rc, call.callee, base);
+
+    for (size_t i = 0; i < call.args.count; i++) {
+        uint8_t slot = _reg_alloc(rc);
+        _reg_expression(rc, Ast_Child(rc->ast, call.args, i), slot);
+    }
+
+    if(call.args.count > UINT8_MAX){
+        printf("\033[0;31mCompiler: Too many arguments \033[0m\n");
+        exit(1);
+    }
+
+    _reg_emit(rc, RI_ABC(ROP_CALL, base, call.args.count, 0));
+
+    rc->top = top + 1;
+
+    if(dest == REGISTER_ANY){
+        return base;
+    }
+
+    rc->top = top;
+    return _reg_move(rc, base, dest);
+}
+
+static uint8_t _reg_expression(RegisterCompiler* rc, NodeIndex node, int dest){
+    Ast* ast = rc->ast;
+    Program* program = rc->program;
+
+    switch (Ast_Type(ast, node))
+    {
+        case AST_NumericLiteral:
+        case AST_StringLiteral: {
+            int64 index = _reg_constant_operand(rc, node);
+            uint8_t result = _reg_target(rc, dest);
+
+            _reg_emit(rc, RI_ABX(ROP_LOADK, result, index));
+            return result;
+        }
+
+        case AST_Identifier: {
+            Symbol name = AST_GET(ast, node, Identifier)->name;
+            int64 slot = _reg_local(rc, name);
+
+            if(slot != -1){
+                return _reg_move(rc, slot, dest);
+            }
+
+            if(Const_GetIndex(program, name) != -1){
+                uint8_t result = _reg_target(rc, dest);
+                _reg_emit(rc, RI_ABX(ROP_LOADK, result, _reg_constant_operand(rc, node)));
+                return result;
+            }
+
+            int64 global_index = Global_GetIndex(program, name);
+
+            if(global_index == -1 || global_index > UINT16_MAX){
+                printf("\033[0;31mCompiler: Reference error \033[0m\n");
+                exit(1);
+            }
+
+            uint8_t result = _reg_target(rc, dest);
+            _reg_emit(rc, RI_ABX(ROP_GETGLOBAL, result, global_index));
+            return result;
+        }
+
+        case AST_BinaryExpression: {
+            return _reg_arithmetic(rc, node, dest);
+        }
+
+        case AST_ComparisonExpression: {
+            return _reg_comparison(rc, node, dest);
+        }
+
+        case AST_CallExpression: {
+            return _reg_call(rc, node, dest);
+        }
+
+        case AST_AssignmentExpression: {
+            AssignmentExpression assignment = *AST_GET(ast, node, AssignmentExpression);
+            Symbol name = AST_GET(ast, assignment.assignee, Identifier)->name;
+            int64 slot = _reg_local(rc, name);
+
+            // Locals are computed straight into their slot
+            if(slot != -1){
+                _reg_expression(rc, assignment.value, slot);
+                return _reg_move(rc, slot, dest);
+            }
+
+            if(Const_GetIndex(program, name) != -1){
+                printf("\033[0;31mCompiler: Cannot assign to const %s \033[0m\n", symbol_name(name));
+                exit(1);
+            }
+
+            int64 global_index = Global_GetIndex(program, name);
+
+            if(global_index == -1 || global_index > UINT16_MAX){
+                printf("\033[0;31mCompiler: Reference error \033[0m\n");
+                exit(1);
+            }
+
+            uint8_t value = _reg_expression(rc, assignment.value, dest);
+            _reg_emit(rc, RI_ABX(ROP_SETGLOBAL, value, global_index));
+            return value;
+        }
+
+        case AST_MemberExpression: {
+            MemberExpression expression = *AST_GET(ast, node, MemberExpression);
+
+            size_t top = rc->top;
+            uint8_t object = _reg_expression(rc, expression.object, REGISTER_ANY);
+
+            // Same as the stack compiler, members are looked up on the player type
+            Identifier member = *AST_GET(ast, expression.member, Identifier);
+            TypeInfoObject type_info = AS_TYPEINFO(Global_Get(program, Global_GetIndex(program, symbol_intern_string("player"))).value);
+            int64 member_index = Member_GetIndex(&type_info, member.name);
+
+            if(member_index == -1){
+                printf("\033[0;31mCompiler: Unknown member %s \033[0m\n", symbol_name(member.name));
+                exit(1);
+            }
+
+            if(member_index > UINT8_MAX){
+                rc->too_large = true;
+            }
+
+            rc->top = top;
+            uint8_t result = _reg_target(rc, dest);
+
+            _reg_emit(rc, RI_ABC(ROP_GETMEMBER, result, object, member_index));
+            return result;
+        }
+
+        default: {
+            printf("\033[0;31mCompiler error: Unknown AST node \033[0m\n");
+            exit(1);
+        }
+    }
+}
+
+// Emits a jump and its placeholder offset word, returns the offset of that word
+static size_t _reg_jump(RegisterCompiler* rc, uint32_t word){
+    _reg_emit(rc, word);
+    _reg_emit(rc, 0);
+
+    return array_length(rc->fn->register_code) - 1;
+}
+
+static void _reg_patch(RegisterCompiler* rc, size_t offset, size_t target){
+    rc->fn->register_code[offset] = (uint32_t)(int32_t)((int64)target - (int64)(offset + 1));
+}
+
+// Emits the test of an if or while and the jump taken when it is false
+static size_t _reg_test(RegisterCompiler* rc, NodeIndex test){
+    size_t top = rc->top;
+    size_t jump;
+
+    if(Ast_Type(rc->ast, test) == AST_ComparisonExpression){
+        BinaryExpression expression = *AST_GET(rc->ast, test, BinaryExpression);
+        uint8_t opcode = ROP_JNLT + (Compare_Opcode(expression.operator) - OP_LT);
+        uint8_t left, right;
+
+        if(_reg_operands(rc, expression, &left, &right)){
+            opcode += ROP_JNLTK - ROP_JNLT;
+        }
+
+        jump = _reg_jump(rc, RI_ABC(opcode, 0, left, right));
+    }
+    else{
+        uint8_t value = _reg_expression(rc, test, REGISTER_ANY);
+        jump = _reg_jump(rc, RI_ABC(ROP_JMPF, value, 0, 0));
+    }
+
+    rc->top = top;
+    return jump;
+}
+
+static void _reg_statement(RegisterCompiler* rc, NodeIndex node){
+    Ast* ast = rc->ast;
+
+    switch (Ast_Type(ast, node))
+    {
+        case AST_BlockStatement: {
+            BlockStatement block = *AST_GET(ast, node, BlockStatement);
+            size_t locals = array_length(rc->locals);
+            size_t top = rc->top;
+
+            for (size_t i = 0; i < block.body.count; i++) {
+                _reg_statement(rc, Ast_Child(ast, block.body, i));
+            }
+
+            // The slots of this block are free for whatever comes next
+            _reg_pop_locals(rc, locals);
+            rc->top = top;
+            break;
+        }
+
+        case AST_VariableDeclaration: {
+            VariableDeclaration declaration = *AST_GET(ast, node, VariableDeclaration);
+            uint8_t slot = _reg_alloc(rc);
+
+            if(declaration.value != NODE_NONE){
+                _reg_expression(rc, declaration.value, slot);
+            }
+            else{
+                _reg_emit(rc, RI_ABX(ROP_LOADK, slot, _reg_constant(rc, NULL_VAL)));
+            }
+
+            // Defined after the value, which may still read a local it shadows
+            _reg_define_local(rc, declaration.name, slot);
+            break;
+        }
+
+        case AST_ReturnStatement: {
+            ReturnStatement statement = *AST_GET(ast, node, ReturnStatement);
+            size_t top = rc->top;
+            uint8_t value;
+
+            if(statement.value != NODE_NONE){
+                value = _reg_expression(rc, statement.value, REGISTER_ANY);
+            }
+            else{
+                value = _reg_alloc(rc);
+                _reg_emit(rc, RI_ABX(ROP_LOADK, value, _reg_constant(rc, NULL_VAL)));
+            }
+
+            _reg_emit(rc, RI_ABC(ROP_RETURN, value, 0, 0));
+            rc->top = top;
+            break;
+        }
+
+        case AST_IfStatement: {
+            IfStatement statement = *AST_GET(ast, node, IfStatement);
+
+            size_t else_jump = _reg_test(rc, statement.test);
+            _reg_statement(rc, statement.consequent);
+
+            if(statement.alternate != NODE_NONE){
+                size_t end_jump = _reg_jump(rc, RI_ABC(ROP_JMP, 0, 0, 0));
+
+                _reg_patch(rc, else_jump, array_length(rc->fn->register_code));
+                _reg_statement(rc, statement.alternate);
+                _reg_patch(rc, end_jump, array_length(rc->fn->register_code));
+            }
+            else{
+                _reg_patch(rc, else_jump, array_length(rc->fn->register_code));
+            }
+            break;
+        }
+
+        case AST_WhileStatement: {
+            WhileStatement statement = *AST_GET(ast, node, WhileStatement);
+            size_t loop_start = array_length(rc->fn->register_code);
+
+            size_t end_jump = _reg_test(rc, statement.test);
+            _reg_statement(rc, statement.body);
+
+            size_t back_jump = _reg_jump(rc, RI_ABC(ROP_JMP, 0, 0, 0));
+            _reg_patch(rc, back_jump, loop_start);
+            _reg_patch(rc, end_jump, array_length(rc->fn->register_code));
+            break;
+        }
+
+        default: {
+            // Expression statement, the value is dropped with its temporaries
+            size_t top = rc->top;
+            _reg_expression(rc, node, REGISTER_ANY);
+            rc->top = top;
+            break;
+        }
+    }
+}
+
+// Returns false when the function does not fit the one byte operands of the register code
+static bool _reg_function(Ast* ast, Program* program, FunctionDeclaration declaration){
+    int64 global_index = Global_GetIndex(program, declaration.name);
+    RuntimeValue value = Global_Get(program, global_index).value;
+
+    if(!IS_OBJ(value) || AS_C_OBJ(value)->objectType != ObjectType_Code){
+        return true;
+    }
+
+    RegisterCompiler rc;
+    rc.ast = ast;
+    rc.program = program;
+    rc.fn = &AS_FUNCTION(value);
+    rc.locals = NULL;
+    rc.top = 0;
+    rc.too_large = false;
+    table_init(&rc.local_table);
+
+    // Arguments are the first slots of the frame
+    for (size_t i = 0; i < declaration.args.count; i++) {
+        Identifier* identifier = AST_GET(ast, Ast_Child(ast, declaration.args, i), Identifier);
+        _reg_define_local(&rc, identifier->name, _reg_alloc(&rc));
+    }
+
+    _reg_statement(&rc, declaration.body);
+
+    // Implicit return
+    uint8_t result = _reg_alloc(&rc);
+    _reg_emit(&rc, RI_ABX(ROP_LOADK, result, _reg_constant(&rc, NULL_VAL)));
+    _reg_emit(&rc, RI_ABC(ROP_RETURN, result, 0, 0));
+
+    arrfree(rc.locals);
+    table_free(&rc.local_table);
+
+    if(rc.too_large){
+        printf("Register compiling: %s needs more than %d registers or members\n", rc.fn->name, REGISTER_LIMIT);
+    }
+
+    return !rc.too_large;
+}
+
+// Runs after compile, every top level function gets register code next to its stack code.
+// Register frames only call register code, so when one function does not fit all of it is dropped and
+// false tells the caller to run the script on the stack engine instead.
+bool register_compile(Ast* ast, Program* program){
+    int64 compile_begin = timestamp();
+
+    BlockStatement root = *AST_GET(ast, ast->root, BlockStatement);
+    bool fits = true;
+
+    for (size_t i = 0; i < root.body.count && fits; i++) {
+        NodeIndex node = Ast_Child(ast, root.body, i);
+
+        if(Ast_Type(ast, node) == AST_FunctionDeclaration){
+            fits = _reg_function(ast, program, *AST_GET(ast, node, FunctionDeclaration));
+        }
+    }
+
+    if(!fits){
+        for (size_t i = 0; i < array_length(program->functions); i++) {
+            arrfree(program->functions[i]->register_code);
+            program->functions[i]->register_code = NULL;
+            program->functions[i]->register_count = 0;
+        }
+
+        printf("Register compiling: Running on the stack engine\n");
+    }
+
+    int64 compile_end = timestamp();
+    printf("Register compiling: %d ms\n", compile_end/1000-compile_begin/1000);
+
+    return fits;
+}
+
+#pragma endregion
+
+#pragma region REGISTER_INTERPRETER
+
+#define REGISTER_STACK_SIZE (64 * 1024)
+#define REGISTER_FRAME_LIMIT 512
+
+struct RegisterFrame {
+    uint32_t* ra; // Just past the CALL, which also names the slot for the result
+    RuntimeValue* base;
+    FunctionObject* fn;
+};
+
+struct RegisterVM {
+    Program* global;
+    RuntimeValue* registers; // Frames of all active calls, each starts where the caller put the first argument
+    RegisterFrame frames[REGISTER_FRAME_LIMIT];
+    bool counting; // Count dispatches, off for timing
+    uint64 dispatches;
+};
+
+static RuntimeValue _register_interp(RegisterVM* vm, FunctionObject* main_function);
+
+RuntimeValue register_exec(RegisterVM* vm, Program* global, bool count){
+    vm->global = global;
+    vm->registers = malloc(REGISTER_STACK_SIZE * sizeof(RuntimeValue));
+    vm->counting = count;
+    vm->dispatches = 0;
+
+    gc_tenure(global);
+
+    int64 t1 = timestamp();
+
+    RuntimeValue result = _register_interp(vm, global->main_function);
+
+    int64 t2 = timestamp();
+    printf("Execution time: %d ms\n", t2/1000-t1/1000);
+
+    free(vm->registers);
+    vm->registers = NULL;
+
+    return result;
+}
+
+static RuntimeValue _register_interp(RegisterVM* vm, FunctionObject* main_function){
+    register uint32_t* ip = main_function->register_code;
+    register RuntimeValue* base = vm->registers;
+    RuntimeValue* k = main_function->constants;
+    GlobalVar* globals = vm->global->globals;
+    RegisterFrame* frame = vm->frames;
+
+    frame->fn = main_function;
+    frame->base = base;
+    frame->ra = NULL;
+
+    static void* dispatch_table[ROP_COUNT] = {
+    [ROP_MOVE] = &&DO_MOVE, [ROP_LOADK] = &&DO_LOADK, [ROP_GETGLOBAL] = &&DO_GETGLOBAL, [ROP_SETGLOBAL] = &&DO_SETGLOBAL,
+    [ROP_ADD] = &&DO_ADD, [ROP_SUB] = &&DO_SUB, [ROP_MUL] = &&DO_MUL, [ROP_DIV] = &&DO_DIV,
+    [ROP_ADDK] = &&DO_ADDK, [ROP_SUBK] = &&DO_SUBK, [ROP_MULK] = &&DO_MULK, [ROP_DIVK] = &&DO_DIVK,
+    [ROP_LT] = &&DO_LT, [ROP_GT] = &&DO_GT, [ROP_LE] = &&DO_LE, [ROP_GE] = &&DO_GE, [ROP_EQ] = &&DO_EQ, [ROP_NE] = &&DO_NE,
+    [ROP_LTK] = &&DO_LTK, [ROP_GTK] = &&DO_GTK, [ROP_LEK] = &&DO_LEK, [ROP_GEK] = &&DO_GEK, [ROP_EQK] = &&DO_EQK, [ROP_NEK] = &&DO_NEK,
+    [ROP_JMP] = &&DO_JMP, [ROP_JMPF] = &&DO_JMPF,
+    [ROP_JNLT] = &&DO_JNLT, [ROP_JNGT] = &&DO_JNGT, [ROP_JNLE] = &&DO_JNLE, [ROP_JNGE] = &&DO_JNGE, [ROP_JNEQ] = &&DO_JNEQ, [ROP_JNNE] = &&DO_JNNE,
+    [ROP_JNLTK] = &&DO_JNLTK, [ROP_JNGTK] = &&DO_JNGTK, [ROP_JNLEK] = &&DO_JNLEK, [ROP_JNGEK] = &&DO_JNGEK, [ROP_JNEQK] = &&DO_JNEQK, [ROP_JNNEK] = &&DO_JNNEK,
+    [ROP_CALL] = &&DO_CALL, [ROP_RETURN] = &&DO_RETURN, [ROP_GETMEMBER] = &&DO_GETMEMBER};
+
+    // Counting goes through DO_COUNT first, like the stack VM profiler
+    void* count_table[ROP_COUNT];
+    void** dispatch = dispatch_table;
+
+    if(vm->counting){
+        for (size_t i = 0; i < ROP_COUNT; i++) {
+            count_table[i] = &&DO_COUNT;
+        }
+
+        dispatch = count_table;
+    }
+
+    uint32_t word;
+
+    // Arguments of a native call. A variable length array in DO_CALL is never given back, dispatch jumps
+    // out of its scope, so the stack would grow with every call.
+    RuntimeValue native_args[UINT8_MAX];
+
+    #define R_DISPATCH() goto *dispatch[RI_OP(word = *ip++)]
+    #define RA (base[RI_A(word)])
+    #define RB (base[RI_B(word)])
+    #define RC (base[RI_C(word)])
+    #define KC (k[RI_C(word)])
+
+    // The registers of every active frame end with those of the running one
+    #define R_SAFEPOINT()                                            \
+    do {                                                             \
+        if(_gc_pending){                                             \
+            gc_collect(vm->global, vm->registers, base + frame->fn->register_count, NULL, NULL); \
+        }                                                            \
+    } while (false)                                                  \
+
+    #define R_ARITHMETIC(operation, second)                          \
+    do {                                                             \
+        RA = NUMBER_VAL(AS_C_DOUBLE(RB) operation AS_C_DOUBLE(second)); \
+    } while (false)                                                  \
+
+    #define R_ADD(second)                                            \
+    do {                                                             \
+        RuntimeValue op1 = RB;                                       \
+        RuntimeValue op2 = second;                                   \
+        RA = IS_NUMBER(op1) && IS_NUMBER(op2) ? NUMBER_VAL(AS_C_DOUBLE(op1) + AS_C_DOUBLE(op2)) : VM_Add(op1, op2); \
+    } while (false)                                                  \
+
+    // Numbers inline, the rest through the same slow path as the stack VM
+    #define R_COMPARE_VALUES(operation, opcode) (IS_NUMBER(op1) && IS_NUMBER(op2) ? AS_C_DOUBLE(op1) operation AS_C_DOUBLE(op2) : VM_Compare(opcode, op1, op2))
+
+    #define R_COMPARE(operation, opcode, second)                     \
+    do {                                                             \
+        RuntimeValue op1 = RB;                                       \
+        RuntimeValue op2 = second;                                   \
+        RA = BOOL_VAL(R_COMPARE_VALUES(operation, opcode));          \
+    } while (false)                                                  \
+
+    #define R_COMPARE_JUMP(operation, opcode, second)                \
+    do {                                                             \
+        RuntimeValue op1 = RB;                                       \
+        RuntimeValue op2 = second;                                   \
+        int32_t offset = (int32_t)*ip++;                             \
+        if(!R_COMPARE_VALUES(operation, opcode)){                    \
+            ip += offset;                                            \
+        }                                                            \
+    } while (false)                                                  \
+
+    R_DISPATCH();
+
+    DO_COUNT: {
+        vm->dispatches++;
+        goto *dispatch_table[RI_OP(word)];
+    }
+
+    DO_MOVE:      { RA = RB; R_DISPATCH(); }
+    DO_LOADK:     { RA = k[RI_BX(word)]; R_DISPATCH(); }
+    DO_GETGLOBAL: { RA = globals[RI_BX(word)].value; R_DISPATCH(); }
+    DO_SETGLOBAL: { globals[RI_BX(word)].value = RA; GLOBAL_BARRIER(vm->global, RI_BX(word)); R_DISPATCH(); }
+
+    DO_ADD:  { R_ADD(RC); R_DISPATCH(); }
+    DO_SUB:  { R_ARITHMETIC(-, RC); R_DISPATCH(); }
+    DO_MUL:  { R_ARITHMETIC(*, RC); R_DISPATCH(); }
+    DO_DIV:  { R_ARITHMETIC(/, RC); R_DISPATCH(); }
+    DO_ADDK: { R_ADD(KC); R_DISPATCH(); }
+    DO_SUBK: { R_ARITHMETIC(-, KC); R_DISPATCH(); }
+    DO_MULK: { R_ARITHMETIC(*, KC); R_DISPATCH(); }
+    DO_DIVK: { R_ARITHMETIC(/, KC); R_DISPATCH(); }
+
+    DO_LT:  { R_COMPARE(<, OP_LT, RC);  R_DISPATCH(); }
+    DO_GT:  { R_COMPARE(>, OP_GT, RC);  R_DISPATCH(); }
+    DO_LE:  { R_COMPARE(<=, OP_LE, RC); R_DISPATCH(); }
+    DO_GE:  { R_COMPARE(>=, OP_GE, RC); R_DISPATCH(); }
+    DO_EQ:  { R_COMPARE(==, OP_EQ, RC); R_DISPATCH(); }
+    DO_NE:  { R_COMPARE(!=, OP_NE, RC); R_DISPATCH(); }
+    DO_LTK: { R_COMPARE(<, OP_LT, KC);  R_DISPATCH(); }
+    DO_GTK: { R_COMPARE(>, OP_GT, KC);  R_DISPATCH(); }
+    DO_LEK: { R_COMPARE(<=, OP_LE, KC); R_DISPATCH(); }
+    DO_GEK: { R_COMPARE(>=, OP_GE, KC); R_DISPATCH(); }
+    DO_EQK: { R_COMPARE(==, OP_EQ, KC); R_DISPATCH(); }
+    DO_NEK: { R_COMPARE(!=, OP_NE, KC); R_DISPATCH(); }
+
+    DO_JMP: {
+        int32_t offset = (int32_t)*ip++;
+        ip += offset;
+
+        if(offset < 0){
+            R_SAFEPOINT();
+        }
+
+        R_DISPATCH();
+    }
+
+    DO_JMPF: {
+        int32_t offset = (int32_t)*ip++;
+
+        if(!AS_C_BOOL(RA)){
+            ip += offset;
+        }
+
+        R_DISPATCH();
+    }
+
+    DO_JNLT:  { R_COMPARE_JUMP(<, OP_LT, RC);  R_DISPATCH(); }
+    DO_JNGT:  { R_COMPARE_JUMP(>, OP_GT, RC);  R_DISPATCH(); }
+    DO_JNLE:  { R_COMPARE_JUMP(<=, OP_LE, RC); R_DISPATCH(); }
+    DO_JNGE:  { R_COMPARE_JUMP(>=, OP_GE, RC); R_DISPATCH(); }
+    DO_JNEQ:  { R_COMPARE_JUMP(==, OP_EQ, RC); R_DISPATCH(); }
+    DO_JNNE:  { R_COMPARE_JUMP(!=, OP_NE, RC); R_DISPATCH(); }
+    DO_JNLTK: { R_COMPARE_JUMP(<, OP_LT, KC);  R_DISPATCH(); }
+    DO_JNGTK: { R_COMPARE_JUMP(>, OP_GT, KC);  R_DISPATCH(); }
+    DO_JNLEK: { R_COMPARE_JUMP(<=, OP_LE, KC); R_DISPATCH(); }
+    DO_JNGEK: { R_COMPARE_JUMP(>=, OP_GE, KC); R_DISPATCH(); }
+    DO_JNEQK: { R_COMPARE_JUMP(==, OP_EQ, KC); R_DISPATCH(); }
+    DO_JNNEK: { R_COMPARE_JUMP(!=, OP_NE, KC); R_DISPATCH(); }
+
+    DO_CALL: {
+        R_SAFEPOINT();
+
+        RuntimeValue callee = RA;
+        RuntimeValue* arguments = &RA + 1;
+        uint64 arg_count = RI_B(word);
+
+        if(IS_OBJ(callee) && AS_C_OBJ(callee)->objectType == ObjectType_NativeFunction){
+            NativeFunctionObject fn = AS_NATIVE_FUNCTION(callee);
+
+            // Natives get their arguments last first, the order they come off the stack VM
+            for (size_t i = 0; i < arg_count; i++) {
+                native_args[i] = arguments[arg_count - 1 - i];
+            }
+
+            RuntimeValue (*fun_ptr)() = fn.func_ptr;
+            RA = (*fun_ptr)(arg_count, native_args);
+
+            R_DISPATCH();
+        }
+
+        FunctionObject* fn = (FunctionObject*)AS_C_OBJ(callee);
+
+        if(frame == &vm->frames[REGISTER_FRAME_LIMIT - 1] || arguments + fn->register_count > &vm->registers[REGISTER_STACK_SIZE]){
+            VM_Exception("Stack overflow.");
+        }
+
+        frame->ra = ip;
+        frame++;
+        frame->fn = fn;
+        frame->base = arguments;
+
+        base = arguments;
+        k = fn->constants;
+        ip = fn->register_code;
+
+        R_DISPATCH();
+    }
+
+    DO_RETURN: {
+        RuntimeValue result = RA;
+
+        if(frame == vm->frames){
+            return result;
+        }
+
+        frame--;
+        ip = frame->ra;
+        base = frame->base;
+        k = frame->fn->constants;
+
+        // The CALL just before the return address names the slot for the result
+        base[RI_A(ip[-1])] = result;
+
+        R_DISPATCH();
+    }
+
+    DO_GETMEMBER: {
+        TypeInstanceObject instance = AS_TYPEINSTANCE(RB);
+        RA = Member_Get(&instance, RI_C(word)).value;
+
+        R_DISPATCH();
+    }
+
+    #undef R_DISPATCH
+    #undef RA
+    #undef RB
+    #undef RC
+    #undef KC
+    #undef R_SAFEPOINT
+}
+
+#pragma endregion
+
+#pragma region REGISTER_DISASSEMBLER
+
+static char* _register_opcode_names[ROP_COUNT] = {
+    "MOVE", "LOADK", "GETGLOBAL", "SETGLOBAL", "ADD", "SUB", "MUL", "DIV", "ADDK", "SUBK", "MULK", "DIVK",
+    "LT", "GT", "LE", "GE", "EQ", "NE", "LTK", "GTK", "LEK", "GEK", "EQK", "NEK", "JMP", "JMPF",
+    "JNLT", "JNGT", "JNLE", "JNGE", "JNEQ", "JNNE", "JNLTK", "JNGTK", "JNLEK", "JNGEK", "JNEQK", "JNNEK",
+    "CALL", "RETURN", "GETMEMBER"
+};
+
+void Register_Disassemble(Program* global){
+    for (size_t i = 0; i < array_length(global->functions); i++) {
+        FunctionObject* co = global->functions[i];
+
+        if(co->register_code == NULL){
+            continue;
+        }
+
+        printf("\n------------------ %s REGISTERS (%llu instructions, %llu slots) ------------------\n\n",
+            co->name, (uint64)array_length(co->register_code), (uint64)co->register_count);
+
+        size_t offset = 0;
+
+        while(offset < array_length(co->register_code)){
+            uint32_t word = co->register_code[offset++];
+            uint8_t opcode = RI_OP(word);
+
+            printf("0x%04X\t%-12s", offset - 1, _register_opcode_names[opcode]);
+
+            if(opcode == ROP_LOADK){
+                printf("r%-4u k%-5u (%s)", RI_A(word), RI_BX(word), RuntimeValue_ToString(co->constants[RI_BX(word)]));
+            }
+            else if(opcode == ROP_GETGLOBAL || opcode == ROP_SETGLOBAL){
+                printf("r%-4u g%-5u (%s)", RI_A(word), RI_BX(word), symbol_name(Global_Get(global, RI_BX(word)).name));
+            }
+            else if(Register_IsJump(opcode)){
+                int32_t jump = (int32_t)co->register_code[offset++];
+                bool constant = opcode >= ROP_JNLTK;
+
+                if(opcode >= ROP_JNLT){
+                    printf(constant ? "r%-4u k%-5u " : "r%-4u r%-5u ", RI_B(word), RI_C(word));
+                }
+                else if(opcode == ROP_JMPF){
+                    printf("r%-4u        ", RI_A(word));
+                }
+
+                printf("-> 0x%04X", (uint32_t)(offset + jump));
+            }
+            else if(opcode == ROP_MOVE){
+                printf("r%-4u r%-4u", RI_A(word), RI_B(word));
+            }
+            else if(opcode == ROP_CALL){
+                printf("r%-4u %u args", RI_A(word), RI_B(word));
+            }
+            else if(opcode == ROP_RETURN){
+                printf("r%-4u", RI_A(word));
+            }
+            else{
+                bool constant = (opcode >= ROP_ADDK && opcode <= ROP_DIVK) || (opcode >= ROP_LTK && opcode <= ROP_NEK);
+                printf(constant ? "r%-4u r%-4u k%-4u" : "r%-4u r%-4u r%-4u", RI_A(word), RI_B(word), RI_C(word));
+            }
+
+            printf("\n");
+        }
+    }
+
+    printf("\n");
+}
+
+#pragma endregion
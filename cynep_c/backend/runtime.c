@@ -1,7 +1,11 @@
 #pragma once
 
+#include <setjmp.h>
+
 typedef enum        ValueType ValueType;
 typedef enum        ObjectType ObjectType;
+typedef enum        Purity Purity;
+typedef enum        JitState JitState;
 typedef struct      VM VM;
 typedef struct      Object Object;
 typedef struct      StringObject StringObject;
@@ -15,16 +19,29 @@ typedef struct      NativeFunctionObject NativeFunctionObject;
 typedef struct      TypeInfoObject TypeInfoObject;
 typedef struct      MemberInfo MemberInfo;
 typedef struct      Frame Frame;
+typedef struct      VMProfile VMProfile;
+typedef struct      JitLoop JitLoop;
+typedef struct      JumpFixup JumpFixup;
 typedef uint64_t    RuntimeValue;
+typedef RuntimeValue* (*JitFunction)(VM* vm, RuntimeValue* bp, RuntimeValue* sp); // Returns the stack pointer
+typedef RuntimeValue* (*JitOsrFunction)(VM* vm, RuntimeValue* bp, RuntimeValue* sp, void* entry);
 
 RuntimeValue    vm_interp(VM* vm, Program* global);
-uint8_t         VM_Peek_Byte(VM* vm);
-uint64_t        VM_Read_Address(VM* vm);
+RuntimeValue    VM_Add(RuntimeValue op1, RuntimeValue op2);
+bool            VM_Compare(uint8_t opcode, RuntimeValue op1, RuntimeValue op2);
+bool            vm_evaluate(Program* global, FunctionObject* fn, RuntimeValue* result);
+bool            jit_compile(VM* vm, FunctionObject* fn);
+void*           jit_loop_entry(FunctionObject* fn, size_t offset);
+void            gc_track(Object* object, size_t size);
+Object*         gc_alloc(size_t size);
+Object*         gc_alloc_old(size_t size);
+void            gc_tenure(Program* global);
+void            gc_safepoint(VM* vm, RuntimeValue* sp);
 void            VM_Stack_Push(VM* vm, RuntimeValue value);
 void            VM_Exception(char* msg);
 void            VM_DumpStack(VM* vm, uint8_t code);
 char*           opcodeToString(uint8_t opcode);
-int64_t         Member_GetIndex(TypeInfoObject* instance, char* name);
+int64_t         Member_GetIndex(TypeInfoObject* instance, Symbol name);
 
 
 #pragma region TYPES
@@ -37,13 +54,30 @@ enum ObjectType {
     ObjectType_TypeInstance
 };
 
+enum Purity {
+    Purity_Unknown, // Not compiled yet
+    Purity_Pure, // Result only depends on the arguments, can run at compile time
+    Purity_Impure
+};
+
+enum JitState {
+    Jit_Cold, // Interpreted, counting towards JIT_HOT_THRESHOLD
+    Jit_Compiled,
+    Jit_Failed // Uses something the JIT does not handle, stays interpreted
+};
+
 struct Object {
     ObjectType objectType;
+    bool marked; // Reached by the running collection
+    Object* next; // Heap registry, only set for objects the collector owns
 };
 
 struct StringObject {
     Object object;
-    char* string;
+    char* string; // Null terminated, follows the object in the same block
+    size_t length; // Bytes, without the terminator
+    uint64 hash; // 0 until String_Hash is asked for it
+    bool interned; // No other interned string has the same bytes
 };
 
 struct NativeFunctionObject {
@@ -51,6 +85,7 @@ struct NativeFunctionObject {
     void* func_ptr;
     char* name;
     size_t arity;
+    bool pure; // No side effects, may be called during compile time evaluation
 };
 
 struct FunctionObject {
@@ -60,8 +95,20 @@ struct FunctionObject {
     uint8_t* code;
     RuntimeValue* constants;
     LocalVar* locals;
+    uint32_t* register_code; // Register engine code, NULL unless register_compile has run
+    size_t register_count; // Slots in a register frame
+    JitFunction jit_code; // Machine code, NULL until the function gets hot
+    JitState jit_state;
+    JitOsrFunction jit_osr; // Enters jit_code at a loop header, for functions that got hot while running
+    JitLoop* jit_loops; // Loop headers in jit_code
+    uint32_t hotness; // Calls and backward jumps while interpreted
 
     int8_t scope_level; // Only for compiler state
+    Purity purity; // Only for compiler state
+    Table local_table; // Only for compiler state. Symbol -> index of the innermost local with that name
+    Table constant_table; // Only for compiler state. Number bits -> index in constants
+    Table string_constant_table; // Only for compiler state. Symbol -> index in constants
+    JumpFixup* far_jumps; // Only for compiler state. Jumps that need the wide form, see Relax_Jumps
 };
 
 struct TypeInfoObject {
@@ -71,8 +118,19 @@ struct TypeInfoObject {
     char* name;
 };
 
+struct JitLoop {
+    size_t offset; // Bytecode offset of the loop header
+    void* entry; // Where that offset starts in the machine code
+};
+
+// A jump whose operand is written once the code around it stops moving
+struct JumpFixup {
+    size_t offset; // Of the jump instruction
+    size_t target;
+};
+
 struct MemberInfo {
-    char* name;
+    Symbol name;
 };
 
 struct TypeInstanceObject {
@@ -83,25 +141,30 @@ struct TypeInstanceObject {
 };
 
 struct MemberVar {
-    char* name;
+    Symbol name;
     RuntimeValue value;
 };
 
 struct GlobalVar {
-    char* name;
+    Symbol name;
     RuntimeValue value;
 };
 
 struct LocalVar {
-    char* name;
+    Symbol name;
     int8_t scope_level;
+    int64 shadowed; // Index of the local this one shadows, or -1
     RuntimeValue value;
 };
 
 struct Program {
     GlobalVar* globals; // Array of global variables
+    uint8_t* global_cards; // One per 1 << GC_CARD_SHIFT globals, set by every store to one of them
+    Table global_table; // Symbol -> index in globals
     FunctionObject** functions; // all functions //! Why is this an array of pointers? Fix?
     FunctionObject* main_function; // main function
+    RuntimeValue* const_values; // Only for compiler state
+    Table const_table; // Only for compiler state. Symbol -> index in const_values
 };
 
 struct Frame {
@@ -119,10 +182,20 @@ struct VM {
     RuntimeValue stack[512]; // Array of values
     Frame callstack[512];
     Frame* csp; // call stack pointer
+    uint64 budget; // Calls and backward jumps left before giving up, 0 is unlimited
+    bool quicken; // Generic opcodes may rewrite themselves
+    bool jit; // Hot functions are compiled to machine code
+    bool gc; // Collects garbage at safepoints
+    VMProfile* profile; // Opcode sequence counts, NULL unless profiling
 };
 
 
 
+#define GC_CARD_SHIFT 4
+
+// Write barrier of the globals. Tells the next minor collection to look at them, they may hold a young object now.
+#define GLOBAL_BARRIER(global, index) ((global)->global_cards[(index) >> GC_CARD_SHIFT] = 1)
+
 #pragma endregion
 
 #pragma region RUNTIME_VALUE
@@ -132,6 +205,7 @@ struct VM {
 #define TAG_NULL  1
 #define TAG_FALSE 2
 #define TAG_TRUE  3
+#define TAG_SHORT_STRING ((uint64_t)1 << 48) // Characters in the 48 bits below
 
 #define NUMBER_VAL(num) (numToValue(num))
 #define FALSE_VAL ((RuntimeValue)(uint64_t)(QUIET_NAN | TAG_FALSE))
@@ -144,6 +218,8 @@ struct VM {
 #define IS_NULL(value) ((value) == NULL_VAL)
 #define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
 #define IS_OBJ(value) (((value) & (QUIET_NAN | SIGN_BIT)) == (QUIET_NAN | SIGN_BIT))
+#define IS_SHORT_STRING(value) (((value) & (SIGN_BIT | QUIET_NAN | TAG_SHORT_STRING)) == (QUIET_NAN | TAG_SHORT_STRING))
+#define IS_STRING(value) (IS_SHORT_STRING(value) || (IS_OBJ(value) && AS_C_OBJ(value)->objectType == ObjectType_String))
 
 #define AS_C_BOOL(value) ((value) == TRUE_VAL)
 #define AS_C_DOUBLE(value) valueToNum(value)
@@ -167,6 +243,46 @@ static inline double valueToNum(RuntimeValue val){
     return num;
 }
 
+// Strings of up to SHORT_STRING_MAX characters live in the value itself, first character in the lowest
+// byte. Strings never hold a zero byte, so the length is where the zero padding starts. Every string that
+// short is stored this way, so two short strings are equal exactly when their values are.
+#define SHORT_STRING_MAX 6
+#define SHORT_STRING_CHARS ((uint64_t)0xffffffffffff)
+
+static inline RuntimeValue Short_String(char* chars, size_t length){
+    uint64_t payload = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        payload |= (uint64_t)(uint8_t)chars[i] << (8 * i);
+    }
+
+    return QUIET_NAN | TAG_SHORT_STRING | payload;
+}
+
+static inline size_t Short_String_Length(RuntimeValue value){
+    uint64_t payload = value & SHORT_STRING_CHARS;
+
+    // Highest byte that is not zero
+    return payload == 0 ? 0 : (71 - __builtin_clzll(payload)) / 8;
+}
+
+// Null terminated characters of any string. Short strings are unpacked into buffer.
+static inline char* String_Chars(RuntimeValue value, char buffer[SHORT_STRING_MAX + 1], size_t* length){
+    if(IS_SHORT_STRING(value)){
+        *length = Short_String_Length(value);
+
+        for (size_t i = 0; i < SHORT_STRING_MAX; i++) {
+            buffer[i] = (char)(value >> (8 * i));
+        }
+
+        buffer[*length] = NULL_CHAR;
+        return buffer;
+    }
+
+    *length = AS_STRING(value).length;
+    return AS_STRING(value).string;
+}
+
 char* RuntimeValue_ToString(RuntimeValue value){
     size_t buff_size = 100; 
     
@@ -188,10 +304,13 @@ char* RuntimeValue_ToString(RuntimeValue value){
         FunctionObject code = AS_FUNCTION(value);
         return code.name;
     }
-    if(IS_OBJ(value) && AS_C_OBJ(value)->objectType == ObjectType_String){
-        StringObject str = AS_STRING(value);
-        char* buf = malloc(sizeof(char) * buff_size);
-        strcpy(buf, str.string);
+    if(IS_STRING(value)){
+        char buffer[SHORT_STRING_MAX + 1];
+        size_t length;
+        char* chars = String_Chars(value, buffer, &length);
+
+        char* buf = malloc(length + 1);
+        memcpy(buf, chars, length + 1);
         return buf;
     }
     if(IS_OBJ(value) && AS_C_OBJ(value)->objectType == ObjectType_NativeFunction){
@@ -212,73 +331,102 @@ char* RuntimeValue_ToString(RuntimeValue value){
     return "VM: ToString not implemented";
 }
 
-RuntimeValue Alloc_String(char* value){
-    RuntimeValue result;
-
-    StringObject* stringObject = malloc(sizeof(StringObject));
+// Sets up a string in memory that has room for length characters and the terminator after the object
+static StringObject* _string_init(void* memory, size_t length){
+    StringObject* stringObject = memory;
 
     stringObject->object.objectType = ObjectType_String;
-    stringObject->string = malloc(strlen(value) * sizeof(char) + 1);
+    stringObject->string = (char*)(stringObject + 1);
+    stringObject->string[length] = NULL_CHAR;
+    stringObject->length = length;
+    stringObject->hash = 0;
+    stringObject->interned = false;
 
-    result = OBJ_VAL(stringObject);
-    
-    strcpy(stringObject->string, value);
+    return stringObject;
+}
 
-    return result;
+RuntimeValue Alloc_String(char* value){
+    size_t length = strlen(value);
+
+    if(length <= SHORT_STRING_MAX){
+        return Short_String(value, length);
+    }
+
+    // Characters follow the object in the same block
+    StringObject* stringObject = _string_init(gc_alloc(sizeof(StringObject) + length + 1), length);
+    memcpy(stringObject->string, value, length);
+
+    return OBJ_VAL(stringObject);
 }
 
 RuntimeValue Alloc_NativeFunction(void* func, char* name, size_t arity){
     RuntimeValue result;
 
-    NativeFunctionObject* nativeFunctionObject = malloc(sizeof(NativeFunctionObject));
+    NativeFunctionObject* nativeFunctionObject = slab_alloc(sizeof(NativeFunctionObject));
 
     nativeFunctionObject->object.objectType = ObjectType_NativeFunction;
     nativeFunctionObject->arity = arity;
     nativeFunctionObject->func_ptr = func;
     nativeFunctionObject->name = name;
+    nativeFunctionObject->pure = false;
 
     result = OBJ_VAL(nativeFunctionObject);
     return result;
 }
 
-RuntimeValue Alloc_String_Combine(StringObject* one, StringObject* two){
-    RuntimeValue result;
+RuntimeValue Alloc_String_Combine(RuntimeValue one, RuntimeValue two){
+    // Two short strings that still fit are shifted together. Heap strings are longer than SHORT_STRING_MAX,
+    // so anything else goes on the heap.
+    if(IS_SHORT_STRING(one) && IS_SHORT_STRING(two)){
+        size_t shift = 8 * Short_String_Length(one);
 
-    char* str1 = one->string;
-    char* str2 = two->string;
-
-    uint64 str1_size = strlen(str1);
-    uint64 str2_size = strlen(str2);
+        if(shift + 8 * Short_String_Length(two) <= 8 * SHORT_STRING_MAX){
+            return one | ((two & SHORT_STRING_CHARS) << shift);
+        }
+    }
 
-    // Put string and string object in same memory block for performance
-    void* memory = malloc(sizeof(StringObject) + (str1_size + str2_size) * sizeof(char));
-    char* string = memory + sizeof(StringObject);
+    char one_buffer[SHORT_STRING_MAX + 1];
+    char two_buffer[SHORT_STRING_MAX + 1];
+    size_t one_length;
+    size_t two_length;
+    char* one_chars = String_Chars(one, one_buffer, &one_length);
+    char* two_chars = String_Chars(two, two_buffer, &two_length);
 
-    strcpy(string, str1);
-    strcpy(&string[str1_size], str2);
+    size_t length = one_length + two_length;
 
-    StringObject* stringObject = memory;
-    stringObject->object.objectType = ObjectType_String;
+    // Put string and string object in same memory block for performance, most of them die young
+    StringObject* stringObject = _string_init(gc_alloc(sizeof(StringObject) + length + 1), length);
 
-    stringObject->string = string;
+    memcpy(stringObject->string, one_chars, one_length);
+    memcpy(&stringObject->string[one_length], two_chars, two_length);
 
-    result = OBJ_VAL(stringObject);
-    
-    return result;
+    return OBJ_VAL(stringObject);
 }
 
 RuntimeValue Alloc_Function(char* name, size_t arity){
     RuntimeValue result;
 
 
-    FunctionObject* co = malloc(sizeof(FunctionObject));
+    FunctionObject* co = slab_alloc(sizeof(FunctionObject));
     co->object.objectType = ObjectType_Code;
     co->name = name;
     co->code = NULL;
     co->constants = NULL;
     co->locals = NULL;
+    co->register_code = NULL;
+    co->register_count = 0;
+    co->jit_code = NULL;
+    co->jit_state = Jit_Cold;
+    co->jit_osr = NULL;
+    co->jit_loops = NULL;
+    co->hotness = 0;
     co->scope_level = 0;
+    co->purity = Purity_Unknown;
     co->arity = arity;
+    table_init(&co->local_table);
+    table_init(&co->constant_table);
+    table_init(&co->string_constant_table);
+    co->far_jumps = NULL;
 
     arrsetcap(co->code, 1);
     arrsetcap(co->constants, 1);
@@ -289,25 +437,20 @@ RuntimeValue Alloc_Function(char* name, size_t arity){
     return result;
 }
 
-RuntimeValue Alloc_TypeInfo(TypeDeclaration* typeDeclaration){
+RuntimeValue Alloc_TypeInfo(Ast* ast, TypeDeclaration* typeDeclaration){
     RuntimeValue result;
 
-    TypeInfoObject* co = malloc(sizeof(TypeInfoObject));
+    TypeInfoObject* co = slab_alloc(sizeof(TypeInfoObject) + typeDeclaration->properties.count * sizeof(MemberInfo));
     co->object.objectType = ObjectType_TypeInfo;
-    co->members = malloc(typeDeclaration->properties->count * sizeof(MemberInfo));
-    co->members_length = typeDeclaration->properties->count;
-    co->name= typeDeclaration->name;
-
-    ListNode* cursor = typeDeclaration->properties->first;
-    int i = 0;
-    while(cursor != NULL){
-        PropertyDeclaration* prop = (PropertyDeclaration*)cursor->value;
+    co->members = (MemberInfo*)(co + 1);
+    co->members_length = typeDeclaration->properties.count;
+    co->name= symbol_name(typeDeclaration->name);
+
+    for (size_t i = 0; i < typeDeclaration->properties.count; i++) {
+        PropertyDeclaration* prop = AST_GET(ast, Ast_Child(ast, typeDeclaration->properties, i), PropertyDeclaration);
         MemberInfo* member = &co->members[i];
 
         member->name = prop->name;
-
-        i++;
-        cursor = cursor->next;
     }
 
     result = OBJ_VAL(co);
@@ -318,10 +461,11 @@ RuntimeValue Alloc_TypeInfo(TypeDeclaration* typeDeclaration){
 RuntimeValue Alloc_TypeInstance(TypeInfoObject* typeInfo){
     RuntimeValue result;
 
-    TypeInstanceObject* co = malloc(sizeof(TypeInstanceObject));
+    // Members follow the instance in the same block
+    TypeInstanceObject* co = (TypeInstanceObject*)gc_alloc(sizeof(TypeInstanceObject) + typeInfo->members_length * sizeof(MemberVar));
 
     co->object.objectType = ObjectType_TypeInstance;
-    co->members = malloc(typeInfo->members_length * sizeof(MemberVar));
+    co->members = (MemberVar*)(co + 1);
     co->members_length = typeInfo->members_length;
 
     for (size_t i = 0; i < typeInfo->members_length; i++)
@@ -337,6 +481,144 @@ RuntimeValue Alloc_TypeInstance(TypeInfoObject* typeInfo){
 
 #pragma endregion
 
+#pragma region STRINGS
+
+typedef struct StringTable StringTable;
+
+// Weak intern table of the string constants. Open addressing with linear probing, keyed on the contents.
+// Interned strings live in the old space, so they never move, and the collector takes them out of the
+// table when it frees them.
+
+struct StringTable {
+    StringObject** entries; // NULL when empty
+    size_t count; // Including tombstones
+    size_t capacity; // Always a power of two
+};
+
+#define STRING_TOMBSTONE ((StringObject*)1) // Removed, probing goes on past it
+#define STRING_TABLE_MIN_CAPACITY 64
+
+StringTable _strings = { .entries = NULL, .count = 0, .capacity = 0 };
+
+uint64 String_Hash(StringObject* string){
+    if(string->hash == 0){
+        uint64 hash = hash_bytes(string->string, string->length);
+        string->hash = hash == 0 ? 1 : hash; // 0 means not computed yet
+    }
+
+    return string->hash;
+}
+
+// Slot of the string with these contents, or the slot to put it in
+static StringObject** _string_table_find(StringObject** entries, size_t capacity, char* chars, size_t length, uint64 hash){
+    size_t mask = capacity - 1;
+    size_t index = hash & mask;
+    StringObject** tombstone = NULL;
+
+    while(true){
+        StringObject** entry = &entries[index];
+
+        if(*entry == NULL){
+            return tombstone != NULL ? tombstone : entry;
+        }
+
+        if(*entry == STRING_TOMBSTONE){
+            tombstone = tombstone != NULL ? tombstone : entry;
+        }
+        else if((*entry)->hash == hash && (*entry)->length == length && memcmp((*entry)->string, chars, length) == 0){
+            return entry;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void _string_table_grow(){
+    size_t capacity = _strings.capacity < STRING_TABLE_MIN_CAPACITY ? STRING_TABLE_MIN_CAPACITY : _strings.capacity * 2;
+    StringObject** entries = calloc(capacity, sizeof(StringObject*));
+    size_t count = 0;
+
+    // Tombstones are left behind
+    for (size_t i = 0; i < _strings.capacity; i++) {
+        StringObject* string = _strings.entries[i];
+
+        if(string != NULL && string != STRING_TOMBSTONE){
+            *_string_table_find(entries, capacity, string->string, string->length, string->hash) = string;
+            count++;
+        }
+    }
+
+    free(_strings.entries);
+    _strings.entries = entries;
+    _strings.capacity = capacity;
+    _strings.count = count;
+}
+
+// The one string with these contents, two interned strings are equal only if they are the same object.
+// Short strings are values already and are not put in the table.
+RuntimeValue Intern_String(char* value){
+    size_t length = strlen(value);
+
+    if(length <= SHORT_STRING_MAX){
+        return Short_String(value, length);
+    }
+
+    uint64 hash = hash_bytes(value, length);
+    hash = hash == 0 ? 1 : hash;
+
+    // Keep load factor below 1/2
+    if((_strings.count + 1) * 2 > _strings.capacity){
+        _string_table_grow();
+    }
+
+    StringObject** entry = _string_table_find(_strings.entries, _strings.capacity, value, length, hash);
+
+    if(*entry != NULL && *entry != STRING_TOMBSTONE){
+        return OBJ_VAL(*entry);
+    }
+
+    StringObject* string = _string_init(gc_alloc_old(sizeof(StringObject) + length + 1), length);
+    memcpy(string->string, value, length);
+    string->hash = hash;
+    string->interned = true;
+
+    if(*entry == NULL){
+        _strings.count++;
+    }
+
+    *entry = string;
+
+    return OBJ_VAL(string);
+}
+
+// Called by the collector before it frees an interned string
+void String_Unintern(StringObject* string){
+    *_string_table_find(_strings.entries, _strings.capacity, string->string, string->length, string->hash) = STRING_TOMBSTONE;
+}
+
+bool String_Equals(StringObject* one, StringObject* two){
+    if(one == two){
+        return true;
+    }
+
+    if(one->interned && two->interned){
+        return false;
+    }
+
+    if(one->length != two->length){
+        return false;
+    }
+
+    // Hashes are only compared when both are known, working one out reads the whole string anyway
+    if(one->hash != 0 && two->hash != 0 && one->hash != two->hash){
+        return false;
+    }
+
+    return memcmp(one->string, two->string, one->length) == 0;
+}
+
+#pragma endregion
+
 #pragma region GLOBAL_OBJECT
 
 GlobalVar Global_Get(Program* global, int64 index){
@@ -350,26 +632,27 @@ void Global_Set(Program* global, int64 index, RuntimeValue* value){
     }
 
     global->globals[index].value = *value;
+    GLOBAL_BARRIER(global, index);
 }
 
-int64 Global_GetIndex(Program* global, char* name){
-    if(array_length(global->globals) > 1){
-        for(int64 i = array_length(global->globals) - 1; i >= 0; i--){
-            if(strcmp(global->globals[i].name, name) == 0){
-                return i;
-            }
-        }
+int64 Global_GetIndex(Program* global, Symbol name){
+    return table_get_int(&global->global_table, name);
+}
+
+void Global_Add(Program* global, GlobalVar var){
+    array_push(global->globals, var);
+
+    if(((array_length(global->globals) - 1) & ((1 << GC_CARD_SHIFT) - 1)) == 0){
+        array_push(global->global_cards, 0);
     }
 
-    return -1;
+    table_set_int(&global->global_table, var.name, array_length(global->globals) - 1);
 }
 
-int64 Member_GetIndex(TypeInfoObject* instance, char* name){
-    if(instance->members_length > 1){
-        for(int64 i = instance->members_length - 1; i >= 0; i--){
-            if(strcmp(instance->members[i].name, name) == 0){
-                return i;
-            }
+int64 Member_GetIndex(TypeInfoObject* instance, Symbol name){
+    for(int64 i = instance->members_length - 1; i >= 0; i--){
+        if(instance->members[i].name == name){
+            return i;
         }
     }
 
@@ -380,7 +663,7 @@ MemberVar Member_Get(TypeInstanceObject* co, int64 index){
     return co->members[index];
 }
 
-void program_define_global(Program* global, char* name)
+void program_define_global(Program* global, Symbol name)
 {
     int64 index = Global_GetIndex(global, name);
 
@@ -392,66 +675,74 @@ void program_define_global(Program* global, char* name)
     var.name = name;
     var.value = NUMBER_VAL(0); // TODO: Set to null
 
-    array_push(global->globals, var);
+    Global_Add(global, var);
 }
 
 void program_add_global(Program* global, char* name, RuntimeValue value)
 {
-    if(Global_GetIndex(global, name) != -1){
+    Symbol symbol = symbol_intern_string(name);
+
+    if(Global_GetIndex(global, symbol) != -1){
         return;
     }
 
     GlobalVar var;
-    var.name = name;
+    var.name = symbol;
     var.value = value;
 
-    array_push(global->globals, var);
+    Global_Add(global, var);
 }
 
-void program_add_native_function(Program* global, char* name, void* func_ptr, size_t arity)
+// Pure natives may be called by functions that are evaluated at compile time
+void program_add_native_function(Program* global, char* name, void* func_ptr, size_t arity, bool pure)
 {
-    if(Global_GetIndex(global, name) != -1){
+    Symbol symbol = symbol_intern_string(name);
+
+    if(Global_GetIndex(global, symbol) != -1){
         return;
     }
 
     RuntimeValue function = Alloc_NativeFunction(func_ptr, name, arity);
+    AS_NATIVE_FUNCTION(function).pure = pure;
    
     GlobalVar var;
-    var.name = name;
+    var.name = symbol;
     var.value = function;
 
-    array_push(global->globals, var);
+    Global_Add(global, var);
 }
 
 Program* make_program(){
     Program* global = malloc(sizeof(Program));
     global->globals = NULL;
+    global->global_cards = NULL;
     global->functions = NULL;
+    global->const_values = NULL;
+    table_init(&global->global_table);
+    table_init(&global->const_table);
 
     return global;
 }
 
+int64 Const_GetIndex(Program* global, Symbol name){
+    return table_get_int(&global->const_table, name);
+}
+
+void Const_Define(Program* global, Symbol name, RuntimeValue value){
+    array_push(global->const_values, value);
+    table_set_int(&global->const_table, name, array_length(global->const_values) - 1);
+}
+
 #pragma endregion
 
 #pragma region LOCALS
 
-int64_t Local_GetIndex(FunctionObject* func, char* name){
-    // We iterate backwards to grab the one with the closest scope level first. (It should be added closer to the end)
-    if(array_length(func->locals) > 0)
-    {
-        for(int64_t i = array_length(func->locals) - 1; i >= 0; i--)
-        {
-            if(strcmp(name, func->locals[i].name) == 0 )
-            {
-                return i;
-            }
-        }
-    }
-
-    return -1;
+int64_t Local_GetIndex(FunctionObject* func, Symbol name){
+    // The table always points at the closest scope level, shadowed locals are restored by Local_PopScope
+    return table_get_int(&func->local_table, name);
 }
 
-void Local_Define(FunctionObject* func, char* name){
+void Local_Define(FunctionObject* func, Symbol name){
 
     // TODO: den här ska hämta med strikt scope
     // int64 index = Local_GetIndex(co, name);
@@ -464,13 +755,24 @@ void Local_Define(FunctionObject* func, char* name){
     LocalVar var;
     var.scope_level = func->scope_level;
     var.name = name;
+    var.shadowed = Local_GetIndex(func, name);
     var.value = NULL_VAL;
 
     array_push(func->locals, var);
+    table_set_int(&func->local_table, name, array_length(func->locals) - 1);
 
     return;
 }
 
+void Local_PopScope(FunctionObject* func, size_t count){
+    // Pop in reverse so a name declared twice in the same scope is restored correctly
+    for (size_t i = 0; i < count; i++)
+    {
+        LocalVar var = array_pop(func->locals);
+        table_set_int(&func->local_table, var.name, var.shadowed);
+    }
+}
+
 LocalVar Local_Get(FunctionObject* func, int64 index){
     return func->locals[index];
 }
@@ -490,37 +792,301 @@ LocalVar Local_Get(FunctionObject* func, int64 index){
 
 #pragma region VIRTUAL_MACHINE
 
-#define OP_HALT             0x00
-#define OP_CONST            0x01
-#define OP_ADD              0x02
-#define OP_SUB              0x03
-#define OP_MUL              0x04
-#define OP_DIV              0x05
-#define OP_CMP              0x06
-#define OP_JMP_IF_FALSE     0x07
-#define OP_JMP              0x08
-#define OP_POP              0x09
-#define OP_GET_GLOBAL       0x0A
-#define OP_SET_GLOBAL       0x0B
-#define OP_GET_LOCAL        0x0C
-#define OP_SET_LOCAL        13
-#define OP_SCOPE_EXIT       14
-#define OP_CALL             15
-#define OP_RETURN           16
-#define OP_GET_MEMBER       17
-
-#define OP_CMP_GT           0x01
-#define OP_CMP_LT           0x02
-#define OP_CMP_EQ           0x03
-#define OP_CMP_GE           0x04
-#define OP_CMP_LE           0x05
-#define OP_CMP_NE           0x06
+#define OP_HALT             0
+#define OP_CONST            1
+#define OP_ADD              2
+#define OP_SUB              3
+#define OP_MUL              4
+#define OP_DIV              5
+#define OP_LT               6 // Comparisons push a boolean, same order as the fused branches
+#define OP_GT               7
+#define OP_LE               8
+#define OP_GE               9
+#define OP_EQ               10
+#define OP_NE               11
+#define OP_JMP_IF_FALSE     12
+#define OP_JMP              13
+#define OP_POP              14
+#define OP_GET_GLOBAL       15
+#define OP_SET_GLOBAL       16
+#define OP_GET_LOCAL        17
+#define OP_SET_LOCAL        18
+#define OP_SCOPE_EXIT       19
+#define OP_CALL             20
+#define OP_RETURN           21
+#define OP_GET_MEMBER       22
+#define OP_WIDE             23
+
+// Superinstructions, only produced by the peephole pass. Operands are always one byte.
+#define OP_INC_LOCAL        24 // local, const:  local = local + const
+#define OP_INC_GLOBAL       25 // global, const: global = global + const
+#define OP_ADD_LOCAL_CONST  26 // local, const:  push local + const
+#define OP_LOAD_LOCAL2      27 // local, local:  push both
+#define OP_CONST_SET_LOCAL  28 // const, local:  push const and store it in local
+#define OP_STORE_LOCAL      29 // local:         pop into local
+#define OP_STORE_GLOBAL     30 // global:        pop into global
+
+// Compare and branch. Pops both operands and jumps when the comparison is false, no boolean is made.
+// OP_JMP_IF_NOT_LT + (compare - OP_LT) is the branch for a compare opcode.
+#define OP_JMP_IF_NOT_LT    31
+#define OP_JMP_IF_NOT_GT    32
+#define OP_JMP_IF_NOT_LE    33
+#define OP_JMP_IF_NOT_GE    34
+#define OP_JMP_IF_NOT_EQ    35
+#define OP_JMP_IF_NOT_NE    36
+
+// Quickened opcodes. The generic opcode rewrites itself in place to one of these after looking at its
+// operands. Each keeps a cheap guard and rewrites itself back to the generic opcode when it fails.
+// Same order as the generic compares and branches, see Opcode_Quicken.
+#define OP_ADD_NUM              37
+#define OP_ADD_STR              38
+#define OP_LT_NUM               39
+#define OP_GT_NUM               40
+#define OP_LE_NUM               41
+#define OP_GE_NUM               42
+#define OP_EQ_NUM               43
+#define OP_NE_NUM               44
+#define OP_JMP_IF_NOT_LT_NUM    45
+#define OP_JMP_IF_NOT_GT_NUM    46
+#define OP_JMP_IF_NOT_LE_NUM    47
+#define OP_JMP_IF_NOT_GE_NUM    48
+#define OP_JMP_IF_NOT_EQ_NUM    49
+#define OP_JMP_IF_NOT_NE_NUM    50
+#define OP_INC_LOCAL_NUM        51 // The constant is known to be a number, only the local is checked
+#define OP_INC_GLOBAL_NUM       52
+#define OP_ADD_LOCAL_CONST_NUM  53
+
+#define OP_COUNT            54
+
+// Bytecode format:
+// Index operands (constants, globals, locals, members, counts) are one byte.
+// If an index does not fit, the instruction is prefixed with OP_WIDE and the operand is 16 bit.
+// Jump operands are signed 16 bit offsets relative to the end of the jump instruction, or 32 bit after OP_WIDE.
+// Multi byte operands are little endian.
+
+// Generic opcode of a quickened one, other opcodes are returned as they are
+uint8_t Opcode_Generic(uint8_t opcode){
+    switch (opcode)
+    {
+        case OP_ADD_NUM:
+        case OP_ADD_STR:
+            return OP_ADD;
+
+        case OP_INC_LOCAL_NUM: return OP_INC_LOCAL;
+        case OP_INC_GLOBAL_NUM: return OP_INC_GLOBAL;
+        case OP_ADD_LOCAL_CONST_NUM: return OP_ADD_LOCAL_CONST;
+
+        default: {
+            if(opcode >= OP_LT_NUM && opcode <= OP_NE_NUM){
+                return OP_LT + (opcode - OP_LT_NUM);
+            }
+
+            if(opcode >= OP_JMP_IF_NOT_LT_NUM && opcode <= OP_JMP_IF_NOT_NE_NUM){
+                return OP_JMP_IF_NOT_LT + (opcode - OP_JMP_IF_NOT_LT_NUM);
+            }
+
+            return opcode;
+        }
+    }
+}
+
+static inline bool Opcode_IsJump(uint8_t opcode){
+    opcode = Opcode_Generic(opcode);
+    return opcode == OP_JMP || opcode == OP_JMP_IF_FALSE || (opcode >= OP_JMP_IF_NOT_LT && opcode <= OP_JMP_IF_NOT_NE);
+}
+
+// Length of the instruction at code in bytes, including an OP_WIDE prefix
+size_t Instruction_Length(uint8_t* code){
+    if(code[0] == OP_WIDE){
+        return Opcode_IsJump(code[1]) ? 6 : 4; // Otherwise only instructions with a single index operand are wide
+    }
+
+    if(Opcode_IsJump(code[0])){
+        return 3;
+    }
+
+    switch (Opcode_Generic(code[0]))
+    {
+        case OP_HALT:
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_LT:
+        case OP_GT:
+        case OP_LE:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE:
+        case OP_POP:
+            return 1;
+
+        case OP_INC_LOCAL:
+        case OP_INC_GLOBAL:
+        case OP_ADD_LOCAL_CONST:
+        case OP_LOAD_LOCAL2:
+        case OP_CONST_SET_LOCAL:
+            return 3;
+
+        default:
+            return 2; // One byte operand
+    }
+}
+
+// Offset the jump at code[offset] lands on
+size_t Jump_Target(uint8_t* code, size_t offset){
+    if(code[offset] == OP_WIDE){
+        uint8_t* operand = &code[offset + 2];
+        int32_t relative = (int32_t)(operand[0] | (operand[1] << 8) | (operand[2] << 16) | ((uint32_t)operand[3] << 24));
+        return offset + 6 + relative;
+    }
+
+    int16_t relative = (int16_t)(code[offset + 1] | (code[offset + 2] << 8));
+    return offset + 3 + relative;
+}
+
+// Index operand of the instruction at code, 16 bit after OP_WIDE. Only bytes of the instruction are read, so
+// instructions without an operand give 0, short jumps the low byte of their offset.
+uint64 Instruction_Operand(uint8_t* code){
+    if(code[0] == OP_WIDE){
+        return code[2] | (code[3] << 8);
+    }
+
+    return Instruction_Length(code) > 1 ? code[1] : 0;
+}
+
+// Second one byte operand of a superinstruction, 0 for instructions that do not have one
+uint8_t Instruction_Second(uint8_t* code){
+    return code[0] != OP_WIDE && Instruction_Length(code) > 2 ? code[2] : 0;
+}
+
+// Points the jump at code[offset] to target. The caller makes sure the distance fits the form of the jump.
+void Write_Jump(uint8_t* code, size_t offset, size_t target){
+    bool wide = code[offset] == OP_WIDE;
+    size_t operand = offset + 1 + wide;
+    size_t width = wide ? 4 : 2;
+    uint64_t relative = (uint64_t)((int64)target - (int64)(operand + width));
+
+    for (size_t i = 0; i < width; i++) {
+        code[operand + i] = (relative >> (8 * i)) & 0xFF;
+    }
+}
+
+#pragma region PROFILER
+
+// Counts of dynamically executed opcode sequences, used to pick superinstructions
+struct VMProfile {
+    uint64 dispatches;
+    uint8_t previous[2]; // Last two opcodes, most recent first
+    uint64 pairs[OP_COUNT][OP_COUNT];
+    uint64 triples[OP_COUNT][OP_COUNT][OP_COUNT];
+};
+
+VMProfile* VM_ProfileCreate(){
+    VMProfile* profile = calloc(1, sizeof(VMProfile));
+    return profile;
+}
+
+static inline void VM_ProfileRecord(VMProfile* profile, uint8_t opcode){
+    // Opcodes only pair up once there is history
+    if(profile->dispatches >= 1){
+        profile->pairs[profile->previous[0]][opcode]++;
+    }
+
+    if(profile->dispatches >= 2){
+        profile->triples[profile->previous[1]][profile->previous[0]][opcode]++;
+    }
+
+    profile->previous[1] = profile->previous[0];
+    profile->previous[0] = opcode;
+    profile->dispatches++;
+}
+
+typedef struct ProfileEntry ProfileEntry;
+
+struct ProfileEntry {
+    uint64 count;
+    uint8_t opcodes[3];
+};
+
+static int _profile_entry_compare(const void* a, const void* b){
+    uint64 first = ((ProfileEntry*)a)->count;
+    uint64 second = ((ProfileEntry*)b)->count;
+
+    return first < second ? 1 : first > second ? -1 : 0;
+}
+
+static void _profile_print_top(char* title, ProfileEntry* entries, size_t length, size_t width, uint64 dispatches){
+    qsort(entries, array_length(entries), sizeof(ProfileEntry), _profile_entry_compare);
+
+    printf("\n%s\n", title);
+
+    for (size_t i = 0; i < array_length(entries) && i < length; i++) {
+        char sequence[64] = { 0 };
+
+        for (size_t j = 0; j < width; j++) {
+            strcat(sequence, opcodeToString(entries[i].opcodes[j]));
+            strcat(sequence, j + 1 < width ? " " : "");
+        }
+
+        printf("  %-50s %12llu %6.2f%%\n", sequence, entries[i].count, entries[i].count * 100.0 / dispatches);
+    }
+}
+
+void VM_PrintProfile(VMProfile* profile){
+    ProfileEntry* pairs = NULL;
+    ProfileEntry* triples = NULL;
+
+    for (size_t a = 0; a < OP_COUNT; a++) {
+        for (size_t b = 0; b < OP_COUNT; b++) {
+            if(profile->pairs[a][b] > 0){
+                ProfileEntry entry = { profile->pairs[a][b], { a, b } };
+                array_push(pairs, entry);
+            }
+
+            for (size_t c = 0; c < OP_COUNT; c++) {
+                if(profile->triples[a][b][c] > 0){
+                    ProfileEntry entry = { profile->triples[a][b][c], { a, b, c } };
+                    array_push(triples, entry);
+                }
+            }
+        }
+    }
+
+    printf("\n------------------ OPCODE PROFILE (%llu dispatches) ------------------\n", profile->dispatches);
+
+    _profile_print_top("Pairs", pairs, 15, 2, profile->dispatches);
+    _profile_print_top("Triples", triples, 15, 3, profile->dispatches);
+
+    printf("\n");
+
+    arrfree(pairs);
+    arrfree(triples);
+}
+
+#pragma endregion
 
 #define STACK_LIMIT 512
+#define VM_EVALUATE_BUDGET 100000
+#define JIT_HOT_THRESHOLD 1000 // Calls plus backward jumps before a function is compiled
+
+// Set while evaluating at compile time, VM_Exception jumps here instead of exiting
+jmp_buf* _vm_trap = NULL;
+
+// Lets generic opcodes rewrite themselves to quickened ones. Compile time evaluation never quickens,
+// so the compiler only ever sees generic bytecode.
+bool _quicken_enabled = true;
 
-RuntimeValue vm_exec(VM* vm, Program* global)
+// Hot functions are compiled to machine code by jit.c
+bool _jit_enabled = true;
+
+// Set by gc.c once enough has been allocated, the running code collects at its next safepoint
+bool _gc_pending = false;
+
+RuntimeValue vm_exec(VM* vm, Program* global, VMProfile* profile)
 {
     vm->global = global;
+    vm->profile = profile;
     
     FunctionObject* co = global->main_function;
     vm->fn = co;
@@ -528,35 +1094,150 @@ RuntimeValue vm_exec(VM* vm, Program* global)
     vm->sp = &vm->stack[0];
     vm->bp = &vm->stack[0];
     vm->csp = vm->callstack;
+    vm->budget = 0;
+    vm->quicken = _quicken_enabled;
+    vm->jit = _jit_enabled && profile == NULL; // Profiles count bytecode, so everything stays interpreted
+    vm->gc = true;
+
+    gc_tenure(global);
+
+    int64 t1 = timestamp();
+
+    RuntimeValue result;
 
-    return vm_interp(vm, global);
+    // Only an ahead of time build has main as machine code before it runs
+    if(co->jit_code != NULL) {
+        vm->sp = co->jit_code(vm, vm->bp, vm->sp);
+        result = *(--vm->sp);
+    }
+    else {
+        result = vm_interp(vm, global);
+    }
+
+    int64 t2 = timestamp();
+    printf("Execution time: %d ms\n", t2/1000-t1/1000);
+
+    return result;
 }
 
-RuntimeValue vm_interp(register VM* vm, Program* global)
+// Runs fn, which takes no arguments, on a scratch VM. Fails if fn raises an error, runs out of budget
+// or does not leave exactly one value.
+bool vm_evaluate(Program* global, FunctionObject* fn, RuntimeValue* result)
 {
-    int64 t1 = timestamp();
+    static uint8_t halt[] = { OP_HALT };
+
+    VM vm;
+    vm.global = global;
+    vm.fn = fn;
+    vm.ip = &fn->code[0];
+    vm.sp = &vm.stack[0];
+    vm.bp = &vm.stack[0];
+    vm.budget = VM_EVALUATE_BUDGET;
+    vm.profile = NULL;
+    vm.quicken = false;
+    vm.jit = false;
+    vm.gc = false;
+
+    // Returning from fn lands on a halt
+    vm.callstack[0] = (Frame){ .ra = halt, .bp = vm.bp, .fn = fn };
+    vm.csp = &vm.callstack[1];
+
+    jmp_buf trap;
+    jmp_buf* outer = _vm_trap;
+    _vm_trap = &trap;
+
+    if(setjmp(trap) != 0) {
+        _vm_trap = outer;
+        return false;
+    }
+
+    RuntimeValue value = vm_interp(&vm, global);
+    _vm_trap = outer;
+
+    if(vm.sp != &vm.stack[0]) {
+        return false;
+    }
+
+    *result = value;
+    return true;
+}
 
+RuntimeValue vm_interp(register VM* vm, Program* global)
+{
     register uint8_t* ip = vm->ip;
     register RuntimeValue* sp = vm->sp;
 
     #define POP() (*(--sp))
     #define READ_BYTE() (*ip++)
+    #define READ_SHORT() (ip += 2, (uint16_t)(ip[-2] | (ip[-1] << 8)))
+    #define READ_OFFSET() ((int16_t)READ_SHORT())
+    #define READ_WIDE_OFFSET(low) ((int32_t)((low) | ((uint32_t)READ_SHORT() << 16))) // low is the half OP_WIDE has read
     #define PEEK() (*(sp - 1))
     #define PUSH(value) (*sp++ = value)
-    #define READ_ADDRESS(out) (*(uint64_t*)memcpy(&out, ip, sizeof(uint64_t))); ip += 8
 
-    static void* dispatch_table[] = {
-    &&DO_OP_HALT, &&DO_OP_CONST, &&DO_OP_ADD, &&DO_OP_SUB,
-    &&DO_OP_MUL, &&DO_OP_DIV, &&DO_OP_CMP, &&DO_OP_JMP_IF_FALSE, &&DO_OP_JMP, &&DO_OP_POP, &&DO_OP_GET_GLOBAL,
-    &&DO_OP_SET_GLOBAL, &&DO_OP_GET_LOCAL, &&DO_OP_SET_LOCAL, &&DO_OP_SCOPE_EXIT, &&DO_OP_CALL, &&DO_OP_RETURN, &&DO_OP_GET_MEMBER};
+    // Every live value is on the stack here, so a pending collection can run
+    #define SAFEPOINT()                                  \
+    do {                                                 \
+        if(_gc_pending){                                 \
+            vm->sp = sp;                                 \
+            gc_safepoint(vm, sp);                        \
+        }                                                \
+    } while (false)                                      \
+
+    static void* dispatch_table[OP_COUNT] = {
+    [OP_HALT] = &&DO_OP_HALT, [OP_CONST] = &&DO_OP_CONST, [OP_ADD] = &&DO_OP_ADD, [OP_SUB] = &&DO_OP_SUB,
+    [OP_MUL] = &&DO_OP_MUL, [OP_DIV] = &&DO_OP_DIV,
+    [OP_LT] = &&DO_OP_LT, [OP_GT] = &&DO_OP_GT, [OP_LE] = &&DO_OP_LE, [OP_GE] = &&DO_OP_GE, [OP_EQ] = &&DO_OP_EQ, [OP_NE] = &&DO_OP_NE,
+    [OP_JMP_IF_FALSE] = &&DO_OP_JMP_IF_FALSE, [OP_JMP] = &&DO_OP_JMP, [OP_POP] = &&DO_OP_POP,
+    [OP_GET_GLOBAL] = &&DO_OP_GET_GLOBAL, [OP_SET_GLOBAL] = &&DO_OP_SET_GLOBAL, [OP_GET_LOCAL] = &&DO_OP_GET_LOCAL, [OP_SET_LOCAL] = &&DO_OP_SET_LOCAL,
+    [OP_SCOPE_EXIT] = &&DO_OP_SCOPE_EXIT, [OP_CALL] = &&DO_OP_CALL, [OP_RETURN] = &&DO_OP_RETURN, [OP_GET_MEMBER] = &&DO_OP_GET_MEMBER,
+    [OP_WIDE] = &&DO_OP_WIDE,
+    [OP_INC_LOCAL] = &&DO_OP_INC_LOCAL, [OP_INC_GLOBAL] = &&DO_OP_INC_GLOBAL, [OP_ADD_LOCAL_CONST] = &&DO_OP_ADD_LOCAL_CONST,
+    [OP_LOAD_LOCAL2] = &&DO_OP_LOAD_LOCAL2, [OP_CONST_SET_LOCAL] = &&DO_OP_CONST_SET_LOCAL, [OP_STORE_LOCAL] = &&DO_OP_STORE_LOCAL,
+    [OP_STORE_GLOBAL] = &&DO_OP_STORE_GLOBAL,
+    [OP_JMP_IF_NOT_LT] = &&DO_OP_JMP_IF_NOT_LT, [OP_JMP_IF_NOT_GT] = &&DO_OP_JMP_IF_NOT_GT, [OP_JMP_IF_NOT_LE] = &&DO_OP_JMP_IF_NOT_LE,
+    [OP_JMP_IF_NOT_GE] = &&DO_OP_JMP_IF_NOT_GE, [OP_JMP_IF_NOT_EQ] = &&DO_OP_JMP_IF_NOT_EQ, [OP_JMP_IF_NOT_NE] = &&DO_OP_JMP_IF_NOT_NE,
+    [OP_ADD_NUM] = &&DO_OP_ADD_NUM, [OP_ADD_STR] = &&DO_OP_ADD_STR,
+    [OP_LT_NUM] = &&DO_OP_LT_NUM, [OP_GT_NUM] = &&DO_OP_GT_NUM, [OP_LE_NUM] = &&DO_OP_LE_NUM,
+    [OP_GE_NUM] = &&DO_OP_GE_NUM, [OP_EQ_NUM] = &&DO_OP_EQ_NUM, [OP_NE_NUM] = &&DO_OP_NE_NUM,
+    [OP_JMP_IF_NOT_LT_NUM] = &&DO_OP_JMP_IF_NOT_LT_NUM, [OP_JMP_IF_NOT_GT_NUM] = &&DO_OP_JMP_IF_NOT_GT_NUM,
+    [OP_JMP_IF_NOT_LE_NUM] = &&DO_OP_JMP_IF_NOT_LE_NUM, [OP_JMP_IF_NOT_GE_NUM] = &&DO_OP_JMP_IF_NOT_GE_NUM,
+    [OP_JMP_IF_NOT_EQ_NUM] = &&DO_OP_JMP_IF_NOT_EQ_NUM, [OP_JMP_IF_NOT_NE_NUM] = &&DO_OP_JMP_IF_NOT_NE_NUM,
+    [OP_INC_LOCAL_NUM] = &&DO_OP_INC_LOCAL_NUM, [OP_INC_GLOBAL_NUM] = &&DO_OP_INC_GLOBAL_NUM,
+    [OP_ADD_LOCAL_CONST_NUM] = &&DO_OP_ADD_LOCAL_CONST_NUM};
+
+    // Entered after OP_WIDE has read a 16 bit operand. Only opcodes with an index operand and generic jumps
+    // are valid here. Wide jumps read the upper half of their offset themselves and are never quickened.
+    static void* wide_dispatch_table[OP_COUNT] = {
+    [0 ... OP_COUNT - 1] = &&DO_OP_ILLEGAL,
+    [OP_CONST] = &&WIDE_OP_CONST, [OP_GET_GLOBAL] = &&WIDE_OP_GET_GLOBAL, [OP_SET_GLOBAL] = &&WIDE_OP_SET_GLOBAL,
+    [OP_GET_LOCAL] = &&WIDE_OP_GET_LOCAL, [OP_SET_LOCAL] = &&WIDE_OP_SET_LOCAL, [OP_SCOPE_EXIT] = &&WIDE_OP_SCOPE_EXIT,
+    [OP_CALL] = &&WIDE_OP_CALL, [OP_RETURN] = &&WIDE_OP_RETURN, [OP_GET_MEMBER] = &&WIDE_OP_GET_MEMBER,
+    [OP_JMP] = &&WIDE_OP_JMP, [OP_JMP_IF_FALSE] = &&WIDE_OP_JMP_IF_FALSE,
+    [OP_JMP_IF_NOT_LT] = &&WIDE_OP_JMP_IF_NOT_LT, [OP_JMP_IF_NOT_GT] = &&WIDE_OP_JMP_IF_NOT_GT, [OP_JMP_IF_NOT_LE] = &&WIDE_OP_JMP_IF_NOT_LE,
+    [OP_JMP_IF_NOT_GE] = &&WIDE_OP_JMP_IF_NOT_GE, [OP_JMP_IF_NOT_EQ] = &&WIDE_OP_JMP_IF_NOT_EQ, [OP_JMP_IF_NOT_NE] = &&WIDE_OP_JMP_IF_NOT_NE};
+
+    // Profiling sends every opcode through DO_PROFILE first, so the normal path has no extra work
+    void* profile_table[OP_COUNT];
+    void** dispatch = dispatch_table;
+
+    if(vm->profile != NULL){
+        for (size_t i = 0; i < OP_COUNT; i++) {
+            profile_table[i] = &&DO_PROFILE;
+        }
+
+        dispatch = profile_table;
+    }
 
     uint8_t opcode;
+    uint16_t operand = 0; // Set by OP_WIDE or the handler before any WIDE_ label reads it
+    int32_t jump; // Offset of the running jump
 
     #define DISPATCH()                                   \
     do {                                                 \
         /* Introspect stack for debugging */             \
          /*VM_DumpStack(vm, opcode);*/                   \
-        goto *dispatch_table[opcode = READ_BYTE()]; \
+        goto *dispatch[opcode = READ_BYTE()];            \
     } while (false)                                      \
 
     #define BINARY_OP(operation)                         \
@@ -569,21 +1250,55 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
 
     DISPATCH();
 
+    DO_PROFILE: {
+        VM_ProfileRecord(vm->profile, opcode);
+        goto *dispatch_table[opcode];
+    }
+
     DO_OP_HALT: {
-        int64 t2 = timestamp();
-        printf("Execution time: %d ms\n", t2/1000-t1/1000);
-        return POP();
+        RuntimeValue result = POP();
+        vm->sp = sp;
+
+        return result;
+    }
+
+    DO_OP_WIDE: {
+        opcode = READ_BYTE();
+        operand = READ_SHORT();
+        goto *wide_dispatch_table[opcode];
     }
 
-    DO_OP_CONST: {
-        uint64_t constIndex = READ_ADDRESS(constIndex);
-        RuntimeValue constant = vm->fn->constants[constIndex];
+    DO_OP_ILLEGAL: {
+        VM_Exception("Illegal instruction.");
+    }
+
+    DO_OP_CONST:
+        operand = READ_BYTE();
+    WIDE_OP_CONST: {
+        RuntimeValue constant = vm->fn->constants[operand];
         PUSH(constant);
 
         DISPATCH();
     }
 
+    // Rewrites the opcode of the running instruction, ip is always just past it when this is used
+    #define QUICKEN(opcode) (ip[-1] = (opcode))
+
     DO_OP_ADD: {
+        RuntimeValue op2 = PEEK();
+        RuntimeValue op1 = *(sp - 2);
+
+        if(vm->quicken){
+            if(IS_NUMBER(op1) && IS_NUMBER(op2)){
+                QUICKEN(OP_ADD_NUM);
+            }
+            else if(IS_STRING(op1) && IS_STRING(op2)){
+                QUICKEN(OP_ADD_STR);
+            }
+        }
+    }
+    // Deoptimized instructions land here, they stay generic until they run again
+    ADD_GENERIC: {
         RuntimeValue op2 = POP();
         RuntimeValue op1 = POP();
 
@@ -596,19 +1311,40 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
 
             DISPATCH();
         }
-        else if(IS_OBJ(op1) && AS_C_OBJ(op1)->objectType == ObjectType_String
-             && IS_OBJ(op2) && AS_C_OBJ(op2)->objectType == ObjectType_String)
-        { 
-            StringObject str1 = AS_STRING(op1);
-            StringObject str2 = AS_STRING(op2);
-            RuntimeValue value = Alloc_String_Combine(&str1, &str2);
 
-            PUSH(value);
+        PUSH(VM_Add(op1, op2));
 
-            DISPATCH();
+        DISPATCH();
+    }
+
+    DO_OP_ADD_NUM: {
+        RuntimeValue op2 = PEEK();
+        RuntimeValue op1 = *(sp - 2);
+
+        if(!(IS_NUMBER(op1) && IS_NUMBER(op2))){
+            QUICKEN(OP_ADD);
+            goto ADD_GENERIC;
+        }
+
+        sp--;
+        *(sp - 1) = NUMBER_VAL(AS_C_DOUBLE(op1) + AS_C_DOUBLE(op2));
+
+        DISPATCH();
+    }
+
+    DO_OP_ADD_STR: {
+        RuntimeValue op2 = PEEK();
+        RuntimeValue op1 = *(sp - 2);
+
+        if(!(IS_STRING(op1) && IS_STRING(op2))){
+            QUICKEN(OP_ADD);
+            goto ADD_GENERIC;
         }
 
-        VM_Exception("Illegal add operation.");
+        sp--;
+        *(sp - 1) = Alloc_String_Combine(op1, op2);
+
+        DISPATCH();
     }
 
     DO_OP_SUB: {
@@ -626,110 +1362,157 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         DISPATCH();
     }
 
-    DO_OP_CMP: {
-        uint8_t cmp_type = READ_BYTE();
+    // Numbers are compared inline, everything else goes through VM_Compare
+    #define COMPARE(operation, opcode) (IS_NUMBER(op1) && IS_NUMBER(op2) ? AS_C_DOUBLE(op1) operation AS_C_DOUBLE(op2) : VM_Compare(opcode, op1, op2))
 
-        RuntimeValue op2 = POP();
-        RuntimeValue op1 = POP();
-        bool res;
-
-        if(IS_NUMBER(op2) && IS_NUMBER(op1))
-        {
-            switch (cmp_type)
-            {
-                case OP_CMP_GT:
-                    res = AS_C_DOUBLE(op1) > AS_C_DOUBLE(op2);
-                    break;
-                case OP_CMP_LT:
-                    res = AS_C_DOUBLE(op1) < AS_C_DOUBLE(op2);
-                    break;
-                case OP_CMP_EQ:
-                    res = AS_C_DOUBLE(op1) == AS_C_DOUBLE(op2);
-                    break;
-                case OP_CMP_GE:
-                    res = AS_C_DOUBLE(op1) >= AS_C_DOUBLE(op2);
-                    break;
-                case OP_CMP_LE:
-                    res = AS_C_DOUBLE(op1) <= AS_C_DOUBLE(op2);
-                    break;
-                case OP_CMP_NE:
-                    res = AS_C_DOUBLE(op1) != AS_C_DOUBLE(op2);
-                    break;
-                default:
-                    VM_Exception("Illegal comparison.");
-            }  
-        }
-        else if(IS_BOOL(op2) && IS_BOOL(op1))
-        {
-            switch (cmp_type)
-            {
-                case OP_CMP_EQ:
-                    res = AS_C_BOOL(op1) == AS_C_BOOL(op2);
-                    break;
-                case OP_CMP_NE:
-                    res = AS_C_BOOL(op1) != AS_C_BOOL(op2);
-                    break;
-                default:
-                    VM_Exception("Illegal comparison.");
-            }  
-        }
-        else if(IS_OBJ(op1) && AS_C_OBJ(op1)->objectType == ObjectType_String
-             && IS_OBJ(op2) && AS_C_OBJ(op2)->objectType == ObjectType_String)
-        {
-            StringObject str1 = AS_STRING(op1);
-            StringObject str2 = AS_STRING(op2);
+    #define COMPARE_OP(operation, opcode)                \
+    do {                                                 \
+        RuntimeValue op2 = POP();                        \
+        RuntimeValue op1 = POP();                        \
+        PUSH(BOOL_VAL(COMPARE(operation, opcode)));      \
+    } while (false)                                      \
 
-            switch (cmp_type)
-            {
-                case OP_CMP_EQ:
-                    res = strcmp(str1.string, str2.string) == 0;
-                    break;
-                case OP_CMP_NE:
-                    res = strcmp(str1.string, str2.string) != 0;
-                    break;
-                default:
-                    VM_Exception("Illegal comparison.");
-            }  
-        }
-        else if(IS_NULL(op2) || IS_NULL(op1))
-        {
-            switch (cmp_type)
-            {
-                case OP_CMP_EQ:
-                    res = IS_NULL(op2) && IS_NULL(op1);
-                    break;
-                case OP_CMP_NE:
-                    res = !IS_NULL(op2) || !IS_NULL(op1);
-                    break;
-                default:
-                    VM_Exception("Illegal comparison.");
-            }  
-        }
-        else 
-        {
-            VM_Exception("Illegal comparison.");
-        }
+    #define COMPARE_JUMP(operation, opcode, read)        \
+    do {                                                 \
+        RuntimeValue op2 = POP();                        \
+        RuntimeValue op1 = POP();                        \
+        int32_t offset = read;                           \
+        if(!COMPARE(operation, opcode)){                 \
+            ip += offset;                                \
+        }                                                \
+    } while (false)                                      \
 
-        RuntimeValue runtime_result = BOOL_VAL(res);
-        PUSH(runtime_result);
+    // Generic compares quicken to the number variant when both operands are numbers
+    #define COMPARE_QUICKEN(quickened)                           \
+    do {                                                         \
+        if(vm->quicken && IS_NUMBER(PEEK()) && IS_NUMBER(*(sp - 2))){ \
+            QUICKEN(quickened);                                  \
+        }                                                        \
+    } while (false)                                              \
+
+    // Guard of the number variants, falls back to the generic label
+    #define COMPARE_GUARD(generic, label)                        \
+    do {                                                         \
+        if(!(IS_NUMBER(PEEK()) && IS_NUMBER(*(sp - 2)))){       \
+            QUICKEN(generic);                                    \
+            goto label;                                          \
+        }                                                        \
+    } while (false)                                              \
+
+    #define COMPARE_NUM_OP(operation)                            \
+    do {                                                         \
+        double op2 = AS_C_DOUBLE(POP());                         \
+        *(sp - 1) = BOOL_VAL(AS_C_DOUBLE(*(sp - 1)) operation op2); \
+    } while (false)                                              \
+
+    #define COMPARE_NUM_JUMP(operation)                          \
+    do {                                                         \
+        double op2 = AS_C_DOUBLE(POP());                         \
+        double op1 = AS_C_DOUBLE(POP());                         \
+        int16_t offset = READ_OFFSET();                          \
+        if(!(op1 operation op2)){                                \
+            ip += offset;                                        \
+        }                                                        \
+    } while (false)                                              \
+
+    DO_OP_LT: COMPARE_QUICKEN(OP_LT_NUM); LT_GENERIC: { COMPARE_OP(<, OP_LT);  DISPATCH(); }
+    DO_OP_GT: COMPARE_QUICKEN(OP_GT_NUM); GT_GENERIC: { COMPARE_OP(>, OP_GT);  DISPATCH(); }
+    DO_OP_LE: COMPARE_QUICKEN(OP_LE_NUM); LE_GENERIC: { COMPARE_OP(<=, OP_LE); DISPATCH(); }
+    DO_OP_GE: COMPARE_QUICKEN(OP_GE_NUM); GE_GENERIC: { COMPARE_OP(>=, OP_GE); DISPATCH(); }
+    DO_OP_EQ: COMPARE_QUICKEN(OP_EQ_NUM); EQ_GENERIC: { COMPARE_OP(==, OP_EQ); DISPATCH(); }
+    DO_OP_NE: COMPARE_QUICKEN(OP_NE_NUM); NE_GENERIC: { COMPARE_OP(!=, OP_NE); DISPATCH(); }
+
+    DO_OP_LT_NUM: { COMPARE_GUARD(OP_LT, LT_GENERIC); COMPARE_NUM_OP(<);  DISPATCH(); }
+    DO_OP_GT_NUM: { COMPARE_GUARD(OP_GT, GT_GENERIC); COMPARE_NUM_OP(>);  DISPATCH(); }
+    DO_OP_LE_NUM: { COMPARE_GUARD(OP_LE, LE_GENERIC); COMPARE_NUM_OP(<=); DISPATCH(); }
+    DO_OP_GE_NUM: { COMPARE_GUARD(OP_GE, GE_GENERIC); COMPARE_NUM_OP(>=); DISPATCH(); }
+    DO_OP_EQ_NUM: { COMPARE_GUARD(OP_EQ, EQ_GENERIC); COMPARE_NUM_OP(==); DISPATCH(); }
+    DO_OP_NE_NUM: { COMPARE_GUARD(OP_NE, NE_GENERIC); COMPARE_NUM_OP(!=); DISPATCH(); }
+
+    DO_OP_JMP_IF_NOT_LT: COMPARE_QUICKEN(OP_JMP_IF_NOT_LT_NUM); JMP_IF_NOT_LT_GENERIC: { COMPARE_JUMP(<, OP_LT, READ_OFFSET());  DISPATCH(); }
+    DO_OP_JMP_IF_NOT_GT: COMPARE_QUICKEN(OP_JMP_IF_NOT_GT_NUM); JMP_IF_NOT_GT_GENERIC: { COMPARE_JUMP(>, OP_GT, READ_OFFSET());  DISPATCH(); }
+    DO_OP_JMP_IF_NOT_LE: COMPARE_QUICKEN(OP_JMP_IF_NOT_LE_NUM); JMP_IF_NOT_LE_GENERIC: { COMPARE_JUMP(<=, OP_LE, READ_OFFSET()); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_GE: COMPARE_QUICKEN(OP_JMP_IF_NOT_GE_NUM); JMP_IF_NOT_GE_GENERIC: { COMPARE_JUMP(>=, OP_GE, READ_OFFSET()); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_EQ: COMPARE_QUICKEN(OP_JMP_IF_NOT_EQ_NUM); JMP_IF_NOT_EQ_GENERIC: { COMPARE_JUMP(==, OP_EQ, READ_OFFSET()); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_NE: COMPARE_QUICKEN(OP_JMP_IF_NOT_NE_NUM); JMP_IF_NOT_NE_GENERIC: { COMPARE_JUMP(!=, OP_NE, READ_OFFSET()); DISPATCH(); }
+
+    WIDE_OP_JMP_IF_NOT_LT: { COMPARE_JUMP(<, OP_LT, READ_WIDE_OFFSET(operand));  DISPATCH(); }
+    WIDE_OP_JMP_IF_NOT_GT: { COMPARE_JUMP(>, OP_GT, READ_WIDE_OFFSET(operand));  DISPATCH(); }
+    WIDE_OP_JMP_IF_NOT_LE: { COMPARE_JUMP(<=, OP_LE, READ_WIDE_OFFSET(operand)); DISPATCH(); }
+    WIDE_OP_JMP_IF_NOT_GE: { COMPARE_JUMP(>=, OP_GE, READ_WIDE_OFFSET(operand)); DISPATCH(); }
+    WIDE_OP_JMP_IF_NOT_EQ: { COMPARE_JUMP(==, OP_EQ, READ_WIDE_OFFSET(operand)); DISPATCH(); }
+    WIDE_OP_JMP_IF_NOT_NE: { COMPARE_JUMP(!=, OP_NE, READ_WIDE_OFFSET(operand)); DISPATCH(); }
+
+    DO_OP_JMP_IF_NOT_LT_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_LT, JMP_IF_NOT_LT_GENERIC); COMPARE_NUM_JUMP(<);  DISPATCH(); }
+    DO_OP_JMP_IF_NOT_GT_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_GT, JMP_IF_NOT_GT_GENERIC); COMPARE_NUM_JUMP(>);  DISPATCH(); }
+    DO_OP_JMP_IF_NOT_LE_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_LE, JMP_IF_NOT_LE_GENERIC); COMPARE_NUM_JUMP(<=); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_GE_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_GE, JMP_IF_NOT_GE_GENERIC); COMPARE_NUM_JUMP(>=); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_EQ_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_EQ, JMP_IF_NOT_EQ_GENERIC); COMPARE_NUM_JUMP(==); DISPATCH(); }
+    DO_OP_JMP_IF_NOT_NE_NUM: { COMPARE_GUARD(OP_JMP_IF_NOT_NE, JMP_IF_NOT_NE_GENERIC); COMPARE_NUM_JUMP(!=); DISPATCH(); }
+
+    DO_OP_JMP_IF_FALSE:
+        jump = READ_OFFSET();
+        goto JMP_IF_FALSE;
+    WIDE_OP_JMP_IF_FALSE:
+        jump = READ_WIDE_OFFSET(operand);
+    JMP_IF_FALSE: {
+        bool condition = AS_C_BOOL(POP());
 
+        if(!condition){
+            ip += jump;
+        }
+    
         DISPATCH();
     }
 
-    DO_OP_JMP_IF_FALSE: {
-        bool condition = AS_C_BOOL(POP());
-        uint64_t address = READ_ADDRESS(address);
+    DO_OP_JMP:
+        jump = READ_OFFSET();
+        goto JMP;
+    WIDE_OP_JMP:
+        jump = READ_WIDE_OFFSET(operand);
+    JMP: {
+        int32_t offset = jump;
+
+        // Loops end in a backward jump
+        if(offset < 0 && vm->budget != 0 && --vm->budget == 0) {
+            VM_Exception("Evaluation budget exceeded.");
+        }
 
-        if(!condition){
-            ip = &vm->fn->code[address];
+        ip += offset;
+
+        if(offset < 0) {
+            SAFEPOINT();
         }
-    
+
+        // Hot loops get compiled, and the running frame continues in the machine code from the loop header.
+        // Both tiers share the stack, so the frame carries over as it is.
+        if(offset < 0 && vm->jit && vm->fn->jit_state != Jit_Failed) {
+            if(vm->fn->jit_state == Jit_Cold && ++vm->fn->hotness >= JIT_HOT_THRESHOLD) {
+                jit_compile(vm, vm->fn);
+            }
+
+            void* entry = vm->fn->jit_state == Jit_Compiled ? jit_loop_entry(vm->fn, ip - vm->fn->code) : NULL;
+
+            if(entry != NULL) {
+                sp = vm->fn->jit_osr(vm, vm->bp, sp, entry);
+                goto OSR_EXIT;
+            }
+        }
+
         DISPATCH();
     }
 
-    DO_OP_JMP: {
-        uint64_t address = READ_ADDRESS(address);
-        ip = &vm->fn->code[address];
+    // The machine code ran the frame to its end and left the result on top. Only main halts, everything
+    // else finishes the return.
+    OSR_EXIT: {
+        if(vm->fn == global->main_function) {
+            goto DO_OP_HALT;
+        }
+
+        vm->csp--;
+        ip = vm->csp->ra;
+        vm->bp = vm->csp->bp;
+        vm->fn = vm->csp->fn;
 
         DISPATCH();
     }
@@ -740,43 +1523,45 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         DISPATCH();
     }
 
-    DO_OP_GET_GLOBAL: {
-        int64 address = READ_ADDRESS(address);
-        RuntimeValue value = Global_Get(global, address).value;
+    DO_OP_GET_GLOBAL:
+        operand = READ_BYTE();
+    WIDE_OP_GET_GLOBAL: {
+        RuntimeValue value = Global_Get(global, operand).value;
         PUSH(value);
 
         DISPATCH();
     }
 
-    DO_OP_SET_GLOBAL: {
-        int64 index = READ_ADDRESS(index);
+    DO_OP_SET_GLOBAL:
+        operand = READ_BYTE();
+    WIDE_OP_SET_GLOBAL: {
         RuntimeValue value = PEEK();
-        Global_Set(global, index, &value);
+        Global_Set(global, operand, &value);
 
         DISPATCH();
     }
 
-    DO_OP_GET_LOCAL: {
-        uint64 address = READ_ADDRESS(address);
-        // if(address < 0 ){ 
-        //     VM_Exception("Invalid variable index.");
-        // }
-
-        PUSH(vm->bp[address]);
+    DO_OP_GET_LOCAL:
+        operand = READ_BYTE();
+    WIDE_OP_GET_LOCAL: {
+        PUSH(vm->bp[operand]);
 
         DISPATCH();
     }
 
-    DO_OP_SET_LOCAL: {
-        int64 index = READ_ADDRESS(index);
+    DO_OP_SET_LOCAL:
+        operand = READ_BYTE();
+    WIDE_OP_SET_LOCAL: {
         RuntimeValue value = PEEK();
-        vm->bp[index] = value;
+        vm->bp[operand] = value;
 
         DISPATCH();
     }
 
-    DO_OP_SCOPE_EXIT: {
-        uint64 count = READ_ADDRESS(count);
+    DO_OP_SCOPE_EXIT:
+        operand = READ_BYTE();
+    WIDE_OP_SCOPE_EXIT: {
+        uint64 count = operand;
 
         if(count > 0)
         {
@@ -792,8 +1577,12 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         DISPATCH();
     }
 
-    DO_OP_CALL: {
-        uint64_t arg_count = READ_ADDRESS(arg_count);
+    DO_OP_CALL:
+        operand = READ_BYTE();
+    WIDE_OP_CALL: {
+        SAFEPOINT();
+
+        uint64_t arg_count = operand;
         RuntimeValue fnValue = POP();
 
 
@@ -816,6 +1605,21 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         {
             FunctionObject* fn = (FunctionObject*)(AS_C_OBJ(fnValue));
 
+            // Only compile time evaluation runs with a budget, it also has to stay clear of the stack limits
+            if(vm->budget != 0 && (--vm->budget == 0 || vm->csp == &vm->callstack[STACK_LIMIT - 1] || sp > &vm->stack[STACK_LIMIT / 2])) {
+                VM_Exception("Evaluation budget exceeded.");
+            }
+
+            if(vm->jit && fn->jit_state == Jit_Cold && ++fn->hotness >= JIT_HOT_THRESHOLD) {
+                jit_compile(vm, fn);
+            }
+
+            // Compiled code works on the same stack and leaves the result on top, like OP_RETURN
+            if(vm->jit && fn->jit_code != NULL) {
+                sp = fn->jit_code(vm, sp - arg_count, sp);
+                DISPATCH();
+            }
+
             // Save execution context, restored on OP_RETURN
             Frame fr = {
                 .bp = vm->bp,
@@ -838,8 +1642,10 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         DISPATCH();
     }
 
-    DO_OP_RETURN: {
-        uint64 count = READ_ADDRESS(count);
+    DO_OP_RETURN:
+        operand = READ_BYTE();
+    WIDE_OP_RETURN: {
+        uint64 count = operand;
 
         if(count > 0)
         {
@@ -861,24 +1667,218 @@ RuntimeValue vm_interp(register VM* vm, Program* global)
         DISPATCH();
     }
 
-    DO_OP_GET_MEMBER: {
+    DO_OP_GET_MEMBER:
+        operand = READ_BYTE();
+    WIDE_OP_GET_MEMBER: {
         RuntimeValue instanceVal = POP();
         TypeInstanceObject instance = AS_TYPEINSTANCE(instanceVal);
-        int64 memberIndex = READ_ADDRESS(memberIndex);
 
-        RuntimeValue memberValue = Member_Get(&instance, memberIndex).value;
+        RuntimeValue memberValue = Member_Get(&instance, operand).value;
         PUSH(memberValue);
 
         DISPATCH();
     }
+
+    // The constant of these never changes, so the quickened variants only guard the variable
+    DO_OP_INC_LOCAL:
+        if(vm->quicken && IS_NUMBER(vm->bp[ip[0]]) && IS_NUMBER(vm->fn->constants[ip[1]])){
+            QUICKEN(OP_INC_LOCAL_NUM);
+        }
+    INC_LOCAL_GENERIC: {
+        RuntimeValue* local = &vm->bp[READ_BYTE()];
+        RuntimeValue constant = vm->fn->constants[READ_BYTE()];
+
+        if(IS_NUMBER(*local) && IS_NUMBER(constant)){
+            *local = NUMBER_VAL(AS_C_DOUBLE(*local) + AS_C_DOUBLE(constant));
+        }
+        else{
+            *local = VM_Add(*local, constant);
+        }
+
+        DISPATCH();
+    }
+
+    DO_OP_INC_LOCAL_NUM: {
+        RuntimeValue* local = &vm->bp[ip[0]];
+
+        if(!IS_NUMBER(*local)){
+            QUICKEN(OP_INC_LOCAL);
+            goto INC_LOCAL_GENERIC;
+        }
+
+        *local = NUMBER_VAL(AS_C_DOUBLE(*local) + AS_C_DOUBLE(vm->fn->constants[ip[1]]));
+        ip += 2;
+
+        DISPATCH();
+    }
+
+    DO_OP_INC_GLOBAL:
+        if(vm->quicken && IS_NUMBER(global->globals[ip[0]].value) && IS_NUMBER(vm->fn->constants[ip[1]])){
+            QUICKEN(OP_INC_GLOBAL_NUM);
+        }
+    INC_GLOBAL_GENERIC: {
+        RuntimeValue* value = &global->globals[READ_BYTE()].value;
+        RuntimeValue constant = vm->fn->constants[READ_BYTE()];
+
+        if(IS_NUMBER(*value) && IS_NUMBER(constant)){
+            *value = NUMBER_VAL(AS_C_DOUBLE(*value) + AS_C_DOUBLE(constant));
+        }
+        else{
+            *value = VM_Add(*value, constant);
+            GLOBAL_BARRIER(global, ip[-2]);
+        }
+
+        DISPATCH();
+    }
+
+    DO_OP_INC_GLOBAL_NUM: {
+        RuntimeValue* value = &global->globals[ip[0]].value;
+
+        if(!IS_NUMBER(*value)){
+            QUICKEN(OP_INC_GLOBAL);
+            goto INC_GLOBAL_GENERIC;
+        }
+
+        *value = NUMBER_VAL(AS_C_DOUBLE(*value) + AS_C_DOUBLE(vm->fn->constants[ip[1]]));
+        ip += 2;
+
+        DISPATCH();
+    }
+
+    DO_OP_ADD_LOCAL_CONST:
+        if(vm->quicken && IS_NUMBER(vm->bp[ip[0]]) && IS_NUMBER(vm->fn->constants[ip[1]])){
+            QUICKEN(OP_ADD_LOCAL_CONST_NUM);
+        }
+    ADD_LOCAL_CONST_GENERIC: {
+        RuntimeValue local = vm->bp[READ_BYTE()];
+        RuntimeValue constant = vm->fn->constants[READ_BYTE()];
+
+        if(IS_NUMBER(local) && IS_NUMBER(constant)){
+            PUSH(NUMBER_VAL(AS_C_DOUBLE(local) + AS_C_DOUBLE(constant)));
+        }
+        else{
+            PUSH(VM_Add(local, constant));
+        }
+
+        DISPATCH();
+    }
+
+    DO_OP_ADD_LOCAL_CONST_NUM: {
+        RuntimeValue local = vm->bp[ip[0]];
+
+        if(!IS_NUMBER(local)){
+            QUICKEN(OP_ADD_LOCAL_CONST);
+            goto ADD_LOCAL_CONST_GENERIC;
+        }
+
+        PUSH(NUMBER_VAL(AS_C_DOUBLE(local) + AS_C_DOUBLE(vm->fn->constants[ip[1]])));
+        ip += 2;
+
+        DISPATCH();
+    }
+
+    DO_OP_LOAD_LOCAL2: {
+        RuntimeValue first = vm->bp[READ_BYTE()];
+        RuntimeValue second = vm->bp[READ_BYTE()];
+        PUSH(first);
+        PUSH(second);
+
+        DISPATCH();
+    }
+
+    DO_OP_CONST_SET_LOCAL: {
+        RuntimeValue constant = vm->fn->constants[READ_BYTE()];
+        PUSH(constant);
+        vm->bp[READ_BYTE()] = constant;
+
+        DISPATCH();
+    }
+
+    DO_OP_STORE_LOCAL: {
+        vm->bp[READ_BYTE()] = POP();
+
+        DISPATCH();
+    }
+
+    DO_OP_STORE_GLOBAL: {
+        RuntimeValue value = POP();
+        Global_Set(global, READ_BYTE(), &value);
+
+        DISPATCH();
+    }
 }
 
 #pragma endregion
 
 #pragma region VIRTUAL_MACHINE_HELPER
 
+// Slow path of the compare opcodes. Numbers compare with every operator, booleans, strings and null only
+// with EQ and NE.
+bool VM_Compare(uint8_t opcode, RuntimeValue op1, RuntimeValue op2){
+    if(IS_NUMBER(op2) && IS_NUMBER(op1))
+    {
+        switch (opcode)
+        {
+            case OP_LT: return AS_C_DOUBLE(op1) < AS_C_DOUBLE(op2);
+            case OP_GT: return AS_C_DOUBLE(op1) > AS_C_DOUBLE(op2);
+            case OP_LE: return AS_C_DOUBLE(op1) <= AS_C_DOUBLE(op2);
+            case OP_GE: return AS_C_DOUBLE(op1) >= AS_C_DOUBLE(op2);
+            case OP_EQ: return AS_C_DOUBLE(op1) == AS_C_DOUBLE(op2);
+            case OP_NE: return AS_C_DOUBLE(op1) != AS_C_DOUBLE(op2);
+        }
+    }
+    else if(IS_BOOL(op2) && IS_BOOL(op1))
+    {
+        switch (opcode)
+        {
+            case OP_EQ: return AS_C_BOOL(op1) == AS_C_BOOL(op2);
+            case OP_NE: return AS_C_BOOL(op1) != AS_C_BOOL(op2);
+        }
+    }
+    else if(IS_STRING(op1) && IS_STRING(op2))
+    {
+        // A short string only equals the same value, it never equals a heap string
+        bool equal = IS_OBJ(op1) && IS_OBJ(op2) ? String_Equals(&AS_STRING(op1), &AS_STRING(op2)) : op1 == op2;
+
+        switch (opcode)
+        {
+            case OP_EQ: return equal;
+            case OP_NE: return !equal;
+        }
+    }
+    else if(IS_NULL(op2) || IS_NULL(op1))
+    {
+        switch (opcode)
+        {
+            case OP_EQ: return IS_NULL(op2) && IS_NULL(op1);
+            case OP_NE: return !IS_NULL(op2) || !IS_NULL(op1);
+        }
+    }
+
+    VM_Exception("Illegal comparison.");
+    return false;
+}
+
+// Slow path of OP_ADD, numbers and string concatenation
+RuntimeValue VM_Add(RuntimeValue op1, RuntimeValue op2){
+    if(IS_NUMBER(op1) && IS_NUMBER(op2)){
+        return NUMBER_VAL(AS_C_DOUBLE(op1) + AS_C_DOUBLE(op2));
+    }
+
+    if(IS_STRING(op1) && IS_STRING(op2)){
+        return Alloc_String_Combine(op1, op2);
+    }
+
+    VM_Exception("Illegal add operation.");
+    return NULL_VAL;
+}
+
 
 void VM_Exception(char* msg){
+    if(_vm_trap != NULL) {
+        longjmp(*_vm_trap, 1);
+    }
+
     printf("\033[0;31mVM: %s \033[0m\n", msg);
     exit(0);
 }
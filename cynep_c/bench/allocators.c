@@ -0,0 +1,115 @@
+// Everything main.c builds, its main is renamed out of the way like in the AOT generated code
+#define main cynep_main
+#include "../main.c"
+#undef main
+
+// Slab allocator against glibc malloc, run from the cynep_c directory. The scripts are timed with the
+// nursery, where only survivors and the compiler's objects reach the allocator, and without it, where
+// every string and instance does. The churn test calls the allocators directly with object sized blocks.
+
+#define RUNS 5
+#define CHURN_LIVE 4096
+#define CHURN_OPERATIONS 20000000
+
+// Microseconds spent in vm_exec
+int64 run(char* path){
+    TextFile* file = map_entire_file(path);
+    TokenStream* tokens = lexer_tokenize(file);
+    Ast* program = Build_SyntaxTree(tokens, file);
+    ast_fold(program);
+
+    Program* global = make_program();
+    program_add_global(global, "VERSION", NUMBER_VAL(0.1));
+    program_add_native_function(global, "multiply", &Multiply, 2, true);
+    program_add_native_function(global, "alloc", &Alloc, 1, false);
+    compile(program, global);
+
+    VM vm;
+    int64 begin = timestamp();
+    vm_exec(&vm, global, NULL);
+    int64 time = timestamp() - begin;
+
+    // Every run starts from an empty heap, and blocks go back to the allocator they came from
+    gc_free_all();
+
+    return time;
+}
+
+// Keeps CHURN_LIVE blocks alive and replaces a pseudo random one at a time, sizes like strings and instances
+int64 churn(){
+    static void* blocks[CHURN_LIVE];
+    static size_t sizes[CHURN_LIVE];
+    uint64 state = 88172645463325252ULL;
+
+    int64 begin = timestamp();
+
+    for (size_t i = 0; i < CHURN_LIVE; i++) {
+        sizes[i] = 24 + (i % 8) * 8;
+        blocks[i] = slab_alloc(sizes[i]);
+    }
+
+    for (size_t i = 0; i < CHURN_OPERATIONS; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        size_t slot = state % CHURN_LIVE;
+        slab_free(blocks[slot], sizes[slot]);
+
+        sizes[slot] = 24 + (state >> 32) % 72;
+        blocks[slot] = slab_alloc(sizes[slot]);
+    }
+
+    for (size_t i = 0; i < CHURN_LIVE; i++) {
+        slab_free(blocks[i], sizes[i]);
+    }
+
+    return timestamp() - begin;
+}
+
+int main(int argc, char**argv)
+{
+    char* scripts[] = { "build/input.cynep", "build/alloc.cynep" };
+    size_t count = sizeof(scripts) / sizeof(scripts[0]);
+
+    // Best of RUNS in microseconds, [script][nursery][slab]
+    int64 times[sizeof(scripts) / sizeof(scripts[0])][2][2];
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t nursery = 0; nursery < 2; nursery++) {
+            for (size_t slab = 0; slab < 2; slab++) {
+                _gc_nursery_enabled = nursery;
+                _slab_enabled = slab;
+                times[i][nursery][slab] = INT64_MAX;
+
+                for (size_t r = 0; r < RUNS; r++) {
+                    int64 time = run(scripts[i]);
+                    times[i][nursery][slab] = time < times[i][nursery][slab] ? time : times[i][nursery][slab];
+                }
+            }
+        }
+    }
+
+    int64 churn_times[2];
+
+    for (size_t slab = 0; slab < 2; slab++) {
+        _slab_enabled = slab;
+        churn_times[slab] = churn();
+    }
+
+    printf("\n%-24s %-10s %-12s %-12s %-10s\n", "script", "nursery", "malloc ms", "slab ms", "speedup");
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t nursery = 0; nursery < 2; nursery++) {
+            double speedup = (double)times[i][nursery][0] / times[i][nursery][1];
+
+            printf("%-24s %-10s %-12.1f %-12.1f %-10.2f\n", scripts[i], nursery ? "on" : "off",
+                times[i][nursery][0] / 1000.0, times[i][nursery][1] / 1000.0, speedup);
+        }
+    }
+
+    printf("%-24s %-10s %-12.1f %-12.1f %-10.2f\n", "churn", "-",
+        churn_times[0] / 1000.0, churn_times[1] / 1000.0, (double)churn_times[0] / churn_times[1]);
+
+    return 0;
+}
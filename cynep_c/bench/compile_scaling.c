@@ -0,0 +1,77 @@
+// Everything main.c builds, its main is renamed out of the way like in the AOT generated code
+#define main cynep_main
+#include "../main.c"
+#undef main
+
+// Compile time as a function of the number of distinct identifiers.
+// Every generated script declares globals, and functions full of locals that read those globals
+// and a growing constant pool. With hashed lookups the time per identifier should stay flat.
+
+#define LOCALS_PER_FUNCTION 200
+
+TextFile* generate_source(size_t identifiers) {
+    size_t globals = identifiers / 2;
+    size_t locals = identifiers - globals;
+    size_t capacity = identifiers * 64 + 1024;
+
+    char* buffer = malloc(capacity);
+    size_t length = 0;
+
+    for (size_t i = 0; i < globals; i++) {
+        length += sprintf(&buffer[length], "var global%llu;\n", (uint64)i);
+    }
+
+    size_t functions = (locals + LOCALS_PER_FUNCTION - 1) / LOCALS_PER_FUNCTION;
+
+    for (size_t f = 0; f < functions; f++) {
+        length += sprintf(&buffer[length], "func function%llu(){\n", (uint64)f);
+
+        for (size_t l = 0; l < LOCALS_PER_FUNCTION; l++) {
+            uint64 n = f * LOCALS_PER_FUNCTION + l;
+            length += sprintf(&buffer[length], "    var local%llu = global%llu + %llu;\n", n, n % globals, n);
+        }
+
+        length += sprintf(&buffer[length], "    return 0;\n}\n");
+    }
+
+    length += sprintf(&buffer[length], "func main(){\n    return 0;\n}\n");
+
+    TextFile* file = malloc(sizeof(TextFile));
+    file->buffer = buffer;
+    file->length = length;
+    file->path = "generated";
+    file->mapped = false;
+
+    return file;
+}
+
+int main(int argc, char**argv)
+{
+    size_t sizes[] = { 2500, 5000, 10000, 20000, 40000, 80000 };
+    size_t count = sizeof(sizes) / sizeof(sizes[0]);
+
+    int64 results[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (size_t i = 0; i < count; i++) {
+        TextFile* file = generate_source(sizes[i]);
+
+        int64 begin = timestamp();
+
+        TokenStream* tokens = lexer_tokenize(file);
+        Ast* program = Build_SyntaxTree(tokens, file);
+        ast_fold(program);
+
+        Program* global = make_program();
+        compile(program, global);
+
+        results[i] = timestamp() - begin;
+    }
+
+    printf("\n%-14s %-14s %-14s\n", "identifiers", "total (ms)", "ns/identifier");
+
+    for (size_t i = 0; i < count; i++) {
+        printf("%-14llu %-14.1f %-14.1f\n", (uint64)sizes[i], results[i] / 1000.0, results[i] * 1000.0 / sizes[i]);
+    }
+
+    return 0;
+}
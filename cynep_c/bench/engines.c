@@ -0,0 +1,98 @@
+// Everything main.c builds, its main is renamed out of the way like in the AOT generated code
+#define main cynep_main
+#include "../main.c"
+#undef main
+
+// Stack engine against register engine on the sample scripts, run from the cynep_c directory.
+// Counts executed instructions and times each engine. The stack engine is measured as the plain
+// stack machine and with superinstructions, both without quickening and the JIT so only the
+// instruction sets are compared. Every run compiles afresh since scripts change globals.
+
+#define RUNS 5
+
+typedef enum Engine Engine;
+
+enum Engine {
+    Engine_Stack,
+    Engine_StackPeephole,
+    Engine_Register,
+    Engine_Count
+};
+
+static char* _engine_names[Engine_Count] = { "stack", "stack+peephole", "register" };
+
+Program* build(char* path, Engine engine){
+    TextFile* file = map_entire_file(path);
+    TokenStream* tokens = lexer_tokenize(file);
+    Ast* program = Build_SyntaxTree(tokens, file);
+    ast_fold(program);
+
+    Program* global = make_program();
+    program_add_global(global, "VERSION", NUMBER_VAL(0.1));
+    program_add_native_function(global, "multiply", &Multiply, 2, true);
+    program_add_native_function(global, "alloc", &Alloc, 1, false);
+
+    _peephole_enabled = engine != Engine_Stack;
+    _quicken_enabled = false;
+    _jit_enabled = false;
+    compile(program, global);
+
+    if(engine == Engine_Register){
+        register_compile(program, global);
+    }
+
+    return global;
+}
+
+// Executed instructions, or the best time in microseconds when timing
+int64 run(char* path, Engine engine, bool count){
+    Program* global = build(path, engine);
+    int64 begin = timestamp();
+    int64 result;
+
+    if(engine == Engine_Register){
+        RegisterVM vm;
+        register_exec(&vm, global, count);
+        result = vm.dispatches;
+    }
+    else{
+        VM vm;
+        vm_exec(&vm, global, count ? VM_ProfileCreate() : NULL);
+        result = count ? vm.profile->dispatches : 0;
+    }
+
+    return count ? result : timestamp() - begin;
+}
+
+int main(int argc, char**argv)
+{
+    char* scripts[] = { "build/stackoverflow.cynep", "build/input.cynep", "build/input3.cynep" };
+    size_t count = sizeof(scripts) / sizeof(scripts[0]);
+
+    int64 instructions[sizeof(scripts) / sizeof(scripts[0])][Engine_Count];
+    int64 times[sizeof(scripts) / sizeof(scripts[0])][Engine_Count];
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t e = 0; e < Engine_Count; e++) {
+            instructions[i][e] = run(scripts[i], e, true);
+            times[i][e] = INT64_MAX;
+
+            for (size_t r = 0; r < RUNS; r++) {
+                int64 time = run(scripts[i], e, false);
+                times[i][e] = time < times[i][e] ? time : times[i][e];
+            }
+        }
+    }
+
+    printf("\n%-28s %-16s %-14s %-12s %-10s\n", "script", "engine", "instructions", "vs stack", "ms");
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t e = 0; e < Engine_Count; e++) {
+            double ratio = instructions[i][e] * 100.0 / instructions[i][Engine_Stack];
+
+            printf("%-28s %-16s %-14llu %-12.1f %-10.1f\n", scripts[i], _engine_names[e], instructions[i][e], ratio, times[i][e] / 1000.0);
+        }
+    }
+
+    return 0;
+}
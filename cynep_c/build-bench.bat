@@ -0,0 +1,3 @@
+gcc -O3 bench/compile_scaling.c -o build/compile_scaling.exe
+gcc -O3 bench/engines.c -o build/engines.exe
+gcc -O3 bench/allocators.c -o build/allocators.exe
\ No newline at end of file
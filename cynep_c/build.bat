@@ -1 +1,3 @@
-gcc -g -O3 main.c -o build/main.exe
\ No newline at end of file
+set CYNEP_SOURCE=%~dp0
+set CYNEP_SOURCE=%CYNEP_SOURCE:\=/%
+gcc -g -O3 "-DCYNEP_SOURCE_DIR=\"%CYNEP_SOURCE%\"" main.c -o build/main.exe
\ No newline at end of file
@@ -1,12 +1,16 @@
 #pragma once
 
 typedef enum   NodeType NodeType;
+typedef uint32 NodeIndex;
+typedef struct Ast Ast;
+typedef struct NodeRange NodeRange;
 typedef struct AstNode AstNode;
 typedef struct BlockStatement BlockStatement;
 typedef struct Identifier Identifier;
 typedef struct NumericLiteral NumericLiteral;
 typedef struct StringLiteral StringLiteral;
 typedef struct VariableDeclaration VariableDeclaration;
+typedef struct VariableDeclaration ConstDeclaration;
 typedef struct PropertyDeclaration PropertyDeclaration;
 typedef struct TypeDeclaration TypeDeclaration;
 typedef struct CallExpression CallExpression;
@@ -14,12 +18,13 @@ typedef struct MemberExpression MemberExpression;
 typedef struct AssignmentExpression AssignmentExpression;
 typedef struct BinaryExpression BinaryExpression;
 typedef struct BinaryExpression ComparisonExpression;
-typedef struct Expression Expression;
 typedef struct IfStatement IfStatement;
 typedef struct WhileStatement WhileStatement;
 typedef struct FunctionDeclaration FunctionDeclaration;
 typedef struct ReturnStatement ReturnStatement;
 
+#define NODE_NONE UINT32_MAX // Missing optional child
+
 enum NodeType 
 {
     // Statements
@@ -27,6 +32,7 @@ enum NodeType
     AST_IfStatement,
     AST_WhileStatement,
     AST_VariableDeclaration,
+    AST_ConstDeclaration,
     AST_ReturnStatement,
     AST_TypeDefinition,
     AST_PropertyDeclaration,
@@ -45,409 +51,556 @@ enum NodeType
     AST_Identifier,
 };
 
+// Nodes are variable sized and packed into one buffer of 32 bit words, so a node is referenced by
+// the index of its first word. Lists of children (block bodies, parameters, arguments, properties)
+// are stored as contiguous ranges of node indices in a second buffer.
+
+struct AstNode {
+    NodeType type; // First word of every node
+};
+
+struct NodeRange {
+    uint32 first; // Index into Ast.extra
+    uint32 count;
+};
+
 struct BlockStatement {
-    List* body; // Statements
+    AstNode node;
+    NodeRange body; // Statements
 };
 
 struct IfStatement {
-    ComparisonExpression* test;
-    AstNode* consequent; // Statements
-    AstNode* alternate; // Statements
+    AstNode node;
+    NodeIndex test; // ComparisonExpression
+    NodeIndex consequent; // Statements
+    NodeIndex alternate; // Statements or NODE_NONE
 };
 
 struct WhileStatement {
-    ComparisonExpression* test;
-    AstNode* body;
+    AstNode node;
+    NodeIndex test; // ComparisonExpression
+    NodeIndex body;
 };
 
 struct FunctionDeclaration {
-    char* name;
-    List* args; // List of identifiers, TODO: Replace with arg struct containing type info?
-    BlockStatement* body;
+    AstNode node;
+    Symbol name;
+    NodeRange args; // Identifiers, TODO: Replace with arg struct containing type info?
+    NodeIndex body; // BlockStatement
 };
 
 struct ReturnStatement {
-    Expression* value;
+    AstNode node;
+    NodeIndex value;
 };
 
 struct Identifier {
-    char* name;
+    AstNode node;
+    Symbol name;
 };
 
 struct NumericLiteral {
-    int64 value;
+    AstNode node;
+    uint32 value[2]; // int64, split since nodes are only 4 byte aligned
 };
 
 struct StringLiteral {
-    char* value;
+    AstNode node;
+    Symbol value;
 };
 
 struct VariableDeclaration {
-    char* name;
-    Expression* value;
+    AstNode node;
+    Symbol name;
+    NodeIndex value; // NODE_NONE without initializer
 };
 
 struct PropertyDeclaration {
-    char* name;
+    AstNode node;
+    Symbol name;
 };
 
 struct TypeDeclaration {
-    char* name;
-    List* properties; // PropertyDeclarations
+    AstNode node;
+    Symbol name;
+    NodeRange properties; // PropertyDeclarations
 };
 
 struct CallExpression {
-    Expression* callee;
-    List* args;
+    AstNode node;
+    NodeIndex callee;
+    NodeRange args;
 };
 
 struct MemberExpression {
-    Expression* object;
-    Identifier* member;
+    AstNode node;
+    NodeIndex object;
+    NodeIndex member; // Identifier
 };
 
 struct AssignmentExpression {
-    Expression* assignee;
-    Expression* value;
+    AstNode node;
+    NodeIndex assignee;
+    NodeIndex value;
 };
 
 struct BinaryExpression {
-    char operator[2];
-    Expression* left;
-    Expression* right;
+    AstNode node;
+    OperatorKind operator;
+    NodeIndex left;
+    NodeIndex right;
 };
 
-struct AstNode {
-    union {
-        BlockStatement block_statement;
-        IfStatement ifStatement;
-        Identifier identifier;
-        NumericLiteral numeric_literal;
-        StringLiteral string_literal;
-        VariableDeclaration variable_declaration;
-        PropertyDeclaration property_declaration;
-        TypeDeclaration type_declaration;
-        CallExpression call_expression;
-        MemberExpression member_expression;
-        AssignmentExpression assignment_expression;
-        BinaryExpression binary_expression;
-        BinaryExpression comparison_expression;
-        WhileStatement while_statement;
-        FunctionDeclaration function_declaration;
-        ReturnStatement return_statement;
-    }; 
-    NodeType type;
+struct Ast {
+    uint32* nodes;
+    NodeIndex* extra; // Child ranges
+    NodeIndex* scratch; // Children of the lists currently being parsed
+    NodeIndex root;
 };
 
-struct Expression {
-    AstNode statement;
-};
+#define AST_GET(ast, index, T) ((T*)&(ast)->nodes[index])
+
+Ast* ast_create() {
+    Ast* ast = malloc(sizeof(Ast));
+    ast->nodes = NULL;
+    ast->extra = NULL;
+    ast->scratch = NULL;
+    ast->root = NODE_NONE;
+
+    return ast;
+}
+
+void ast_destroy(Ast* ast) {
+    arrfree(ast->nodes);
+    arrfree(ast->extra);
+    arrfree(ast->scratch);
+    free(ast);
+}
+
+size_t ast_memory_usage(Ast* ast) {
+    return array_length(ast->nodes) * sizeof(uint32) + array_length(ast->extra) * sizeof(NodeIndex);
+}
+
+static inline NodeType Ast_Type(Ast* ast, NodeIndex index) {
+    return AST_GET(ast, index, AstNode)->type;
+}
+
+static inline NodeIndex Ast_Child(Ast* ast, NodeRange range, size_t i) {
+    return ast->extra[range.first + i];
+}
+
+// Pointers into the buffer are only valid until the next node is added
+static void* Ast_Alloc(Ast* ast, NodeType type, size_t size) {
+    size_t index = array_length(ast->nodes);
+    arraddnptr(ast->nodes, size / sizeof(uint32));
+
+    AstNode* node = (AstNode*)&ast->nodes[index];
+    node->type = type;
+
+    return node;
+}
+
+static inline NodeIndex Ast_Last(Ast* ast, size_t size) {
+    return array_length(ast->nodes) - size / sizeof(uint32);
+}
+
+size_t Ast_NodeSize(NodeType type) {
+    switch (type) {
+        case AST_BlockStatement:        return sizeof(BlockStatement);
+        case AST_IfStatement:           return sizeof(IfStatement);
+        case AST_WhileStatement:        return sizeof(WhileStatement);
+        case AST_VariableDeclaration:   return sizeof(VariableDeclaration);
+        case AST_ConstDeclaration:      return sizeof(ConstDeclaration);
+        case AST_ReturnStatement:       return sizeof(ReturnStatement);
+        case AST_TypeDefinition:        return sizeof(TypeDeclaration);
+        case AST_PropertyDeclaration:   return sizeof(PropertyDeclaration);
+        case AST_FunctionDeclaration:   return sizeof(FunctionDeclaration);
+        case AST_AssignmentExpression:  return sizeof(AssignmentExpression);
+        case AST_BinaryExpression:      return sizeof(BinaryExpression);
+        case AST_ComparisonExpression:  return sizeof(BinaryExpression);
+        case AST_MemberExpression:      return sizeof(MemberExpression);
+        case AST_CallExpression:        return sizeof(CallExpression);
+        case AST_NumericLiteral:        return sizeof(NumericLiteral);
+        case AST_StringLiteral:         return sizeof(StringLiteral);
+        case AST_Identifier:            return sizeof(Identifier);
+    }
+
+    return sizeof(AstNode);
+}
 
 //
-// Initializers
+// Child ranges
 //
 
-BlockStatement* Create_BlockStatement(AstNode* node, List* body) {
-    node->type = AST_BlockStatement;
-    node->block_statement.body = list_create(body);
+// Children are pushed to the scratch stack while a list is parsed, then moved to extra in one piece.
+// Nested lists just push on top, so every list ends up contiguous.
+
+static inline size_t Ast_RangeBegin(Ast* ast) {
+    return array_length(ast->scratch);
+}
 
-    return (BlockStatement*)node;
+static inline void Ast_RangePush(Ast* ast, NodeIndex child) {
+    array_push(ast->scratch, child);
 }
 
-ReturnStatement* Create_ReturnStatement(AstNode* node, Expression* value) {
-    node->type = AST_ReturnStatement;
-    node->return_statement.value = value;
+NodeRange Ast_RangeEnd(Ast* ast, size_t begin) {
+    NodeRange range;
+    range.first = array_length(ast->extra);
+    range.count = array_length(ast->scratch) - begin;
+
+    if(range.count > 0) {
+        memcpy(arraddnptr(ast->extra, range.count), &ast->scratch[begin], range.count * sizeof(NodeIndex));
+        array_popn(ast->scratch, range.count);
+    }
 
-    return (ReturnStatement*)node;
+    return range;
 }
 
-FunctionDeclaration* Create_FunctionDeclaration(AstNode* memory, char* name, List* args, BlockStatement* block) {
-    memory->type = AST_FunctionDeclaration;
-    memory->function_declaration.args = args;
-    memory->function_declaration.body = block;
-    memory->function_declaration.name = name;
+//
+// Initializers
+//
+
+NodeIndex Create_BlockStatement(Ast* ast, NodeRange body) {
+    BlockStatement* node = Ast_Alloc(ast, AST_BlockStatement, sizeof(BlockStatement));
+    node->body = body;
 
-    return (FunctionDeclaration*)memory;
+    return Ast_Last(ast, sizeof(BlockStatement));
 }
 
-VariableDeclaration* Create_VariableDeclaration(AstNode* memory, char* name, Expression* value) {
-    memory->type = AST_VariableDeclaration;
-    memory->variable_declaration.value = value;
+NodeIndex Create_ReturnStatement(Ast* ast, NodeIndex value) {
+    ReturnStatement* node = Ast_Alloc(ast, AST_ReturnStatement, sizeof(ReturnStatement));
+    node->value = value;
 
-    memory->variable_declaration.name = name;
+    return Ast_Last(ast, sizeof(ReturnStatement));
+}
+
+NodeIndex Create_FunctionDeclaration(Ast* ast, Symbol name, NodeRange args, NodeIndex block) {
+    FunctionDeclaration* node = Ast_Alloc(ast, AST_FunctionDeclaration, sizeof(FunctionDeclaration));
+    node->args = args;
+    node->body = block;
+    node->name = name;
 
-    return (VariableDeclaration*)memory;
+    return Ast_Last(ast, sizeof(FunctionDeclaration));
 }
 
-TypeDeclaration* Create_TypeDeclaration(AstNode* memory, List* member_list_memory, char* name) {
-    memory->type = AST_TypeDefinition;
-    memory->type_declaration.properties = list_create(member_list_memory);
+NodeIndex Create_VariableDeclaration(Ast* ast, Symbol name, NodeIndex value) {
+    VariableDeclaration* node = Ast_Alloc(ast, AST_VariableDeclaration, sizeof(VariableDeclaration));
+    node->value = value;
+    node->name = name;
+
+    return Ast_Last(ast, sizeof(VariableDeclaration));
+}
 
-    memory->type_declaration.name = name;
+// Value is evaluated by the compiler, every use compiles to a constant
+NodeIndex Create_ConstDeclaration(Ast* ast, Symbol name, NodeIndex value) {
+    ConstDeclaration* node = Ast_Alloc(ast, AST_ConstDeclaration, sizeof(ConstDeclaration));
+    node->value = value;
+    node->name = name;
 
-    return (TypeDeclaration*)memory;
+    return Ast_Last(ast, sizeof(ConstDeclaration));
 }
 
-PropertyDeclaration* Create_PropertyDeclaration(AstNode* memory, char* name) {
-    memory->type = AST_PropertyDeclaration;
+NodeIndex Create_TypeDeclaration(Ast* ast, Symbol name, NodeRange properties) {
+    TypeDeclaration* node = Ast_Alloc(ast, AST_TypeDefinition, sizeof(TypeDeclaration));
+    node->properties = properties;
+    node->name = name;
 
-    memory->property_declaration.name = name;
+    return Ast_Last(ast, sizeof(TypeDeclaration));
+}
+
+NodeIndex Create_PropertyDeclaration(Ast* ast, Symbol name) {
+    PropertyDeclaration* node = Ast_Alloc(ast, AST_PropertyDeclaration, sizeof(PropertyDeclaration));
+    node->name = name;
 
-    return (PropertyDeclaration*)memory;
+    return Ast_Last(ast, sizeof(PropertyDeclaration));
 }
 
-CallExpression* Create_CallExpression(AstNode* memory, Expression* callee, List* args) {
-    memory->type = AST_CallExpression;
-    memory->call_expression.callee = callee;
-    memory->call_expression.args = args;
+NodeIndex Create_CallExpression(Ast* ast, NodeIndex callee, NodeRange args) {
+    CallExpression* node = Ast_Alloc(ast, AST_CallExpression, sizeof(CallExpression));
+    node->callee = callee;
+    node->args = args;
 
-    return (CallExpression*)memory;
+    return Ast_Last(ast, sizeof(CallExpression));
 }
 
-MemberExpression* Create_MemberExpression(AstNode* memory, Expression* object, Identifier* member) {
-    memory->type = AST_MemberExpression;
-    memory->member_expression.object = object;
-    memory->member_expression.member = member;
+NodeIndex Create_MemberExpression(Ast* ast, NodeIndex object, NodeIndex member) {
+    MemberExpression* node = Ast_Alloc(ast, AST_MemberExpression, sizeof(MemberExpression));
+    node->object = object;
+    node->member = member;
 
-    return (MemberExpression*)memory;
+    return Ast_Last(ast, sizeof(MemberExpression));
 }
 
-AssignmentExpression* Create_AssignmentExpression(AstNode* memory, Expression* assignee, Expression* value) {
-    memory->type = AST_AssignmentExpression;
-    memory->assignment_expression.assignee = assignee;
-    memory->assignment_expression.value = value;
+NodeIndex Create_AssignmentExpression(Ast* ast, NodeIndex assignee, NodeIndex value) {
+    AssignmentExpression* node = Ast_Alloc(ast, AST_AssignmentExpression, sizeof(AssignmentExpression));
+    node->assignee = assignee;
+    node->value = value;
 
-    return (AssignmentExpression*)memory;
+    return Ast_Last(ast, sizeof(AssignmentExpression));
 }
 
-BinaryExpression* Create_BinaryExpression(AstNode* memory, Expression* left, char* operatr, Expression* right) {
-    memory->type = AST_BinaryExpression;
-    memory->binary_expression.left = left;
-    memory->binary_expression.right = right;
+// type is AST_BinaryExpression or AST_ComparisonExpression
+NodeIndex Create_BinaryExpression(Ast* ast, NodeType type, NodeIndex left, OperatorKind operatr, NodeIndex right) {
+    BinaryExpression* node = Ast_Alloc(ast, type, sizeof(BinaryExpression));
+    node->operator = operatr;
+    node->left = left;
+    node->right = right;
 
-    strcpy(memory->binary_expression.operator, operatr);
+    return Ast_Last(ast, sizeof(BinaryExpression));
+}
 
-    return (BinaryExpression*)memory;
+NodeIndex Create_IfStatement(Ast* ast, NodeIndex test, NodeIndex consequent, NodeIndex alternate) {
+    IfStatement* node = Ast_Alloc(ast, AST_IfStatement, sizeof(IfStatement));
+    node->test = test;
+    node->consequent = consequent;
+    node->alternate = alternate;
+
+    return Ast_Last(ast, sizeof(IfStatement));
 }
 
-ComparisonExpression* Create_ComparisonExpression(AstNode* memory, Expression* left, char* operatr, Expression* right) {
-    memory->type = AST_ComparisonExpression;
-    memory->comparison_expression.left = left;
-    memory->comparison_expression.right = right;
+NodeIndex Create_WhileStatement(Ast* ast, NodeIndex test, NodeIndex body) {
+    WhileStatement* node = Ast_Alloc(ast, AST_WhileStatement, sizeof(WhileStatement));
+    node->test = test;
+    node->body = body;
 
-    strcpy(memory->comparison_expression.operator, operatr);
+    return Ast_Last(ast, sizeof(WhileStatement));
+}
 
-    return (ComparisonExpression*)memory;
+NodeIndex Create_Identifier(Ast* ast, Symbol name) {
+    Identifier* node = Ast_Alloc(ast, AST_Identifier, sizeof(Identifier));
+    node->name = name;
+
+    return Ast_Last(ast, sizeof(Identifier));
 }
 
-IfStatement* Create_IfStatement(AstNode* memory, ComparisonExpression* test, AstNode* consequent, AstNode* alternate) {
-    memory->type = AST_IfStatement;
-    memory->ifStatement.test = test;
-    memory->ifStatement.consequent = consequent;
-    memory->ifStatement.alternate = alternate;
+NodeIndex Create_NumericLiteral(Ast* ast, int64 value) {
+    NumericLiteral* node = Ast_Alloc(ast, AST_NumericLiteral, sizeof(NumericLiteral));
+    memcpy(node->value, &value, sizeof(int64));
 
-    return (IfStatement*)memory;
+    return Ast_Last(ast, sizeof(NumericLiteral));
 }
 
-WhileStatement* Create_WhileStatement(AstNode* memory, ComparisonExpression* test, AstNode* body) {
-    memory->type = AST_WhileStatement;
-    memory->while_statement.test = test;
-    memory->while_statement.body = body;
+int64 NumericLiteral_Value(NumericLiteral* node) {
+    int64 value;
+    memcpy(&value, node->value, sizeof(int64));
 
-    return (WhileStatement*)memory;
+    return value;
 }
 
-Identifier* Create_Identifier(AstNode* memory, char* name) {
-    memory->type = AST_Identifier;
-    memory->identifier.name = name;
+NodeIndex Create_StringLiteral(Ast* ast, Symbol value) {
+    StringLiteral* node = Ast_Alloc(ast, AST_StringLiteral, sizeof(StringLiteral));
+    node->value = value;
 
-    return (Identifier*)memory;
+    return Ast_Last(ast, sizeof(StringLiteral));
 }
 
-NumericLiteral* Create_NumericLiteral(AstNode* memory, int64 value) {
-    memory->type = AST_NumericLiteral;
-    memory->numeric_literal.value = value;
+//
+// Merging
+//
 
-    return (NumericLiteral*)memory;
+static inline void _relocate(NodeIndex* index, size_t offset) {
+    if(*index != NODE_NONE) {
+        *index += offset;
+    }
 }
 
-StringLiteral* Create_StringLiteral(AstNode* memory, char* value) {
-    memory->type = AST_StringLiteral;
-    memory->string_literal.value = value;
+// Appends all nodes of other to ast. Returns the offset to add to node indices of other.
+size_t Ast_Append(Ast* ast, Ast* other) {
+    size_t node_offset = array_length(ast->nodes);
+    size_t extra_offset = array_length(ast->extra);
+
+    size_t node_count = array_length(other->nodes);
+    size_t extra_count = array_length(other->extra);
+
+    if(node_count > 0) {
+        memcpy(arraddnptr(ast->nodes, node_count), other->nodes, node_count * sizeof(uint32));
+    }
+
+    // Ranges only ever hold node indices
+    if(extra_count > 0) {
+        NodeIndex* extra = arraddnptr(ast->extra, extra_count);
+
+        for (size_t i = 0; i < extra_count; i++) {
+            extra[i] = other->extra[i] + node_offset;
+        }
+    }
+
+    // Walk the copied nodes and fix every reference
+    size_t index = node_offset;
+    size_t end = node_offset + node_count;
 
-    return (StringLiteral*)memory;
+    while(index < end) {
+        AstNode* node = AST_GET(ast, index, AstNode);
+
+        switch (node->type) {
+            case AST_BlockStatement: {
+                ((BlockStatement*)node)->body.first += extra_offset;
+                break;
+            }
+            case AST_IfStatement: {
+                IfStatement* item = (IfStatement*)node;
+                _relocate(&item->test, node_offset);
+                _relocate(&item->consequent, node_offset);
+                _relocate(&item->alternate, node_offset);
+                break;
+            }
+            case AST_WhileStatement: {
+                WhileStatement* item = (WhileStatement*)node;
+                _relocate(&item->test, node_offset);
+                _relocate(&item->body, node_offset);
+                break;
+            }
+            case AST_FunctionDeclaration: {
+                FunctionDeclaration* item = (FunctionDeclaration*)node;
+                item->args.first += extra_offset;
+                _relocate(&item->body, node_offset);
+                break;
+            }
+            case AST_ReturnStatement: {
+                _relocate(&((ReturnStatement*)node)->value, node_offset);
+                break;
+            }
+            case AST_VariableDeclaration:
+            case AST_ConstDeclaration: {
+                _relocate(&((VariableDeclaration*)node)->value, node_offset);
+                break;
+            }
+            case AST_TypeDefinition: {
+                ((TypeDeclaration*)node)->properties.first += extra_offset;
+                break;
+            }
+            case AST_CallExpression: {
+                CallExpression* item = (CallExpression*)node;
+                _relocate(&item->callee, node_offset);
+                item->args.first += extra_offset;
+                break;
+            }
+            case AST_MemberExpression: {
+                MemberExpression* item = (MemberExpression*)node;
+                _relocate(&item->object, node_offset);
+                _relocate(&item->member, node_offset);
+                break;
+            }
+            case AST_AssignmentExpression: {
+                AssignmentExpression* item = (AssignmentExpression*)node;
+                _relocate(&item->assignee, node_offset);
+                _relocate(&item->value, node_offset);
+                break;
+            }
+            case AST_BinaryExpression:
+            case AST_ComparisonExpression: {
+                BinaryExpression* item = (BinaryExpression*)node;
+                _relocate(&item->left, node_offset);
+                _relocate(&item->right, node_offset);
+                break;
+            }
+            default: {
+                // No children
+                break;
+            }
+        }
+
+        index += Ast_NodeSize(node->type) / sizeof(uint32);
+    }
+
+    return node_offset;
 }
 
 //
 // Visualizing
 //
-List* Get_Children(AstNode* expression) {
-    List* list = malloc(sizeof(List));
-    list->first = NULL;
-    list->last = NULL;
 
-    switch (expression->type) {
+static void _push_child(NodeIndex** children, NodeIndex child) {
+    if(child != NODE_NONE) {
+        array_push(*children, child);
+    }
+}
+
+static void _push_range(Ast* ast, NodeIndex** children, NodeRange range) {
+    for (size_t i = 0; i < range.count; i++) {
+        array_push(*children, Ast_Child(ast, range, i));
+    }
+}
+
+// Returns a temporary array, free with arrfree
+NodeIndex* Get_Children(Ast* ast, NodeIndex index) {
+    NodeIndex* children = NULL;
+    AstNode* node = AST_GET(ast, index, AstNode);
+
+    switch (node->type) {
         case AST_BlockStatement: 
         {
-            AstNode* node = expression;
-            return node->block_statement.body;
-
+            _push_range(ast, &children, ((BlockStatement*)node)->body);
             break;
         }
         case AST_VariableDeclaration:
+        case AST_ConstDeclaration:
         {
-            VariableDeclaration* node = (VariableDeclaration*)expression;
-            
-            if(node->value != NULL){
-                ListNode* newNode = listNode_create(malloc(sizeof(ListNode)), node->value);
-                list_append(list, newNode);
-            }
-
+            _push_child(&children, ((VariableDeclaration*)node)->value);
             break;
         }
         case AST_TypeDefinition:
         {
-            TypeDeclaration* node = (TypeDeclaration*)expression;
-            return node->properties;
-
-            break;
-        }
-        case AST_PropertyDeclaration:
-        {
+            _push_range(ast, &children, ((TypeDeclaration*)node)->properties);
             break;
         }
         case AST_AssignmentExpression:
         {
-            AssignmentExpression* node = (AssignmentExpression*)expression;
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->assignee);
-            list_append(list, left_node);
-
-            ListNode* right_node = listNode_create(malloc(sizeof(ListNode)), node->value);
-            list_append(list, right_node);
-
+            AssignmentExpression* item = (AssignmentExpression*)node;
+            _push_child(&children, item->assignee);
+            _push_child(&children, item->value);
             break;
         }
         case AST_CallExpression:
         {
-            CallExpression* node = (CallExpression*)expression;
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->callee);
-            list_append(list, left_node);
-
-            if(node->args->first != NULL){
-                ListNode* cursor = node->args->first;
-                while(cursor != NULL){
-                    ListNode* arg_node = listNode_create(malloc(sizeof(ListNode)), cursor->value);
-                    list_append(list, arg_node);
-                    cursor = cursor->next;
-                }
-            }
-
+            CallExpression* item = (CallExpression*)node;
+            _push_child(&children, item->callee);
+            _push_range(ast, &children, item->args);
             break;
         }
         case AST_FunctionDeclaration:
         {
-            FunctionDeclaration* node = (FunctionDeclaration*)expression;
-
-            if(node->args->first != NULL){
-                ListNode* cursor = node->args->first;
-                while(cursor != NULL){
-                    ListNode* arg_node = listNode_create(malloc(sizeof(ListNode)), cursor->value);
-                    list_append(list, arg_node);
-                    cursor = cursor->next;
-                }
-            }
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->body);
-            list_append(list, left_node);
-            
+            FunctionDeclaration* item = (FunctionDeclaration*)node;
+            _push_range(ast, &children, item->args);
+            _push_child(&children, item->body);
             break;
         }
         case AST_BinaryExpression:
-        {
-            BinaryExpression* node = (BinaryExpression*)expression;
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->left);
-            list_append(list, left_node);
-
-            ListNode* right_node = listNode_create(malloc(sizeof(ListNode)), node->right);
-            list_append(list, right_node);
-
-            break;
-        }
-        
         case AST_ComparisonExpression:
         {
-            BinaryExpression* node = (BinaryExpression*)expression;
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->left);
-            list_append(list, left_node);
-
-            ListNode* right_node = listNode_create(malloc(sizeof(ListNode)), node->right);
-            list_append(list, right_node);
-
+            BinaryExpression* item = (BinaryExpression*)node;
+            _push_child(&children, item->left);
+            _push_child(&children, item->right);
             break;
         }
         case AST_IfStatement:{
-            IfStatement* node = (IfStatement*)expression;
-
-            ListNode* test_node = listNode_create(malloc(sizeof(ListNode)), node->test);
-            list_append(list, test_node);
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->consequent);
-            list_append(list, left_node);
-
-            if(node->alternate != NULL){
-                ListNode* right_node = listNode_create(malloc(sizeof(ListNode)), node->alternate);
-                list_append(list, right_node);
-            }
-            
+            IfStatement* item = (IfStatement*)node;
+            _push_child(&children, item->test);
+            _push_child(&children, item->consequent);
+            _push_child(&children, item->alternate);
             break;
         }
         case AST_WhileStatement:{
-            WhileStatement* node = (WhileStatement*)expression;
-
-            ListNode* test_node = listNode_create(malloc(sizeof(ListNode)), node->test);
-            list_append(list, test_node);
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->body);
-            list_append(list, left_node);
-
-
-            
+            WhileStatement* item = (WhileStatement*)node;
+            _push_child(&children, item->test);
+            _push_child(&children, item->body);
             break;
         }
         case AST_MemberExpression:
         {
-            MemberExpression* node = (MemberExpression*)expression;
-
-            ListNode* right_node = listNode_create(malloc(sizeof(ListNode)), node->object);
-            list_append(list, right_node);
-
-            ListNode* left_node = listNode_create(malloc(sizeof(ListNode)), node->member);
-            list_append(list, left_node);
-
-            break;
-        }
-        case AST_NumericLiteral:
-        {
-            // Cannot have children. Don't add anything.
+            MemberExpression* item = (MemberExpression*)node;
+            _push_child(&children, item->object);
+            _push_child(&children, item->member);
             break;
         }
-        case AST_StringLiteral:
-        {
-            // Cannot have children. Don't add anything.
-            break;
-        }
-        case AST_Identifier:
+        default:
         {
             // Cannot have children. Don't add anything.
             break;
         }
     }
 
-    return list;
+    return children;
 }
 
 void astNode_print(AstNode* node)
@@ -461,17 +614,22 @@ void astNode_print(AstNode* node)
         }
         case AST_VariableDeclaration:
         {
-            printf("VariableDeclaration: %s", node->variable_declaration.name);
+            printf("VariableDeclaration: %s", symbol_name(((VariableDeclaration*)node)->name));
+            break;
+        }
+        case AST_ConstDeclaration:
+        {
+            printf("ConstDeclaration: %s", symbol_name(((ConstDeclaration*)node)->name));
             break;
         }
         case AST_TypeDefinition:
         {
-            printf("TypeDeclaration: %s", node->type_declaration.name);
+            printf("TypeDeclaration: %s", symbol_name(((TypeDeclaration*)node)->name));
             break;            
         }
         case AST_PropertyDeclaration:
         {
-            printf("PropertyDeclaration: %s", node->property_declaration.name);
+            printf("PropertyDeclaration: %s", symbol_name(((PropertyDeclaration*)node)->name));
             break;
         }
         case AST_AssignmentExpression:
@@ -481,7 +639,7 @@ void astNode_print(AstNode* node)
         }
         case AST_BinaryExpression:
         {
-            printf("BinaryExpression: %s", node->binary_expression.operator);
+            printf("BinaryExpression: %s", _operator_names[((BinaryExpression*)node)->operator]);
             break;  
         }
         case AST_ComparisonExpression:
@@ -512,24 +670,24 @@ void astNode_print(AstNode* node)
         case AST_FunctionDeclaration:
         {
             FunctionDeclaration* item = (FunctionDeclaration*)node;
-            printf("FunctionDeclaration: %s", item->name);
+            printf("FunctionDeclaration: %s", symbol_name(item->name));
             break;    
         }
         case AST_NumericLiteral:
         {
             NumericLiteral* item = (NumericLiteral*)node;
-            printf("NumericLiteral: %i", item->value);
+            printf("NumericLiteral: %i", (int)NumericLiteral_Value(item));
             break;    
         }
         case AST_StringLiteral:
         {
             StringLiteral* item = (StringLiteral*)node;
-            printf("StringLiteral: %s", item->value);
+            printf("StringLiteral: %s", symbol_name(item->value));
             break;    
         }
         case AST_Identifier:
         {
-            printf("Identifier: %s", node->identifier.name); 
+            printf("Identifier: %s", symbol_name(((Identifier*)node)->name)); 
             break;  
         }
         default:
@@ -540,7 +698,7 @@ void astNode_print(AstNode* node)
     }
 }
 
-void ast_print(AstNode* node, char* indent, bool isLast){
+void ast_print(Ast* ast, NodeIndex node, char* indent, bool isLast){
     char* marker;
 
     if(isLast)
@@ -548,11 +706,11 @@ void ast_print(AstNode* node, char* indent, bool isLast){
     else
         marker = "├───";
 
-    List* children = Get_Children(node);
+    NodeIndex* children = Get_Children(ast, node);
 
     printf("%s", indent);
     printf("%s", marker);
-    astNode_print(node);
+    astNode_print(AST_GET(ast, node, AstNode));
     printf("\n");
 
     char *new_indent = (char*)malloc(strlen(indent) + 8);
@@ -563,25 +721,19 @@ void ast_print(AstNode* node, char* indent, bool isLast){
     else
         strcat(new_indent, "│   ");
 
-    AstNode* lastChild;
-
-    if(children->first == NULL)
-        lastChild = NULL;
-    else
-        lastChild = (AstNode*)children->last->value;
+    size_t count = array_length(children);
 
-    ListNode* cursor = children->first;
-    while(cursor != NULL){
-        ast_print(cursor->value, new_indent, cursor->next == NULL);
-        cursor = cursor->next;
+    for (size_t i = 0; i < count; i++) {
+        ast_print(ast, children[i], new_indent, i == count - 1);
     }
 
     // Cleanup
+    arrfree(children);
     free(new_indent);
 }
 
-void ast_print_begin(AstNode* program){
+void ast_print_begin(Ast* ast){
     printf("\n---------------- ABSTRACT SYNTAX TREE ----------------\n\n");
 
-    ast_print(program, "", true);
+    ast_print(ast, ast->root, "", true);
 }
\ No newline at end of file
@@ -0,0 +1,309 @@
+#pragma once
+
+typedef struct Folder Folder;
+
+// Constant folding and algebraic simplification, run on the finished AST before compiling.
+// Nodes are never resized in place. A folded subtree is replaced by pointing its parent at a new or
+// existing node, the old nodes stay behind unreferenced so the buffer can still be walked node by node.
+
+struct Folder {
+    Ast* ast;
+    size_t folded; // Subtrees replaced
+};
+
+NodeIndex Fold_Node(Folder* folder, NodeIndex index);
+
+static bool _fold_number(Ast* ast, NodeIndex index, float64* value) {
+    if(Ast_Type(ast, index) != AST_NumericLiteral) {
+        return false;
+    }
+
+    *value = (float64)NumericLiteral_Value(AST_GET(ast, index, NumericLiteral));
+    return true;
+}
+
+static bool _fold_string(Ast* ast, NodeIndex index, Symbol* value) {
+    if(Ast_Type(ast, index) != AST_StringLiteral) {
+        return false;
+    }
+
+    *value = AST_GET(ast, index, StringLiteral)->value;
+    return true;
+}
+
+// True if the node can only evaluate to a number: a numeric literal, or arithmetic on such nodes that
+// was left for the VM. Anything else may hold a string or an instance at runtime.
+static bool _fold_is_numeric(Ast* ast, NodeIndex index) {
+    if(Ast_Type(ast, index) == AST_NumericLiteral) {
+        return true;
+    }
+
+    if(Ast_Type(ast, index) != AST_BinaryExpression) {
+        return false;
+    }
+
+    BinaryExpression* expression = AST_GET(ast, index, BinaryExpression);
+
+    return _fold_is_numeric(ast, expression->left) && _fold_is_numeric(ast, expression->right);
+}
+
+// Literals only hold int64, results that are not whole numbers are left for the VM to compute
+static bool _fold_is_integer(float64 value) {
+    if(!(value > -9007199254740992.0 && value < 9007199254740992.0)) {
+        return false;
+    }
+
+    float64 truncated = (float64)(int64)value;
+
+    return memcmp(&truncated, &value, sizeof(float64)) == 0; // Also keeps -0 out
+}
+
+static NodeIndex _fold_concat(Folder* folder, Symbol first, Symbol second) {
+    char* first_name = symbol_name(first);
+    char* second_name = symbol_name(second);
+    size_t first_length = strlen(first_name);
+    size_t second_length = strlen(second_name);
+
+    char* buffer = malloc(first_length + second_length);
+    memcpy(buffer, first_name, first_length);
+    memcpy(&buffer[first_length], second_name, second_length);
+
+    Symbol result = symbol_intern(buffer, first_length + second_length);
+    free(buffer);
+
+    folder->folded++;
+    return Create_StringLiteral(folder->ast, result);
+}
+
+static NodeIndex _fold_binary(Folder* folder, NodeIndex index) {
+    Ast* ast = folder->ast;
+    BinaryExpression expression = *AST_GET(ast, index, BinaryExpression);
+
+    NodeIndex left = Fold_Node(folder, expression.left);
+    NodeIndex right = Fold_Node(folder, expression.right);
+
+    // Folding children may have grown the buffer, so no pointer is held across the calls above
+    AST_GET(ast, index, BinaryExpression)->left = left;
+    AST_GET(ast, index, BinaryExpression)->right = right;
+
+    float64 a, b;
+    Symbol first, second;
+
+    bool left_number = _fold_number(ast, left, &a);
+    bool right_number = _fold_number(ast, right, &b);
+
+    if(left_number && right_number) {
+        float64 result;
+
+        switch (expression.operator) {
+            case Operator_Add:      result = a + b; break;
+            case Operator_Subtract: result = a - b; break;
+            case Operator_Multiply: result = a * b; break;
+            case Operator_Divide:   result = a / b; break;
+            default: return index; // Modulo has no opcode yet
+        }
+
+        if(!_fold_is_integer(result)) {
+            return index;
+        }
+
+        folder->folded++;
+        return Create_NumericLiteral(ast, (int64)result);
+    }
+
+    bool left_string = _fold_string(ast, left, &first);
+    bool right_string = _fold_string(ast, right, &second);
+
+    if(left_string && right_string && expression.operator == Operator_Add) {
+        return _fold_concat(folder, first, second);
+    }
+
+    // Identities, only where the other side is known to be a number. Adding anything else to a number is
+    // a runtime error, which is kept. Adding 0 is left out because -0 + 0 is 0.
+    if(right_number && _fold_is_numeric(ast, left)) {
+        bool subtractive = b == 0 && expression.operator == Operator_Subtract;
+        bool multiplicative = b == 1 && (expression.operator == Operator_Multiply || expression.operator == Operator_Divide);
+
+        if(subtractive || multiplicative) {
+            folder->folded++;
+            return left;
+        }
+    }
+
+    if(left_number && _fold_is_numeric(ast, right)) {
+        if(a == 1 && expression.operator == Operator_Multiply) {
+            folder->folded++;
+            return right;
+        }
+    }
+
+    return index;
+}
+
+// Evaluates a comparison between two literals. There is no boolean literal node, true and false are
+// ordinary globals, so comparisons are only resolved where they decide control flow.
+static bool _fold_test(Folder* folder, NodeIndex test, bool* value) {
+    Ast* ast = folder->ast;
+
+    if(Ast_Type(ast, test) != AST_ComparisonExpression) {
+        return false;
+    }
+
+    ComparisonExpression expression = *AST_GET(ast, test, ComparisonExpression);
+
+    float64 a, b;
+    Symbol first, second;
+
+    if(_fold_number(ast, expression.left, &a) && _fold_number(ast, expression.right, &b)) {
+        switch (expression.operator) {
+            case Operator_Equal:        *value = a == b; return true;
+            case Operator_NotEqual:     *value = a != b; return true;
+            case Operator_Less:         *value = a < b;  return true;
+            case Operator_LessEqual:    *value = a <= b; return true;
+            case Operator_Greater:      *value = a > b;  return true;
+            case Operator_GreaterEqual: *value = a >= b; return true;
+            default: return false;
+        }
+    }
+
+    // Strings are interned, equal contents means equal symbols
+    if(_fold_string(ast, expression.left, &first) && _fold_string(ast, expression.right, &second)) {
+        switch (expression.operator) {
+            case Operator_Equal:    *value = first == second; return true;
+            case Operator_NotEqual: *value = first != second; return true;
+            default: return false;
+        }
+    }
+
+    return false;
+}
+
+static void _fold_range(Folder* folder, NodeRange range) {
+    for (size_t i = 0; i < range.count; i++) {
+        NodeIndex child = Fold_Node(folder, Ast_Child(folder->ast, range, i));
+        folder->ast->extra[range.first + i] = child;
+    }
+}
+
+// Returns the node that replaces index, or NODE_NONE when the statement was removed
+NodeIndex Fold_Node(Folder* folder, NodeIndex index) {
+    Ast* ast = folder->ast;
+
+    if(index == NODE_NONE) {
+        return NODE_NONE;
+    }
+
+    switch (Ast_Type(ast, index)) {
+        case AST_BinaryExpression: {
+            return _fold_binary(folder, index);
+        }
+        case AST_ComparisonExpression: {
+            ComparisonExpression expression = *AST_GET(ast, index, ComparisonExpression);
+            NodeIndex left = Fold_Node(folder, expression.left);
+            NodeIndex right = Fold_Node(folder, expression.right);
+
+            AST_GET(ast, index, ComparisonExpression)->left = left;
+            AST_GET(ast, index, ComparisonExpression)->right = right;
+            break;
+        }
+        case AST_BlockStatement: {
+            NodeRange body = AST_GET(ast, index, BlockStatement)->body;
+            size_t count = 0;
+
+            // Removed statements are squeezed out of the range
+            for (size_t i = 0; i < body.count; i++) {
+                NodeIndex child = Fold_Node(folder, Ast_Child(ast, body, i));
+
+                if(child != NODE_NONE) {
+                    ast->extra[body.first + count++] = child;
+                }
+            }
+
+            AST_GET(ast, index, BlockStatement)->body.count = count;
+            break;
+        }
+        case AST_IfStatement: {
+            IfStatement statement = *AST_GET(ast, index, IfStatement);
+            NodeIndex test = Fold_Node(folder, statement.test);
+            NodeIndex consequent = Fold_Node(folder, statement.consequent);
+            NodeIndex alternate = Fold_Node(folder, statement.alternate);
+
+            bool value;
+            if(_fold_test(folder, test, &value)) {
+                folder->folded++;
+                return value ? consequent : alternate;
+            }
+
+            IfStatement* node = AST_GET(ast, index, IfStatement);
+            node->test = test;
+            node->consequent = consequent;
+            node->alternate = alternate;
+            break;
+        }
+        case AST_WhileStatement: {
+            WhileStatement statement = *AST_GET(ast, index, WhileStatement);
+            NodeIndex test = Fold_Node(folder, statement.test);
+            NodeIndex body = Fold_Node(folder, statement.body);
+
+            bool value;
+            if(_fold_test(folder, test, &value) && !value) {
+                folder->folded++;
+                return NODE_NONE;
+            }
+
+            WhileStatement* node = AST_GET(ast, index, WhileStatement);
+            node->test = test;
+            node->body = body;
+            break;
+        }
+        case AST_FunctionDeclaration: {
+            NodeIndex body = Fold_Node(folder, AST_GET(ast, index, FunctionDeclaration)->body);
+            AST_GET(ast, index, FunctionDeclaration)->body = body;
+            break;
+        }
+        case AST_ReturnStatement: {
+            NodeIndex value = Fold_Node(folder, AST_GET(ast, index, ReturnStatement)->value);
+            AST_GET(ast, index, ReturnStatement)->value = value;
+            break;
+        }
+        case AST_VariableDeclaration:
+        case AST_ConstDeclaration: {
+            NodeIndex value = Fold_Node(folder, AST_GET(ast, index, VariableDeclaration)->value);
+            AST_GET(ast, index, VariableDeclaration)->value = value;
+            break;
+        }
+        case AST_AssignmentExpression: {
+            NodeIndex value = Fold_Node(folder, AST_GET(ast, index, AssignmentExpression)->value);
+            AST_GET(ast, index, AssignmentExpression)->value = value;
+            break;
+        }
+        case AST_CallExpression: {
+            _fold_range(folder, AST_GET(ast, index, CallExpression)->args);
+            break;
+        }
+        case AST_MemberExpression: {
+            NodeIndex object = Fold_Node(folder, AST_GET(ast, index, MemberExpression)->object);
+            AST_GET(ast, index, MemberExpression)->object = object;
+            break;
+        }
+        default: {
+            // Leaves
+            break;
+        }
+    }
+
+    return index;
+}
+
+void ast_fold(Ast* ast) {
+    int64 t1 = timestamp();
+
+    Folder folder;
+    folder.ast = ast;
+    folder.folded = 0;
+
+    ast->root = Fold_Node(&folder, ast->root);
+
+    int64 t2 = timestamp();
+    printf("Folding: %d ms (%llu subtrees folded)\n", t2/1000-t1/1000, (uint64)folder.folded);
+}
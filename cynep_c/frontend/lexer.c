@@ -1,7 +1,10 @@
 #pragma once
 
 typedef enum TokenType TokenType;
+typedef enum OperatorKind OperatorKind;
 typedef struct Token Token; 
+typedef union TokenPayload TokenPayload;
+typedef struct TokenStream TokenStream;
 typedef struct BufferString BufferString; 
 typedef enum ParseState ParseState;
 
@@ -13,6 +16,7 @@ enum TokenType {
 
     // Keywords
     Token_Let,
+    Token_Const,
     Token_Null,
     Token_Type,
     Token_If,
@@ -37,24 +41,80 @@ enum TokenType {
     Token_EOF
 };
 
+// Carried by Token_BinaryOperator and Token_ComparisonOperator tokens
+enum OperatorKind {
+    Operator_None,
+
+    // Arithmetic
+    Operator_Add,
+    Operator_Subtract,
+    Operator_Multiply,
+    Operator_Divide,
+    Operator_Modulo,
+
+    // Comparison
+    Operator_Equal,
+    Operator_NotEqual,
+    Operator_Less,
+    Operator_LessEqual,
+    Operator_Greater,
+    Operator_GreaterEqual,
+
+    Operator_Count
+};
+
+char* _operator_names[Operator_Count] = { "", "+", "-", "*", "/", "%", "==", "!=", "<", "<=", ">", ">=" };
+
 enum ParseState {
     ParseState_Start,
-    ParseState_Symbol,
-    ParseState_Number,
-    ParseState_String,
-    ParseState_Comment
+    ParseState_Number
+};
+
+union TokenPayload {
+    Symbol symbol; // Identifiers and strings
+    OperatorKind operator_kind;
+    float64 number_value;   
 };
 
+// Decoded view of a single token. Tokens are stored in a TokenStream, this is what the lexer pushes and the parser reads.
 struct Token {
     TokenType type;
+    uint32 offset; // Position in the file buffer
     union
     {   
-        char* string;
-        char operator_value[2];
+        TokenPayload payload;
+        Symbol symbol;
+        OperatorKind operator_kind;
         float64 number_value;   
     };  
 };
 
+#define TOKEN_CHUNK_SHIFT 16
+#define TOKEN_CHUNK_SIZE (1 << TOKEN_CHUNK_SHIFT)
+#define TOKEN_CHUNK_MASK (TOKEN_CHUNK_SIZE - 1)
+
+#define TOKEN_BATCH_SIZE 1024 // Tokens per batch handed to a pipelined parser
+
+// Struct of arrays token storage. Kinds are one byte each, payloads are only stored for tokens that have one
+// and source offsets are kept for diagnostics. Storage grows in chunks that never move once allocated,
+// so the directories are sized up front for the worst case of one token per source byte. Chunks come
+// from a virtual arena reserved for that worst case, only the pages actually used get committed.
+struct TokenStream {
+    size_t count;
+    size_t payload_count;
+    size_t chunk_capacity; // Length of each directory
+    uint8_t** kinds;
+    uint32** offsets;
+    TokenPayload** payloads;
+    Arena* arena; // Chunk storage
+    TextFile* file;
+
+    // Pipelined mode only. Carries the token count after each finished batch from the lexer thread to
+    // the parser. Chunks never move, so the parser can read everything below the last published count.
+    Ring* pipe;
+    size_t published;
+};
+
 #define ALPHA \
          'A': \
     case 'B': \
@@ -121,24 +181,20 @@ struct Token {
     case '9': \
     case '0'
 
-unsigned long hash_function(char* str) 
-{
-    unsigned long i = 0;
+// Same order as _keywords in symbols.c
+TokenType _keyword_tokens[] = { Token_Type, Token_Let, Token_If, Token_Else, Token_While, Token_Func, Token_Return, Token_Const };
 
-    for (int j = 0; str[j]; j++)
-        i += str[j];
+Token Token_Create(TokenType type) {
+    Token token;
+    token.type = type;
 
-    return i % 50000;
+    return token;
 }
 
-Token Token_Create(TokenType type, char* start, size_t length, Arena* arena) {
+Token Token_Symbol_Create(TokenType type, char* start, size_t length) {
     Token token;
     token.type = type;
-
-
-    token.string = arena_alloc(arena, sizeof(char) * (length + 1));
-    strncpy(token.string, start, length);
-    token.string[length] = NULL_CHAR;
+    token.symbol = symbol_intern(start, length);
 
     return token;
 }
@@ -151,10 +207,11 @@ Token Token_Number_Create(TokenType type, float64 value) {
     return token;
 }
 
-Token Token_Operator_Create(TokenType type, char operator[2]) {
+Token Token_Operator_Create(TokenType type, OperatorKind kind) {
     Token token;
     token.type = type;
-    strcpy(token.operator_value, operator);
+    token.number_value = 0; // Clears the rest of the payload
+    token.operator_kind = kind;
 
     return token;
 }
@@ -163,24 +220,118 @@ bool Is_Skippable(char c) {
     return isspace(c);
 }
 
-int token_count = 0;
+#pragma region TOKEN_STREAM
+
+static inline bool Token_HasPayload(TokenType type) {
+    return type <= Token_Identifier || type == Token_ComparisonOperator || type == Token_BinaryOperator;
+}
+
+TokenStream* TokenStream_Create(TextFile* file) {
+    TokenStream* stream = malloc(sizeof(TokenStream));
+    stream->count = 0;
+    stream->payload_count = 0;
+    stream->chunk_capacity = (file->length + 1) / TOKEN_CHUNK_SIZE + 1;
+    stream->kinds = calloc(stream->chunk_capacity, sizeof(uint8_t*));
+    stream->offsets = calloc(stream->chunk_capacity, sizeof(uint32*));
+    stream->payloads = calloc(stream->chunk_capacity, sizeof(TokenPayload*));
+    stream->arena = arena_create_virtual(stream->chunk_capacity * TOKEN_CHUNK_SIZE * (sizeof(uint8_t) + sizeof(uint32) + sizeof(TokenPayload)));
+    stream->file = file;
+    stream->pipe = NULL;
+    stream->published = 0;
+
+    return stream;
+}
+
+static void TokenStream_Publish(TokenStream* stream) {
+    ring_push(stream->pipe, stream->count);
+    stream->published = stream->count;
+}
+
+void Push_Token(TokenStream* stream, Token token, size_t offset) {
+    size_t chunk = stream->count >> TOKEN_CHUNK_SHIFT;
+    size_t index = stream->count & TOKEN_CHUNK_MASK;
+
+    if(index == 0) {
+        stream->kinds[chunk] = arena_alloc(stream->arena, TOKEN_CHUNK_SIZE * sizeof(uint8_t));
+        stream->offsets[chunk] = arena_alloc(stream->arena, TOKEN_CHUNK_SIZE * sizeof(uint32));
+    }
+
+    stream->kinds[chunk][index] = token.type;
+    stream->offsets[chunk][index] = offset;
+    stream->count++;
+
+    if(Token_HasPayload(token.type)) {
+        size_t payload_chunk = stream->payload_count >> TOKEN_CHUNK_SHIFT;
+        size_t payload_index = stream->payload_count & TOKEN_CHUNK_MASK;
+
+        if(payload_index == 0) {
+            stream->payloads[payload_chunk] = arena_alloc(stream->arena, TOKEN_CHUNK_SIZE * sizeof(TokenPayload));
+        }
+
+        stream->payloads[payload_chunk][payload_index] = token.payload;
+        stream->payload_count++;
+    }
+
+    if(stream->pipe && stream->count - stream->published == TOKEN_BATCH_SIZE) {
+        TokenStream_Publish(stream);
+    }
+}
+
+static inline TokenType TokenStream_Kind(TokenStream* stream, size_t index) {
+    return stream->kinds[index >> TOKEN_CHUNK_SHIFT][index & TOKEN_CHUNK_MASK];
+}
+
+static inline uint32 TokenStream_Offset(TokenStream* stream, size_t index) {
+    return stream->offsets[index >> TOKEN_CHUNK_SHIFT][index & TOKEN_CHUNK_MASK];
+}
+
+static inline TokenPayload TokenStream_Payload(TokenStream* stream, size_t payload_index) {
+    return stream->payloads[payload_index >> TOKEN_CHUNK_SHIFT][payload_index & TOKEN_CHUNK_MASK];
+}
+
+// Decodes token index. payload_index is the number of payload tokens before it.
+static inline Token TokenStream_Get(TokenStream* stream, size_t index, size_t payload_index) {
+    Token token;
+    token.type = TokenStream_Kind(stream, index);
+    token.offset = TokenStream_Offset(stream, index);
+    token.number_value = 0;
+
+    if(Token_HasPayload(token.type)) {
+        token.payload = TokenStream_Payload(stream, payload_index);
+    }
 
-Token* NextTokenMem(MemPool* pool) {
-    token_count++;
-    return MemPool_GetMem(pool, sizeof(Token)).pointer;
+    return token;
 }
 
-Token* lexer_tokenize(TextFile* file) {
+size_t TokenStream_MemoryUsage(TokenStream* stream) {
+    size_t token_chunks = (stream->count + TOKEN_CHUNK_MASK) >> TOKEN_CHUNK_SHIFT;
+    size_t payload_chunks = (stream->payload_count + TOKEN_CHUNK_MASK) >> TOKEN_CHUNK_SHIFT;
+
+    return token_chunks * TOKEN_CHUNK_SIZE * (sizeof(uint8_t) + sizeof(uint32))
+         + payload_chunks * TOKEN_CHUNK_SIZE * sizeof(TokenPayload);
+}
+
+// Length of the token starting at p, recovered from the source since only offsets are stored.
+size_t Token_SourceLength(char* p) {
+    if(*p == NULL_CHAR) return 0;
+    if(*p == '"') return scan_string(p + 1) + 1 - p;
+    if(_scan_is_identifier_char(*p)) return scan_identifier(p) - p;
+    if(p[1] == '=' && (*p == '=' || *p == '!' || *p == '<' || *p == '>')) return 2;
+    return 1;
+}
+
+#pragma endregion
+
+// Tokenizes the whole file into stream. In pipelined mode every finished batch is published as it goes.
+void lexer_run(TokenStream* stream) {
+    TextFile* file = stream->file;
     char* file_buffer = file->buffer;
     int64 t1 = timestamp();
 
-    // Just allocate as if every character is a token?
-    // Kind of wasteful but then we would never have to reallocate.
-    size_t tokens_max = file->length / 2;
-
-    Arena* arena = arena_create(500 * sizeof(Token));
+    if(scan_whitespace == NULL) {
+        scan_init(ScanMode_AVX2);
+    }
 
-    MemPool* pool = MemPool_Make(sizeof(Token) * tokens_max);
     size_t pos = 0;
 
     ParseState state = ParseState_Start;
@@ -192,44 +343,36 @@ Token* lexer_tokenize(TextFile* file) {
         char* current = &file_buffer[pos];
         char* lookahead = &file_buffer[pos + 1];
 
-        char current_as_string[2];
-        current_as_string[0] = *current;
-        current_as_string[1] = NULL_CHAR;
-
-        char current_and_lookahead_as_string[3];
-        current_and_lookahead_as_string[0] = *current;
-        current_and_lookahead_as_string[1] = *lookahead;
-        current_and_lookahead_as_string[2] = NULL_CHAR;
-
         switch (state)
         {
             case ParseState_Start: 
             {
                 switch (*current)
                 {
-                    case '+':
-                    case '-':
-                    case '*':
-                    case '%': { *NextTokenMem(pool) = Token_Operator_Create(Token_BinaryOperator, current_as_string); break; }    
+                    case '+': { Push_Token(stream, Token_Operator_Create(Token_BinaryOperator, Operator_Add), pos); break; }
+                    case '-': { Push_Token(stream, Token_Operator_Create(Token_BinaryOperator, Operator_Subtract), pos); break; }
+                    case '*': { Push_Token(stream, Token_Operator_Create(Token_BinaryOperator, Operator_Multiply), pos); break; }
+                    case '%': { Push_Token(stream, Token_Operator_Create(Token_BinaryOperator, Operator_Modulo), pos); break; }    
                     case '/': { 
                         if(*lookahead == '/') {
-                            state = ParseState_Comment;
-                            pos++;
+                            // Skip the comment body, the newline is handled as whitespace
+                            pos = scan_line(lookahead + 1) - file_buffer;
+                            continue;
                         } else{
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_BinaryOperator, current_as_string);
+                            Push_Token(stream, Token_Operator_Create(Token_BinaryOperator, Operator_Divide), pos);
                         }
                         break;
                     }  
-                    case '(': { *NextTokenMem(pool) = Token_Operator_Create(Token_OpenParen, current_as_string); break; }
-                    case ')': { *NextTokenMem(pool) = Token_Operator_Create(Token_CloseParen, current_as_string); break; }   
-                    case '{': { *NextTokenMem(pool) = Token_Operator_Create(Token_OpenBrace, current_as_string); break; }
-                    case '}': { *NextTokenMem(pool) = Token_Operator_Create(Token_CloseBrace, current_as_string); break; }
-                    case ',': { *NextTokenMem(pool) = Token_Operator_Create(Token_Comma, current_as_string); break; }
-                    case ';': { *NextTokenMem(pool) = Token_Operator_Create(Token_Semicolon, current_as_string); break; }
-                    case '.': { *NextTokenMem(pool) = Token_Operator_Create(Token_Dot, current_as_string); break; }
+                    case '(': { Push_Token(stream, Token_Create(Token_OpenParen), pos); break; }
+                    case ')': { Push_Token(stream, Token_Create(Token_CloseParen), pos); break; }   
+                    case '{': { Push_Token(stream, Token_Create(Token_OpenBrace), pos); break; }
+                    case '}': { Push_Token(stream, Token_Create(Token_CloseBrace), pos); break; }
+                    case ',': { Push_Token(stream, Token_Create(Token_Comma), pos); break; }
+                    case ';': { Push_Token(stream, Token_Create(Token_Semicolon), pos); break; }
+                    case '.': { Push_Token(stream, Token_Create(Token_Dot), pos); break; }
                     case '!': {   
                         if(*lookahead == '=') {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_and_lookahead_as_string);  
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_NotEqual), pos);  
                             pos++;
                         } else{
                             // TODO: Unary negation operator
@@ -238,42 +381,58 @@ Token* lexer_tokenize(TextFile* file) {
                     }
                     case '>': {   
                         if(*lookahead == '=') { 
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_and_lookahead_as_string);                  
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_GreaterEqual), pos);                  
                             pos++;
                         } else {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_as_string); 
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_Greater), pos); 
                         }
                         break;
                     }
                     case '<': {   
                         if(*lookahead == '=') {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_and_lookahead_as_string);  
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_LessEqual), pos);  
                             pos++;
                         } else {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_as_string); 
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_Less), pos); 
                         }
                         
                         break;
                     }
                     case '=': {   
                         if(*lookahead == '=') {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_ComparisonOperator, current_and_lookahead_as_string);  
+                            Push_Token(stream, Token_Operator_Create(Token_ComparisonOperator, Operator_Equal), pos);  
                             pos++;
                         } else {
-                            *NextTokenMem(pool) = Token_Operator_Create(Token_Assignment, current_as_string); 
+                            Push_Token(stream, Token_Create(Token_Assignment), pos); 
                         }
                         break;
                     }
                     case '"': {       
-                        state = ParseState_String;
-                        buff_start = current + 1;
-                        buff_length = 0;
-                        break;
+                        char* end = scan_string(lookahead);
+                        // The span includes the quotes
+                        Push_Token(stream, Token_Symbol_Create(Token_String, lookahead, end - lookahead), pos); 
+
+                        if(*end == NULL_CHAR) {
+                            printf("Lexer error. Unterminated string.\n");
+                            exit(0);
+                        }
+
+                        pos = end + 1 - file_buffer;
+                        continue;
                     }
                     case ALPHA: {
-                        state = ParseState_Symbol;
-                        buff_start = current;
-                        buff_length = 0;
+                        char* end = scan_identifier(current);
+
+                        // Keywords are the first symbols in the intern table
+                        Token token = Token_Symbol_Create(Token_Identifier, current, end - current);
+
+                        if(symbol_is_keyword(token.symbol)) {
+                            token.type = _keyword_tokens[token.symbol];
+                        }
+
+                        Push_Token(stream, token, pos);
+
+                        pos = end - file_buffer;
                         continue;
                     }
                     case DIGIT: {
@@ -284,7 +443,8 @@ Token* lexer_tokenize(TextFile* file) {
                     }
                     default: {
                         if (Is_Skippable(*current)) {
-                            break;
+                            pos = scan_whitespace(current) - file_buffer;
+                            continue;
                         }
                         else {   
                             printf("Lexer error. Unrecognized character in source: \"%c\".\n", *current);
@@ -295,64 +455,6 @@ Token* lexer_tokenize(TextFile* file) {
                 break;
             }
 
-            case ParseState_String: {
-                switch (*current)
-                {
-                    case '"': {
-                        state = ParseState_Start;
-                        *NextTokenMem(pool) = Token_Create(Token_String, buff_start, buff_length, arena); 
-                        break;
-                    }
-                    default: {
-                        buff_length++;
-                        break;
-                    }
-                }
-                break;
-            }
-
-            case ParseState_Symbol: { 
-                switch (*current)
-                {
-                    case ALPHA: 
-                    case DIGIT: {
-                        buff_length++;
-                        break;
-                    }  
-                    default: {
-                        state = ParseState_Start;
-
-                        if(buff_length == 4 && strncmp(buff_start, "type", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_Type, buff_start, buff_length, arena); 
-                        }
-                        else if(buff_length == 3 && strncmp(buff_start, "var", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_Let, buff_start, buff_length, arena); 
-                        }
-                        else if(buff_length == 2 && strncmp(buff_start, "if", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_If, buff_start, buff_length, arena);
-                        }
-                        else if(buff_length == 4 && strncmp(buff_start, "else", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_Else, buff_start, buff_length, arena); 
-                        }
-                        else if(buff_length == 5 && strncmp(buff_start, "while", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_While, buff_start, buff_length, arena); 
-                        }
-                        else if(buff_length == 4 && strncmp(buff_start, "func", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_Func, buff_start, buff_length, arena); 
-                        }
-                        else if(buff_length == 6 && strncmp(buff_start, "return", buff_length) == 0) {
-                            *NextTokenMem(pool) = Token_Create(Token_Return, buff_start, buff_length, arena); 
-                        }
-                        else {
-                            *NextTokenMem(pool) = Token_Create(Token_Identifier, buff_start, buff_length, arena); 
-                        }
-
-                        continue;
-                    }
-                }
-                break;
-            }
-
             case ParseState_Number: {
                 switch (*current)
                 {
@@ -363,29 +465,15 @@ Token* lexer_tokenize(TextFile* file) {
                     default: {
                         state = ParseState_Start;
 
-                        char asd[buff_length];
+                        char asd[buff_length + 1];
                         strncpy(asd, buff_start, buff_length);
                         asd[buff_length] = NULL_CHAR;
                         float64 parsed_number = atoi(asd); 
 
-                        *NextTokenMem(pool) = Token_Number_Create(Token_Number, parsed_number);
-
-                        continue;
-                    }
-                }
-                break;
-            }
+                        Push_Token(stream, Token_Number_Create(Token_Number, parsed_number), buff_start - file_buffer);
 
-            case ParseState_Comment: {
-                switch (*current)
-                {
-                    case '\n': {
-                        state = ParseState_Start;
                         continue;
                     }
-                    default: {
-                        break;
-                    };
                 }
                 break;
             }
@@ -399,18 +487,28 @@ Token* lexer_tokenize(TextFile* file) {
         pos++;
     }  
 
-    *NextTokenMem(pool) = Token_Create(Token_EOF, NULL, 0, arena);  
+    Push_Token(stream, Token_Create(Token_EOF), pos);  
+
+    if(stream->pipe) {
+        if(stream->published != stream->count) {
+            TokenStream_Publish(stream);
+        }
+        ring_close(stream->pipe);
+    }
 
-    // for (size_t i = 0; i < token_count; i++)
-    // {
-    //     Token* asd = &pool->bytes[i];
-    //     int asdd = 0;
-    //     //printf("%c%c\n", pool->bytes[i].operator_value[0], pool->bytes[i].operator_value[1]);
-    //     //printf("%i %.*s\n", tokens[i].type, (int)tokens[i].string_value.length, tokens[i].string_value.start);
-    // }
-    
     int64 t2 = timestamp();
-    printf("Tokenization: %d ms\n", t2/1000-t1/1000);
+    printf("Tokenization: %d ms (%llu tokens, %llu KB)\n", t2/1000-t1/1000, (uint64)stream->count, (uint64)TokenStream_MemoryUsage(stream) / 1024);
+}
+
+TokenStream* lexer_tokenize(TextFile* file) {
+    TokenStream* stream = TokenStream_Create(file);
+    lexer_run(stream);
+
+    return stream;
+}
 
-    return (Token*)pool->bytes;
+// Thread entry for the pipelined frontend, takes a TokenStream with a pipe
+void* lexer_task(void* stream) {
+    lexer_run((TokenStream*)stream);
+    return NULL;
 }
\ No newline at end of file
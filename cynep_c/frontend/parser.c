@@ -1,66 +1,123 @@
 #pragma once
 
-bool  End_Of_File();
-Token Current();
-Token Consume();
-Token ConsumeExpect(TokenType type, char* error);
-
-AstNode*                Parse_Statement(Arena* arena);
-Expression*             Parse_Expression(Arena* arena);
-VariableDeclaration*    Parse_VariableDeclaration(Arena* arena);
-TypeDeclaration*        Parse_TypeDeclaration(Arena* arena);
-Expression*             Parse_AssignmentExpression(Arena* arena);
-Expression*             Parse_PrimaryExpression(Arena* arena);
-Expression*             Parse_ComparisonExpression(Arena* arena);
-Expression*             Parse_AdditiveExpression(Arena* arena);
-Expression*             Parse_MultiplicativeExpression(Arena* arena);
-IfStatement*            Parse_IfStatement(Arena* arena);
-WhileStatement*         Parse_WhileStatement(Arena* arena);
-BlockStatement*         Parse_BlockStatement(Arena* arena);
-ReturnStatement*        Parse_ReturnStatement(Arena* arena);
-
-Expression* Parse_CallMemberExpression(Arena* arena);
-CallExpression* Parse_CallExpression(Arena* arena, Expression* caller);
-Expression* Parse_MemberExpression(Arena* arena);
-List* Parse_Args(Arena* arena);
-List* Parse_ArgumentsList(Arena* arena, List* args);
-FunctionDeclaration* Parse_FunctionDeclaration(Arena* arena);
+typedef struct Parser Parser;
+
+bool  End_Of_File(Parser* parser);
+Token Current(Parser* parser);
+Token Consume(Parser* parser);
+Token ConsumeExpect(Parser* parser, TokenType type, char* error);
+
+NodeIndex   Parse_Statement(Parser* parser);
+NodeIndex   Parse_Expression(Parser* parser);
+NodeIndex   Parse_VariableDeclaration(Parser* parser);
+NodeIndex   Parse_ConstDeclaration(Parser* parser);
+NodeIndex   Parse_TypeDeclaration(Parser* parser);
+NodeIndex   Parse_AssignmentExpression(Parser* parser);
+NodeIndex   Parse_PrimaryExpression(Parser* parser);
+NodeIndex   Parse_BinaryExpression(Parser* parser, uint8_t min_precedence);
+
+#define PRECEDENCE_NONE 0 // Not a binary operator
+#define PRECEDENCE_LOWEST 1
+#define PRECEDENCE_COMPARISON 1
+#define PRECEDENCE_ADDITIVE 2
+#define PRECEDENCE_MULTIPLICATIVE 3
+
+NodeIndex   Parse_IfStatement(Parser* parser);
+NodeIndex   Parse_WhileStatement(Parser* parser);
+NodeIndex   Parse_BlockStatement(Parser* parser);
+NodeIndex   Parse_ReturnStatement(Parser* parser);
+
+NodeIndex Parse_CallMemberExpression(Parser* parser);
+NodeIndex Parse_CallExpression(Parser* parser, NodeIndex caller);
+NodeIndex Parse_MemberExpression(Parser* parser);
+NodeRange Parse_Args(Parser* parser);
+void      Parse_ArgumentsList(Parser* parser);
+NodeIndex Parse_FunctionDeclaration(Parser* parser);
 
 //
-// Globals
+// Parser state
 //
 
-Token* _tokens = NULL;
-size_t _current_index = 0;
+// One per token stream, so several parsers can run at once
+struct Parser {
+    TokenStream* tokens;
+    size_t current_index;
+    size_t current_payload; // Payload index of the current token
+    size_t available; // Tokens that are safe to read, grows as the lexer publishes in pipelined mode
+    Token previous; // Last consumed token
+    TextFile* source; // For error messages
+    Ast* ast; // Output
+};
+
+void Parser_Init(Parser* parser, TokenStream* tokens, TextFile* source, Ast* ast) {
+    parser->tokens = tokens;
+    parser->current_index = 0;
+    parser->current_payload = 0;
+    parser->available = tokens->pipe ? 0 : tokens->count;
+    parser->previous = Token_Create(Token_EOF);
+    parser->previous.offset = 0;
+    parser->source = source;
+    parser->ast = ast;
+}
 
 //
 //  Helpers
 //
 
-bool End_Of_File(){
-    return _tokens[_current_index].type == Token_EOF;
+__attribute__((noreturn)) void Parser_Error(Parser* parser, Token token, char* error){
+    size_t line, column;
+    source_location(parser->source, token.offset, &line, &column);
+
+    char* text = &parser->source->buffer[token.offset];
+    printf("Parser error at %s:%llu:%llu near \"%.*s\". %s\n", parser->source->path, (uint64)line, (uint64)column, (int)Token_SourceLength(text), text, error);
+    exit(1);
+}
+
+// Blocks until the current token has been published by the lexer
+static void Parser_Wait(Parser* parser){
+    while(parser->current_index >= parser->available) {
+        uint64 published;
+
+        if(parser->tokens->pipe == NULL || !ring_pop(parser->tokens->pipe, &published)) {
+            Parser_Error(parser, parser->previous, "Unexpected end of file.");
+        }
+
+        parser->available = published;
+    }
+}
+
+static inline void Parser_Fill(Parser* parser){
+    if(parser->current_index >= parser->available) {
+        Parser_Wait(parser);
+    }
 }
 
-Token Current(){
-    return _tokens[_current_index];
+bool End_Of_File(Parser* parser){
+    Parser_Fill(parser);
+    return TokenStream_Kind(parser->tokens, parser->current_index) == Token_EOF;
 }
 
-Token Consume(){
-    Token token = _tokens[_current_index];
-    _current_index++;
+Token Current(Parser* parser){
+    Parser_Fill(parser);
+    return TokenStream_Get(parser->tokens, parser->current_index, parser->current_payload);
+}
+
+Token Consume(Parser* parser){
+    Token token = Current(parser);
+    parser->current_index++;
+    parser->current_payload += Token_HasPayload(token.type);
+    parser->previous = token;
     return token;
 }
 
-Token ConsumeExpect(TokenType type, char* error){
-    Token token = _tokens[_current_index];
+Token ConsumeExpect(Parser* parser, TokenType type, char* error){
+    Token token = Current(parser);
 
     if(type != token.type){
-        printf("Exprected %d, got %d. %s\n", type, token.type, error);
-        exit(0);
+        Parser_Error(parser, token, error);
     }
 
-    _current_index++;
-    return token;
+    return Consume(parser);
 }
 
 
@@ -68,217 +125,395 @@ Token ConsumeExpect(TokenType type, char* error){
 //  Parsing
 //
 
-AstNode* Build_SyntaxTree(Token* tokens)
+Ast* Build_SyntaxTree(TokenStream* tokens, TextFile* source)
 {
     int64 t1 = timestamp();
+    int64 first_statement = -1;
 
-    _tokens = tokens;
+    Ast* ast = ast_create();
 
-    Arena* arena = arena_create(500 * sizeof(AstNode));
+    Parser parser;
+    Parser_Init(&parser, tokens, source, ast);
 
-    BlockStatement* block = Create_BlockStatement(arena_alloc(arena, sizeof(AstNode)), arena_alloc(arena, sizeof(List)));
+    size_t body = Ast_RangeBegin(ast);
 
-    while(!End_Of_File()){
-        AstNode* statement = Parse_Statement(arena);
+    while(!End_Of_File(&parser)){
+        Ast_RangePush(ast, Parse_Statement(&parser));
 
-        ListNode* node = listNode_create(arena_alloc(arena, sizeof(ListNode)), statement);
-        list_append(block->body, node);
+        if(first_statement == -1) {
+            first_statement = timestamp();
+        }
     }
 
+    ast->root = Create_BlockStatement(ast, Ast_RangeEnd(ast, body));
+
     int64 t2 = timestamp();
-    printf("Parsing: %d ms\n", t2/1000-t1/1000);
+    printf("Parsing: %d ms (first statement after %d us, %llu KB AST)\n", t2/1000-t1/1000, (int)(first_statement == -1 ? 0 : first_statement - t1), (uint64)ast_memory_usage(ast) / 1024);
+
+    return ast;
+}
+
+// Lexes on a second thread while parsing. Batches of tokens are handed over through a ring buffer,
+// so parsing starts as soon as the first batch is done instead of after the whole file.
+Ast* Build_SyntaxTree_Pipelined(TextFile* source)
+{
+    TokenStream* tokens = TokenStream_Create(source);
+    tokens->pipe = ring_create();
+
+    pthread_t lexer_thread;
+    pthread_create(&lexer_thread, NULL, lexer_task, tokens);
+
+    Ast* program = Build_SyntaxTree(tokens, source);
+
+    pthread_join(lexer_thread, NULL);
+
+    return program;
+}
+
+#pragma region PARALLEL
+
+// Top level statements are independent, so a large file can be cut into chunks of whole statements
+// that are parsed on separate threads and then joined back in source order.
+
+#define PARSE_CHUNKS_PER_WORKER 4
+#define PARSE_MIN_CHUNKS 4 // With fewer chunks the threads cost more than they save
 
-    // for (size_t i = 0; i < nodes_count; i++)
-    // {
-    //     printf("%s\n", nodes[i].name);
-    // }
+typedef struct ParseChunk ParseChunk;
+typedef struct ParallelParse ParallelParse;
 
-    return (AstNode*)block;
+struct ParseChunk {
+    size_t start; // First token
+    size_t payload_start; // Payload index of the first token
+    size_t end; // One past the last token
+    Ast* ast; // Top level statements are left on its scratch stack
+};
+
+struct ParallelParse {
+    TokenStream* tokens;
+    TextFile* source;
+    ParseChunk* chunks;
+};
+
+static bool Token_StartsStatement(TokenType type) {
+    return type == Token_Let || type == Token_Const || type == Token_Type || type == Token_Func || type == Token_If || type == Token_While || type == Token_Return;
+}
+
+// Splits the stream at top level statement boundaries into chunks of at least target_tokens tokens.
+// A boundary is a semicolon or closing brace at brace depth zero that is followed by a statement keyword.
+ParseChunk* Parser_SplitChunks(TokenStream* tokens, size_t target_tokens) {
+    ParseChunk* chunks = NULL;
+    ParseChunk chunk = { 0 };
+
+    size_t payload = 0;
+    int64 depth = 0;
+
+    for (size_t i = 0; i < tokens->count; i++) {
+        TokenType type = TokenStream_Kind(tokens, i);
+        payload += Token_HasPayload(type);
+
+        if(type == Token_OpenBrace) {
+            depth++;
+            continue;
+        }
+
+        if(type == Token_CloseBrace) {
+            depth--;
+        }
+        else if(type != Token_Semicolon) {
+            continue;
+        }
+
+        if(depth != 0 || i + 1 - chunk.start < target_tokens || !Token_StartsStatement(TokenStream_Kind(tokens, i + 1))) {
+            continue;
+        }
+
+        chunk.end = i + 1;
+        array_push(chunks, chunk);
+
+        chunk.start = i + 1;
+        chunk.payload_start = payload;
+    }
+
+    // The rest up to the end of file token
+    chunk.end = tokens->count - 1;
+    if(chunk.end > chunk.start) {
+        array_push(chunks, chunk);
+    }
+
+    return chunks;
+}
+
+static void Parse_Chunk(void* context, size_t job, size_t worker) {
+    ParallelParse* parse = context;
+    ParseChunk* chunk = &parse->chunks[job];
+
+    chunk->ast = ast_create();
+
+    Parser parser;
+    Parser_Init(&parser, parse->tokens, parse->source, chunk->ast);
+    parser.current_index = chunk->start;
+    parser.current_payload = chunk->payload_start;
+
+    while(parser.current_index < chunk->end) {
+        Ast_RangePush(chunk->ast, Parse_Statement(&parser));
+    }
+
+    if(parser.current_index != chunk->end) {
+        Parser_Error(&parser, parser.previous, "Statement does not end at a top level boundary.");
+    }
 }
 
-AstNode* Parse_Statement(Arena* arena)
+// Same result as Build_SyntaxTree, with the top level statements parsed on worker_count threads.
+// Falls back to Build_SyntaxTree on a single thread or when the file does not split into enough chunks.
+Ast* Build_SyntaxTree_Parallel(TokenStream* tokens, TextFile* source, size_t worker_count)
 {
-    switch (Current().type)
+    if(worker_count <= 1) {
+        return Build_SyntaxTree(tokens, source);
+    }
+
+    int64 t1 = timestamp();
+
+    size_t target_tokens = tokens->count / (worker_count * PARSE_CHUNKS_PER_WORKER) + 1;
+
+    ParallelParse parse;
+    parse.tokens = tokens;
+    parse.source = source;
+    parse.chunks = Parser_SplitChunks(tokens, target_tokens);
+
+    size_t chunk_count = array_length(parse.chunks);
+
+    if(chunk_count < PARSE_MIN_CHUNKS) {
+        arrfree(parse.chunks);
+        return Build_SyntaxTree(tokens, source);
+    }
+    parallel_for(chunk_count, worker_count, Parse_Chunk, &parse);
+
+    // Join the chunks in source order, node indices of each chunk are shifted by its offset
+    Ast* ast = ast_create();
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        Ast* chunk_ast = parse.chunks[i].ast;
+        size_t offset = Ast_Append(ast, chunk_ast);
+
+        for (size_t s = 0; s < array_length(chunk_ast->scratch); s++) {
+            Ast_RangePush(ast, chunk_ast->scratch[s] + offset);
+        }
+
+        ast_destroy(chunk_ast);
+    }
+
+    ast->root = Create_BlockStatement(ast, Ast_RangeEnd(ast, 0));
+
+    arrfree(parse.chunks);
+
+    int64 t2 = timestamp();
+    printf("Parsing: %d ms (%llu chunks on %llu threads, %llu KB AST)\n", t2/1000-t1/1000, (uint64)chunk_count, (uint64)worker_count, (uint64)ast_memory_usage(ast) / 1024);
+
+    return ast;
+}
+
+#pragma endregion
+
+NodeIndex Parse_Statement(Parser* parser)
+{
+    switch (Current(parser).type)
     {
         case Token_Let: {
-            return (AstNode*)Parse_VariableDeclaration(arena);
+            return Parse_VariableDeclaration(parser);
+        }
+        case Token_Const: {
+            return Parse_ConstDeclaration(parser);
         }
         case Token_Type: {
-            return (AstNode*)Parse_TypeDeclaration(arena);
+            return Parse_TypeDeclaration(parser);
         }
         case Token_Func: {
-            return (AstNode*)Parse_FunctionDeclaration(arena);
+            return Parse_FunctionDeclaration(parser);
         }
         case Token_If: {
-            return (AstNode*)Parse_IfStatement(arena);
+            return Parse_IfStatement(parser);
         }
         case Token_While: {
-            return (AstNode*)Parse_WhileStatement(arena);
+            return Parse_WhileStatement(parser);
         }
         case Token_Return: {
-            return (AstNode*)Parse_ReturnStatement(arena);
+            return Parse_ReturnStatement(parser);
         }
         default: {
-            return (AstNode*)Parse_Expression(arena);
+            return Parse_Expression(parser);
         }
     }
 }
 
-FunctionDeclaration* Parse_FunctionDeclaration(Arena* arena)
+NodeIndex Parse_FunctionDeclaration(Parser* parser)
 {
-    Token func_token = Consume();
-    Token func_name = ConsumeExpect(Token_Identifier, "Function should be followed by an identifier");
+    Ast* ast = parser->ast;
 
-    List* args = list_create(arena_alloc(arena, sizeof(List)));
+    Token func_token = Consume(parser);
+    Token func_name = ConsumeExpect(parser, Token_Identifier, "Function should be followed by an identifier");
 
-    ConsumeExpect(Token_OpenParen, "Function declaration should be followed by an open parenthesis.");
+    ConsumeExpect(parser, Token_OpenParen, "Function declaration should be followed by an open parenthesis.");
 
-    if(Current().type == Token_Identifier){
+    size_t args = Ast_RangeBegin(ast);
+
+    if(Current(parser).type == Token_Identifier){
         do {
-            if(Current().type == Token_Comma){
-                Consume();
+            if(Current(parser).type == Token_Comma){
+                Consume(parser);
             }
 
-            Token identifierTok = ConsumeExpect(Token_Identifier, "func argument should be an identifier.");
-            Identifier* identifier = Create_Identifier(arena_alloc(arena, sizeof(AstNode)), identifierTok.string);
-            ListNode* node = listNode_create(arena_alloc(arena, sizeof(AstNode)), identifier);
-            list_append(args, node);
-        } while((Current().type == Token_Comma));
+            Token identifierTok = ConsumeExpect(parser, Token_Identifier, "func argument should be an identifier.");
+            Ast_RangePush(ast, Create_Identifier(ast, identifierTok.symbol));
+        } while((Current(parser).type == Token_Comma));
     }
 
-    ConsumeExpect(Token_CloseParen, "Missing close parenthesis in function declaration.");
+    NodeRange arg_range = Ast_RangeEnd(ast, args);
+
+    ConsumeExpect(parser, Token_CloseParen, "Missing close parenthesis in function declaration.");
     
-    BlockStatement* body;
-    if(Current().type == Token_OpenBrace){
-        body = Parse_BlockStatement(arena);
+    NodeIndex body = NODE_NONE;
+    if(Current(parser).type == Token_OpenBrace){
+        body = Parse_BlockStatement(parser);
     }
 
-    return Create_FunctionDeclaration(arena_alloc(arena, sizeof(AstNode)), func_name.string, args, body);
+    return Create_FunctionDeclaration(ast, func_name.symbol, arg_range, body);
 }
 
-ReturnStatement* Parse_ReturnStatement(Arena* arena){
-    Token return_token = Consume();
+NodeIndex Parse_ReturnStatement(Parser* parser){
+    Token return_token = Consume(parser);
 
-    Expression* value = Parse_Expression(arena);
+    NodeIndex value = Parse_Expression(parser);
 
-    ConsumeExpect(Token_Semicolon, "Return statement should have a semicolon at the end.");
+    ConsumeExpect(parser, Token_Semicolon, "Return statement should have a semicolon at the end.");
 
-    return Create_ReturnStatement(arena_alloc(arena, sizeof(AstNode)), value);
+    return Create_ReturnStatement(parser->ast, value);
 }
 
-IfStatement* Parse_IfStatement(Arena* arena)
+NodeIndex Parse_IfStatement(Parser* parser)
 {
-    Token if_token = Consume();
-    ConsumeExpect(Token_OpenParen, "If statement should be followed by an open parenthesis.");
-    ComparisonExpression* test = (ComparisonExpression*)Parse_ComparisonExpression(arena);
-    ConsumeExpect(Token_CloseParen, "Missing close parenthesis in if statement.");
+    Token if_token = Consume(parser);
+    ConsumeExpect(parser, Token_OpenParen, "If statement should be followed by an open parenthesis.");
+    NodeIndex test = Parse_BinaryExpression(parser, PRECEDENCE_LOWEST);
+    ConsumeExpect(parser, Token_CloseParen, "Missing close parenthesis in if statement.");
     
-    AstNode* consequtive;
-    if(Current().type == Token_OpenBrace){
-        consequtive = (AstNode*)Parse_BlockStatement(arena);
+    NodeIndex consequtive = NODE_NONE;
+    if(Current(parser).type == Token_OpenBrace){
+        consequtive = Parse_BlockStatement(parser);
     }
     else{
         // TODO: Parse single expression. Fuck this for now.
     }
 
-    AstNode* alternate = NULL;
-    if(Current().type == Token_Else){
-        Consume();
-        if(Current().type == Token_OpenBrace){
-            alternate = (AstNode*)Parse_BlockStatement(arena);
+    NodeIndex alternate = NODE_NONE;
+    if(Current(parser).type == Token_Else){
+        Consume(parser);
+        if(Current(parser).type == Token_OpenBrace){
+            alternate = Parse_BlockStatement(parser);
         }
         else{
             // TODO: Parse single expression. Fuck this for now.
         }
     }
 
-    return Create_IfStatement(arena_alloc(arena, sizeof(AstNode)), test, consequtive, alternate);
+    return Create_IfStatement(parser->ast, test, consequtive, alternate);
 }
 
-WhileStatement* Parse_WhileStatement(Arena* arena)
+NodeIndex Parse_WhileStatement(Parser* parser)
 {
-    Token if_token = Consume();
-    ConsumeExpect(Token_OpenParen, "While statement should be followed by an open parenthesis.");
-    ComparisonExpression* test = (ComparisonExpression*)Parse_ComparisonExpression(arena);
-    ConsumeExpect(Token_CloseParen, "Missing close parenthesis in while statement.");
+    Token if_token = Consume(parser);
+    ConsumeExpect(parser, Token_OpenParen, "While statement should be followed by an open parenthesis.");
+    NodeIndex test = Parse_BinaryExpression(parser, PRECEDENCE_LOWEST);
+    ConsumeExpect(parser, Token_CloseParen, "Missing close parenthesis in while statement.");
     
-    AstNode* body;
-    if(Current().type == Token_OpenBrace){
-        body = (AstNode*)Parse_BlockStatement(arena);
+    NodeIndex body = NODE_NONE;
+    if(Current(parser).type == Token_OpenBrace){
+        body = Parse_BlockStatement(parser);
     }
     else{
         // TODO: Parse single expression. Fuck this for now.
     }
 
-    return Create_WhileStatement(arena_alloc(arena, sizeof(AstNode)), test, body);
+    return Create_WhileStatement(parser->ast, test, body);
 }
 
-BlockStatement* Parse_BlockStatement(Arena* arena){
-    Consume(); // Open brace
+NodeIndex Parse_BlockStatement(Parser* parser){
+    Ast* ast = parser->ast;
 
-    BlockStatement* block = Create_BlockStatement(arena_alloc(arena, sizeof(AstNode)), arena_alloc(arena, sizeof(List)));
+    Consume(parser); // Open brace
 
-    while(Current().type != Token_CloseBrace){
-        AstNode* statement = Parse_Statement(arena);
-        ListNode* node = listNode_create(arena_alloc(arena, sizeof(ListNode)), statement);
+    size_t body = Ast_RangeBegin(ast);
 
-        list_append(block->body, node);
+    while(Current(parser).type != Token_CloseBrace){
+        Ast_RangePush(ast, Parse_Statement(parser));
     }
 
-    ConsumeExpect(Token_CloseBrace, "Missing close brace in block.");
+    ConsumeExpect(parser, Token_CloseBrace, "Missing close brace in block.");
 
-    return block;
+    return Create_BlockStatement(ast, Ast_RangeEnd(ast, body));
 }
 
-VariableDeclaration* Parse_VariableDeclaration(Arena* arena)
+NodeIndex Parse_VariableDeclaration(Parser* parser)
 {
     // var {identifier} : {type} = {expression};
     // var {identifier};
-    Token let_token = Consume();
-    Token identifier = ConsumeExpect(Token_Identifier, "Let keyword should be followed by an identifier.");
+    Token let_token = Consume(parser);
+    Token identifier = ConsumeExpect(parser, Token_Identifier, "Let keyword should be followed by an identifier.");
 
-    if(Current().type == Token_Semicolon){
-        Consume();
+    if(Current(parser).type == Token_Semicolon){
+        Consume(parser);
 
-        return Create_VariableDeclaration(arena_alloc(arena, sizeof(AstNode)), identifier.string, NULL);
+        return Create_VariableDeclaration(parser->ast, identifier.symbol, NODE_NONE);
     }
     else{
-        ConsumeExpect(Token_Assignment, "Identifier in var declaration should be followed by an equals token.");
-        Expression* expression = Parse_Expression(arena);
+        ConsumeExpect(parser, Token_Assignment, "Identifier in var declaration should be followed by an equals token.");
+        NodeIndex expression = Parse_Expression(parser);
         
-        ConsumeExpect(Token_Semicolon, "Variable declaration must end with semicolon.");
+        ConsumeExpect(parser, Token_Semicolon, "Variable declaration must end with semicolon.");
         
-        return Create_VariableDeclaration(arena_alloc(arena, sizeof(AstNode)), identifier.string, expression);
+        return Create_VariableDeclaration(parser->ast, identifier.symbol, expression);
     }
 }
 
-TypeDeclaration* Parse_TypeDeclaration(Arena* arena)
+NodeIndex Parse_ConstDeclaration(Parser* parser)
 {
-    Token type_token = Consume();
-    Token identifier = ConsumeExpect(Token_Identifier, "Type keyword should be followed by an identifier.");
-    ConsumeExpect(Token_Assignment, "Error in type declaration");
-    ConsumeExpect(Token_OpenBrace, "Error in type declaration");
+    // const {identifier} = {expression};
+    Token const_token = Consume(parser);
+    Token identifier = ConsumeExpect(parser, Token_Identifier, "Const keyword should be followed by an identifier.");
 
-    TypeDeclaration* type_declaration = Create_TypeDeclaration(arena_alloc(arena, sizeof(AstNode)), arena_alloc(arena, sizeof(List)), identifier.string);
+    ConsumeExpect(parser, Token_Assignment, "Const declaration must have a value.");
+    NodeIndex expression = Parse_Expression(parser);
 
-    while(!End_Of_File() && Current().type != Token_CloseBrace){
-        Token property_identifier = ConsumeExpect(Token_Identifier, "Error in type declaration");
-        ConsumeExpect(Token_Semicolon, "Error in type declaration");
+    ConsumeExpect(parser, Token_Semicolon, "Const declaration must end with semicolon.");
 
-        PropertyDeclaration* property_declaration = Create_PropertyDeclaration(arena_alloc(arena, sizeof(AstNode)), property_identifier.string);
+    return Create_ConstDeclaration(parser->ast, identifier.symbol, expression);
+}
+
+NodeIndex Parse_TypeDeclaration(Parser* parser)
+{
+    Ast* ast = parser->ast;
 
-        ListNode* node = listNode_create(arena_alloc(arena, sizeof(AstNode)), property_declaration);
-        list_append(type_declaration->properties, node);
+    Token type_token = Consume(parser);
+    Token identifier = ConsumeExpect(parser, Token_Identifier, "Type keyword should be followed by an identifier.");
+    ConsumeExpect(parser, Token_Assignment, "Error in type declaration");
+    ConsumeExpect(parser, Token_OpenBrace, "Error in type declaration");
+
+    size_t properties = Ast_RangeBegin(ast);
+
+    while(!End_Of_File(parser) && Current(parser).type != Token_CloseBrace){
+        Token property_identifier = ConsumeExpect(parser, Token_Identifier, "Error in type declaration");
+        ConsumeExpect(parser, Token_Semicolon, "Error in type declaration");
+
+        Ast_RangePush(ast, Create_PropertyDeclaration(ast, property_identifier.symbol));
     }
 
-    ConsumeExpect(Token_CloseBrace, "Error in type declaration");
+    ConsumeExpect(parser, Token_CloseBrace, "Error in type declaration");
 
-    return type_declaration;
+    return Create_TypeDeclaration(ast, identifier.symbol, Ast_RangeEnd(ast, properties));
 }
 
-Expression* Parse_Expression(Arena* arena)
+NodeIndex Parse_Expression(Parser* parser)
 {
-    return (Expression*)Parse_AssignmentExpression(arena);
+    return Parse_AssignmentExpression(parser);
 }
 
 
@@ -295,73 +530,72 @@ Expression* Parse_Expression(Arena* arena)
 // MemberExpression             [X]
 // PrimaryExpression            [X]
 
-Expression* Parse_AssignmentExpression(Arena* arena)
+// Binary operators are parsed by precedence climbing over this table instead of one function per level.
+// New operators only need an OperatorKind and a row here.
+
+typedef struct OperatorInfo OperatorInfo;
+
+struct OperatorInfo {
+    uint8_t precedence;
+    NodeType node_type;
+};
+
+OperatorInfo _operator_table[Operator_Count] = {
+    [Operator_Add]          = { PRECEDENCE_ADDITIVE,        AST_BinaryExpression },
+    [Operator_Subtract]     = { PRECEDENCE_ADDITIVE,        AST_BinaryExpression },
+    [Operator_Multiply]     = { PRECEDENCE_MULTIPLICATIVE,  AST_BinaryExpression },
+    [Operator_Divide]       = { PRECEDENCE_MULTIPLICATIVE,  AST_BinaryExpression },
+    [Operator_Modulo]       = { PRECEDENCE_MULTIPLICATIVE,  AST_BinaryExpression },
+    [Operator_Equal]        = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+    [Operator_NotEqual]     = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+    [Operator_Less]         = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+    [Operator_LessEqual]    = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+    [Operator_Greater]      = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+    [Operator_GreaterEqual] = { PRECEDENCE_COMPARISON,      AST_ComparisonExpression },
+};
+
+NodeIndex Parse_AssignmentExpression(Parser* parser)
 {
-    Expression* left = Parse_ComparisonExpression(arena);
-
-    if(Current().type == Token_Assignment)
-    {
-        Consume();
-        Expression* value = Parse_ComparisonExpression(arena);
-        ConsumeExpect(Token_Semicolon, "Variable assignment must end with semicolon.");
-
-        return (Expression*)Create_AssignmentExpression(arena_alloc(arena, sizeof(AstNode)), left, value);
-    }
+    NodeIndex left = Parse_BinaryExpression(parser, PRECEDENCE_LOWEST);
 
-    return left;
-}
-
-Expression* Parse_ComparisonExpression(Arena* arena)
-{
-    Expression* left = Parse_AdditiveExpression(arena);
-
-    while (0 == strncmp(Current().operator_value,"==", 2)
-        || 0 == strncmp(Current().operator_value,"!=", 2)  
-        || 0 == strncmp(Current().operator_value,">=", 2) 
-        || 0 == strncmp(Current().operator_value,"<=", 2)
-        || 0 == strncmp(Current().operator_value,">" , 2)
-        || 0 == strncmp(Current().operator_value,"<" , 2))
+    if(Current(parser).type == Token_Assignment)
     {
-        char* operator = Consume().operator_value;
-        Expression* right = Parse_AdditiveExpression(arena);
+        Consume(parser);
+        NodeIndex value = Parse_BinaryExpression(parser, PRECEDENCE_LOWEST);
+        ConsumeExpect(parser, Token_Semicolon, "Variable assignment must end with semicolon.");
 
-        left = (Expression*)Create_ComparisonExpression(arena_alloc(arena, sizeof(AstNode)), left, operator, right);
-
-        // TODO: Should be possible to do type checking here
+        return Create_AssignmentExpression(parser->ast, left, value);
     }
 
     return left;
 }
 
-Expression* Parse_AdditiveExpression(Arena* arena)
+// Parses operators binding at least as tight as min_precedence. All binary operators are left associative.
+NodeIndex Parse_BinaryExpression(Parser* parser, uint8_t min_precedence)
 {
-    Expression* left = Parse_MultiplicativeExpression(arena);
+    NodeIndex left = Parse_CallMemberExpression(parser);
 
-    while (0 == strcmp(Current().operator_value,"+") || 0 == strcmp(Current().operator_value,"-"))
+    while (true)
     {
-        char* operator = Consume().operator_value;
-        Expression* right = Parse_MultiplicativeExpression(arena);
+        Token token = Current(parser);
 
-        left = (Expression*)Create_BinaryExpression(arena_alloc(arena, sizeof(AstNode)), left, operator, right);
+        // Only operator tokens have operator_kind set, the union holds other data for the rest
+        if(token.type != Token_BinaryOperator && token.type != Token_ComparisonOperator) {
+            break;
+        }
 
-        // TODO: Should be possible to do type checking here
-    }
+        OperatorInfo info = _operator_table[token.operator_kind];
 
-    return left;
-}
+        if(info.precedence == PRECEDENCE_NONE || info.precedence < min_precedence) {
+            break;
+        }
 
-Expression* Parse_MultiplicativeExpression(Arena* arena)
-{
-    Expression* left = Parse_CallMemberExpression(arena);
+        Consume(parser);
+        NodeIndex right = Parse_BinaryExpression(parser, info.precedence + 1);
 
-    while (0 == strcmp(Current().operator_value,"*") 
-        || 0 == strcmp(Current().operator_value,"/") 
-        || 0 == strcmp(Current().operator_value,"%"))
-    {
-        char* operator = Consume().operator_value;
-        Expression* right = Parse_CallMemberExpression(arena);
+        left = Create_BinaryExpression(parser->ast, info.node_type, left, token.operator_kind, right);
 
-        left = (Expression*)Create_BinaryExpression(arena_alloc(arena, sizeof(AstNode)), left, operator, right);
+        // TODO: Should be possible to do type checking here
     }
 
     return left;
@@ -371,81 +605,75 @@ Expression* Parse_MultiplicativeExpression(Arena* arena)
 //  CallExpression
 //
 
-Expression* Parse_CallMemberExpression(Arena* arena){
-    Expression* member = Parse_MemberExpression(arena);
+NodeIndex Parse_CallMemberExpression(Parser* parser){
+    NodeIndex member = Parse_MemberExpression(parser);
 
-    if (Current().type == Token_OpenParen)
+    if (Current(parser).type == Token_OpenParen)
     {
-        return (Expression*)Parse_CallExpression(arena, member);
+        return Parse_CallExpression(parser, member);
     }
 
     return member; 
 }
 
-CallExpression* Parse_CallExpression(Arena* arena, Expression* caller){
+NodeIndex Parse_CallExpression(Parser* parser, NodeIndex caller){
 
-    CallExpression* call_expr = Create_CallExpression(arena_alloc(arena, sizeof(AstNode)), caller, Parse_Args(arena));
+    NodeRange args = Parse_Args(parser);
+    NodeIndex call_expr = Create_CallExpression(parser->ast, caller, args);
 
-    if(Current().type == Token_OpenParen){
-        call_expr = Parse_CallExpression(arena, caller);
+    if(Current(parser).type == Token_OpenParen){
+        call_expr = Parse_CallExpression(parser, caller);
     }
 
     return call_expr;
 }
 
-List* Parse_Args(Arena* arena)
+NodeRange Parse_Args(Parser* parser)
 {
-    ConsumeExpect(Token_OpenParen, "Args must start with open paren.");
-    List* args = list_create(arena_alloc(arena, sizeof(List)));  
+    ConsumeExpect(parser, Token_OpenParen, "Args must start with open paren.");
 
-    if(Current().type == Token_CloseParen)
-    {
-        int a = 0;
-    }
-    else
+    size_t args = Ast_RangeBegin(parser->ast);
+
+    if(Current(parser).type != Token_CloseParen)
     {
-        args = Parse_ArgumentsList(arena, args);
+        Parse_ArgumentsList(parser);
     }
 
-    ConsumeExpect(Token_CloseParen, "Args must end with close paren.");
+    NodeRange range = Ast_RangeEnd(parser->ast, args);
+
+    ConsumeExpect(parser, Token_CloseParen, "Args must end with close paren.");
 
-    return args;
+    return range;
 }
 
-List* Parse_ArgumentsList(Arena* arena, List* args)
+// Pushes the arguments to the current range
+void Parse_ArgumentsList(Parser* parser)
 {
-    Expression* expr = Parse_AssignmentExpression(arena);
-    ListNode* node = listNode_create(arena_alloc(arena, sizeof(ListNode)), expr);
-    list_append(args, node);
+    Ast_RangePush(parser->ast, Parse_AssignmentExpression(parser));
 
-    while (Current().type == Token_Comma)
+    while (Current(parser).type == Token_Comma)
     {
-        Consume();
+        Consume(parser);
 
-        Expression* expr = Parse_AssignmentExpression(arena);
-        ListNode* node = listNode_create(arena_alloc(arena, sizeof(ListNode)), expr);
-        list_append(args, node);
+        Ast_RangePush(parser->ast, Parse_AssignmentExpression(parser));
     }
-
-    return args;
 }
 
-Expression* Parse_MemberExpression(Arena* arena)
+NodeIndex Parse_MemberExpression(Parser* parser)
 {
-    Expression* obj = Parse_PrimaryExpression(arena);
+    NodeIndex obj = Parse_PrimaryExpression(parser);
 
-    while (Current().type == Token_Dot)
+    while (Current(parser).type == Token_Dot)
     {
-        Consume(); // Eat dot
-        Expression* member = Parse_PrimaryExpression(arena);
+        Consume(parser); // Eat dot
+        NodeIndex member = Parse_PrimaryExpression(parser);
 
-        if (member->statement.type != AST_Identifier)
+        if (Ast_Type(parser->ast, member) != AST_Identifier)
         {
-            printf("Dot operator requires identifier on right hand");
-            exit(0);
+            Parser_Error(parser, parser->previous, "Dot operator requires identifier on right hand");
         }
 
-        obj = (Expression*)Create_MemberExpression(arena_alloc(arena, sizeof(AstNode)), obj, (Identifier*)member);
+        obj = Create_MemberExpression(parser->ast, obj, member);
     }
 
     return obj;
@@ -455,36 +683,34 @@ Expression* Parse_MemberExpression(Arena* arena)
 //  End CallExpression
 //
 
-Expression* Parse_PrimaryExpression(Arena* arena)
+NodeIndex Parse_PrimaryExpression(Parser* parser)
 {
-    Token token = Current();
+    Token token = Current(parser);
 
     switch (token.type) { 
         case Token_Identifier:
             {
-                return (Expression*)Create_Identifier(arena_alloc(arena, sizeof(AstNode)), Consume().string);
+                return Create_Identifier(parser->ast, Consume(parser).symbol);
             }
         case Token_Number:
             {
-                return (Expression*)Create_NumericLiteral(arena_alloc(arena, sizeof(AstNode)), Consume().number_value); //atoi(Consume().value)
+                return Create_NumericLiteral(parser->ast, Consume(parser).number_value); //atoi(Consume(parser).value)
             }
         case Token_String:
             {     
-                return (Expression*)Create_StringLiteral(arena_alloc(arena, sizeof(AstNode)), Consume().string); //atoi(Consume().value)
+                return Create_StringLiteral(parser->ast, Consume(parser).symbol); //atoi(Consume(parser).value)
             }
         case Token_OpenParen:
             {
-                Consume(); // Throw away open paren
-                Expression* expression = Parse_Expression(arena);
-                ConsumeExpect(Token_CloseParen, "Error in primary expression"); // Throw away close paren
+                Consume(parser); // Throw away open paren
+                NodeIndex expression = Parse_Expression(parser);
+                ConsumeExpect(parser, Token_CloseParen, "Error in primary expression"); // Throw away close paren
 
                 return expression;
             }
         default:
             {
-                printf("Unexpected token in parser.");
-                 printf("Unexpected token in parser: \"%s\"\n", Current().string);
-                exit(0);
+                Parser_Error(parser, token, "Unexpected token.");
             }
     }
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+// Fast paths for the lexer. Each scanner takes a pointer into a null terminated buffer and
+// returns a pointer to the first byte that ends the run:
+//
+//  scan_whitespace:  first non-whitespace byte
+//  scan_identifier:  first byte that is not [A-Za-z0-9]
+//  scan_string:      first '"' or null
+//  scan_line:        first '\n' or null
+//
+// The SIMD versions classify 16 (SSE2) or 32 (AVX2) bytes at a time. They only ever load aligned
+// blocks, so they never touch a page past the one holding the null terminator.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+typedef enum ScanMode ScanMode;
+
+enum ScanMode {
+    ScanMode_Scalar,
+    ScanMode_SSE2,
+    ScanMode_AVX2
+};
+
+char* (*scan_whitespace)(char* p);
+char* (*scan_identifier)(char* p);
+char* (*scan_string)(char* p);
+char* (*scan_line)(char* p);
+
+ScanMode scan_mode = ScanMode_Scalar;
+
+#pragma region SCALAR
+
+static inline bool _scan_is_identifier_char(char c) {
+    return (uint8_t)(c - '0') <= 9 || (uint8_t)((c | 0x20) - 'a') <= 25;
+}
+
+static char* scan_whitespace_scalar(char* p) {
+    while(isspace(*p)) p++;
+    return p;
+}
+
+static char* scan_identifier_scalar(char* p) {
+    while(_scan_is_identifier_char(*p)) p++;
+    return p;
+}
+
+static char* scan_string_scalar(char* p) {
+    while(*p != '"' && *p != NULL_CHAR) p++;
+    return p;
+}
+
+static char* scan_line_scalar(char* p) {
+    while(*p != '\n' && *p != NULL_CHAR) p++;
+    return p;
+}
+
+#pragma endregion
+
+#ifdef SCAN_X86
+
+#pragma region SSE2
+
+// Byte lanes where lo <= v <= hi, as an unsigned compare
+#define SSE2_IN_RANGE(v, lo, hi) \
+    _mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8((v), _mm_set1_epi8(lo)), _mm_set1_epi8((hi) - (lo))), _mm_sub_epi8((v), _mm_set1_epi8(lo)))
+
+#define SSE2_NOT(v) _mm_xor_si128((v), _mm_set1_epi8(-1))
+
+#define SSE2_END_OF_WHITESPACE(v) SSE2_NOT(_mm_or_si128(_mm_cmpeq_epi8((v), _mm_set1_epi8(' ')), SSE2_IN_RANGE((v), '\t', '\r')))
+#define SSE2_END_OF_IDENTIFIER(v) SSE2_NOT(_mm_or_si128(SSE2_IN_RANGE((v), '0', '9'), SSE2_IN_RANGE(_mm_or_si128((v), _mm_set1_epi8(0x20)), 'a', 'z')))
+#define SSE2_END_OF_STRING(v)     _mm_or_si128(_mm_cmpeq_epi8((v), _mm_set1_epi8('"')), _mm_cmpeq_epi8((v), _mm_setzero_si128()))
+#define SSE2_END_OF_LINE(v)       _mm_or_si128(_mm_cmpeq_epi8((v), _mm_set1_epi8('\n')), _mm_cmpeq_epi8((v), _mm_setzero_si128()))
+
+#define SCAN_SSE2(name, END)                                                                \
+__attribute__((target("sse2"))) static char* name(char* p) {                                \
+    char* block = (char*)((uintptr_t)p & ~(uintptr_t)15);                                   \
+    uint32 mask = _mm_movemask_epi8(END(_mm_load_si128((__m128i*)block)));                  \
+    mask &= 0xFFFFu << (p - block); /* Ignore bytes before p */                             \
+    while(mask == 0) {                                                                      \
+        block += 16;                                                                        \
+        mask = _mm_movemask_epi8(END(_mm_load_si128((__m128i*)block)));                     \
+    }                                                                                       \
+    return block + __builtin_ctz(mask);                                                     \
+}
+
+SCAN_SSE2(scan_whitespace_sse2, SSE2_END_OF_WHITESPACE)
+SCAN_SSE2(scan_identifier_sse2, SSE2_END_OF_IDENTIFIER)
+SCAN_SSE2(scan_string_sse2, SSE2_END_OF_STRING)
+SCAN_SSE2(scan_line_sse2, SSE2_END_OF_LINE)
+
+#pragma endregion
+
+#pragma region AVX2
+
+#define AVX2_IN_RANGE(v, lo, hi) \
+    _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8((v), _mm256_set1_epi8(lo)), _mm256_set1_epi8((hi) - (lo))), _mm256_sub_epi8((v), _mm256_set1_epi8(lo)))
+
+#define AVX2_NOT(v) _mm256_xor_si256((v), _mm256_set1_epi8(-1))
+
+#define AVX2_END_OF_WHITESPACE(v) AVX2_NOT(_mm256_or_si256(_mm256_cmpeq_epi8((v), _mm256_set1_epi8(' ')), AVX2_IN_RANGE((v), '\t', '\r')))
+#define AVX2_END_OF_IDENTIFIER(v) AVX2_NOT(_mm256_or_si256(AVX2_IN_RANGE((v), '0', '9'), AVX2_IN_RANGE(_mm256_or_si256((v), _mm256_set1_epi8(0x20)), 'a', 'z')))
+#define AVX2_END_OF_STRING(v)     _mm256_or_si256(_mm256_cmpeq_epi8((v), _mm256_set1_epi8('"')), _mm256_cmpeq_epi8((v), _mm256_setzero_si256()))
+#define AVX2_END_OF_LINE(v)       _mm256_or_si256(_mm256_cmpeq_epi8((v), _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8((v), _mm256_setzero_si256()))
+
+#define SCAN_AVX2(name, END)                                                                \
+__attribute__((target("avx2"))) static char* name(char* p) {                                \
+    char* block = (char*)((uintptr_t)p & ~(uintptr_t)31);                                   \
+    uint32 mask = _mm256_movemask_epi8(END(_mm256_load_si256((__m256i*)block)));            \
+    mask &= 0xFFFFFFFFu << (p - block); /* Ignore bytes before p */                         \
+    while(mask == 0) {                                                                      \
+        block += 32;                                                                        \
+        mask = _mm256_movemask_epi8(END(_mm256_load_si256((__m256i*)block)));               \
+    }                                                                                       \
+    return block + __builtin_ctz(mask);                                                     \
+}
+
+SCAN_AVX2(scan_whitespace_avx2, AVX2_END_OF_WHITESPACE)
+SCAN_AVX2(scan_identifier_avx2, AVX2_END_OF_IDENTIFIER)
+SCAN_AVX2(scan_string_avx2, AVX2_END_OF_STRING)
+SCAN_AVX2(scan_line_avx2, AVX2_END_OF_LINE)
+
+#pragma endregion
+
+#endif
+
+// Picks the widest instruction set the CPU supports, capped at max_mode.
+void scan_init(ScanMode max_mode) {
+    scan_mode = ScanMode_Scalar;
+
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+
+    if(max_mode >= ScanMode_AVX2 && __builtin_cpu_supports("avx2")) {
+        scan_mode = ScanMode_AVX2;
+    }
+    else if(max_mode >= ScanMode_SSE2 && __builtin_cpu_supports("sse2")) {
+        scan_mode = ScanMode_SSE2;
+    }
+#endif
+
+    switch (scan_mode)
+    {
+#ifdef SCAN_X86
+        case ScanMode_AVX2: {
+            scan_whitespace = scan_whitespace_avx2;
+            scan_identifier = scan_identifier_avx2;
+            scan_string = scan_string_avx2;
+            scan_line = scan_line_avx2;
+            break;
+        }
+        case ScanMode_SSE2: {
+            scan_whitespace = scan_whitespace_sse2;
+            scan_identifier = scan_identifier_sse2;
+            scan_string = scan_string_sse2;
+            scan_line = scan_line_sse2;
+            break;
+        }
+#endif
+        default: {
+            scan_whitespace = scan_whitespace_scalar;
+            scan_identifier = scan_identifier_scalar;
+            scan_string = scan_string_scalar;
+            scan_line = scan_line_scalar;
+            break;
+        }
+    }
+}
@@ -15,13 +15,25 @@
 #include "util/file.c"
 #include "util/array.c"
 #include "util/arena.c"
+#include "util/slab.c"
+#include "util/table.c"
+#include "util/symbols.c"
+#include "util/ring.c"
+#include "util/threads.c"
 
+#include "frontend/scan.c"
 #include "frontend/lexer.c"
 #include "frontend/ast.c"
 #include "frontend/parser.c"
+#include "frontend/fold.c"
 
 #include "backend/runtime.c"
+#include "backend/gc.c"
+#include "backend/jit.c"
+#include "backend/peephole.c"
 #include "backend/compiler.c"
+#include "backend/register.c"
+#include "backend/aot.c"
 
 
 
@@ -61,52 +73,97 @@ int main(int argc, char**argv)
 {
     bool show_ast = arg(argc, argv, "-ast");
     bool show_disassemble = arg(argc, argv, "-dis");
+    bool pipelined = arg(argc, argv, "-pipeline");
+    bool parallel = arg(argc, argv, "-parallel");
+    bool profile = arg(argc, argv, "-profile");
+    bool registers = arg(argc, argv, "-registers");
+    bool aot = arg(argc, argv, "-aot");
+    bool gcstats = arg(argc, argv, "-gcstats");
+
+    // Superinstructions are on unless told otherwise, turning them off helps to compare profiles
+    _peephole_enabled = !arg(argc, argv, "-nopeephole");
+
+    // Opcodes specialize themselves on the types they see while running, off gives the generic baseline
+    _quicken_enabled = !arg(argc, argv, "-noquicken");
+
+    // Hot functions are compiled to machine code, off keeps everything in the interpreter
+    _jit_enabled = !arg(argc, argv, "-nojit");
+
+    // Lexer fast paths use the widest SIMD the CPU has unless told otherwise
+    scan_init(arg(argc, argv, "-scalar") ? ScanMode_Scalar : ScanMode_AVX2);
 
     int64 total_begin = timestamp();
 
-    size_t asd = sizeof(AstNode);
 
-    TextFile* file = read_entire_file("stackoverflow.cynep");
-    Token* tokens = lexer_tokenize(file);
-    AstNode* program = Build_SyntaxTree(tokens);
+    TextFile* file = map_entire_file("stackoverflow.cynep");
+    Ast* program;
+
+    // Pipelined runs the lexer on its own thread and parses tokens as they come in
+    if (pipelined) {
+        program = Build_SyntaxTree_Pipelined(file);
+    }
+    else if (parallel) {
+        TokenStream* tokens = lexer_tokenize(file);
+        program = Build_SyntaxTree_Parallel(tokens, file, cpu_count());
+    }
+    else {
+        TokenStream* tokens = lexer_tokenize(file);
+        program = Build_SyntaxTree(tokens, file);
+    }
+
+    // Constant expressions and dead branches are resolved on the tree, before any code is generated
+    ast_fold(program);
 
     // Setup global object
     Program* global = make_program();
     program_add_global(global, "VERSION", NUMBER_VAL(0.1));
-    program_add_native_function(global, "multiply", &Multiply, 2);
-    program_add_native_function(global, "alloc", &Alloc, 1);
+    program_add_native_function(global, "multiply", &Multiply, 2, true);
+    program_add_native_function(global, "alloc", &Alloc, 1, false);
 
     // Compile
-    compile((AstNode*)program, global);
+    compile(program, global);
+
+    // Writes the script out as C and builds stackoverflow.aot, which runs it without the interpreter
+    if (aot)
+        return aot_build(global, "stackoverflow") ? 0 : 1;
+
+    // Only does something when running as that build
+    aot_install(global);
+
+    // The register engine is built on top of what the stack compiler has set up, scripts that do not fit
+    // its one byte operands run on the stack engine
+    if (registers)
+        registers = register_compile(program, global);
 
     int64 total_end = timestamp();
     printf("Total: %d ms\n", total_end/1000-total_begin/1000);
 
     if (show_ast) 
-        ast_print_begin((AstNode*)program);
+        ast_print_begin(program);
     
     if (show_disassemble) 
         Disassemble(global);
 
+    if (show_disassemble && registers)
+        Register_Disassemble(global);
+
     // Start execution
     VM virtualMachine;
-    RuntimeValue result = vm_exec(&virtualMachine, global);
+    RegisterVM registerMachine;
+    RuntimeValue result;
 
-    printf("Execution result: %s", RuntimeValue_ToString(result));
-}
+    if (registers)
+        result = register_exec(&registerMachine, global, false);
+    else
+        result = vm_exec(&virtualMachine, global, profile ? VM_ProfileCreate() : NULL);
 
-#pragma region THREADING
+    printf("Execution result: %s", RuntimeValue_ToString(result));
 
-void *parseTask(void *vargp)
-{
-    TextFile* file = read_entire_file((char*)vargp);
-    Token* tokens = lexer_tokenize(file);
-}
+    // Counts opcode pairs and triples to find candidates for superinstructions
+    if (profile && !registers)
+        VM_PrintProfile(virtualMachine.profile);
 
-void startThread(){
-    pthread_t thread1;
-    pthread_create(&thread1, NULL, parseTask, (void *)"stackoverflow.cynep");
-    pthread_join(thread1, NULL);
+    // Collections, pauses and what they gave back
+    if (gcstats)
+        gc_print_stats();
 }
-
-#pragma endregion
\ No newline at end of file
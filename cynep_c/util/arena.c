@@ -3,24 +3,114 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 typedef struct Arena Arena;
+typedef struct ArenaMark ArenaMark;
 
-Arena* arena_create();
-void* arena_malloc(Arena *arena, size_t size);
+Arena* arena_create(size_t initial_size);
+Arena* arena_create_virtual(size_t reserve_size);
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment);
+ArenaMark arena_mark(Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
 void arena_destroy(Arena *arena);
 
+// Bump allocator made of a chain of blocks. The head caches the block currently allocated from,
+// so allocation is O(1). A virtual arena reserves address space up front and commits it in
+// ARENA_COMMIT_SIZE steps as it fills up, so it can grow large without ever moving or copying.
+
+#define ARENA_DEFAULT_ALIGNMENT 8
+#define ARENA_COMMIT_SIZE (2 * 1024 * 1024) // Also the huge page size
+
 struct Arena {
   uint8_t* region;
-  size_t capacity;
+  size_t capacity; // Reserved size for virtual blocks
   size_t used;
+  size_t committed; // Same as capacity for regular blocks
+  uint8_t* reservation; // Virtual blocks only, start of the mapping
   Arena* next;
+  Arena* tail; // Head only, the block we allocate from
+};
+
+// Everything allocated after a mark is freed by releasing it
+struct ArenaMark {
+  Arena* block;
+  size_t used;
 };
 
+#pragma region OS
+
+static void* _arena_reserve(size_t size) {
+#ifdef _WIN32
+  return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+  void* region = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return region == MAP_FAILED ? NULL : region;
+#endif
+}
+
+static bool _arena_commit(void* start, size_t size) {
+#ifdef _WIN32
+  return VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+  if(mprotect(start, size, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+
+#ifdef MADV_HUGEPAGE
+  // Transparent huge pages where the kernel has them, ignored otherwise
+  madvise(start, size, MADV_HUGEPAGE);
+#endif
+
+  return true;
+#endif
+}
+
+static void _arena_unreserve(void* reservation, size_t size) {
+#ifdef _WIN32
+  VirtualFree(reservation, 0, MEM_RELEASE);
+#else
+  munmap(reservation, size);
+#endif
+}
+
+#pragma endregion
+
 static Arena* _arena_create(size_t size) {
   Arena* arena = malloc(sizeof(Arena));
   arena->region = malloc(size * sizeof(uint8_t));
   arena->capacity = size;
+  arena->committed = size;
+  arena->reservation = NULL;
   arena->next = NULL;
+  arena->tail = arena;
+  arena->used = 0;
+
+  return arena;
+}
+
+static Arena* _arena_create_virtual(size_t size) {
+  size = (size + ARENA_COMMIT_SIZE - 1) & ~(size_t)(ARENA_COMMIT_SIZE - 1);
+
+  // One extra huge page so the region can start on a huge page boundary
+  uint8_t* reservation = _arena_reserve(size + ARENA_COMMIT_SIZE);
+
+  if(reservation == NULL) {
+    return _arena_create(ARENA_COMMIT_SIZE);
+  }
+
+  Arena* arena = malloc(sizeof(Arena));
+  arena->region = (uint8_t*)(((uintptr_t)reservation + ARENA_COMMIT_SIZE - 1) & ~(uintptr_t)(ARENA_COMMIT_SIZE - 1));
+  arena->capacity = size;
+  arena->committed = 0;
+  arena->reservation = reservation;
+  arena->next = NULL;
+  arena->tail = arena;
   arena->used = 0;
 
   return arena;
@@ -30,41 +120,111 @@ Arena* arena_create(size_t initial_size) {
   return _arena_create(initial_size);
 }
 
-void* arena_alloc(Arena* arena, size_t size) {
-  Arena* last = arena;
-  Arena* temp = arena;
+Arena* arena_create_virtual(size_t reserve_size) {
+  return _arena_create_virtual(reserve_size);
+}
 
-  while(temp != NULL) { 
-      last = temp;
-      temp = temp->next;
+// Offset of the first byte in block aligned to alignment, which must be a power of two
+static inline size_t _arena_align(Arena* block, size_t alignment) {
+  uintptr_t current = (uintptr_t)block->region + block->used;
+  uintptr_t aligned = (current + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+  return aligned - (uintptr_t)block->region;
+}
+
+static void _arena_grow_commit(Arena* block, size_t end) {
+  size_t committed = (end + ARENA_COMMIT_SIZE - 1) & ~(size_t)(ARENA_COMMIT_SIZE - 1);
+
+  if(!_arena_commit(block->region + block->committed, committed - block->committed)) {
+    printf("\033[0;31mArena: Out of memory \033[0m\n");
+    exit(0);
   }
 
-  // We could do this check for every node, but we mostly allocate same size elements anyway.
-  // Hence it would probably never find a slot in a block that it didn't previously.
-  size_t remaining = last->capacity - last->used;
-  
-  if(remaining >= size) {
-    last->used += size;
-    return &last->region[last->used - size];
+  block->committed = committed;
+}
+
+void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment) {
+  Arena* block = arena->tail;
+
+  while(true) {
+    size_t start = _arena_align(block, alignment);
+
+    if(start + size <= block->capacity) {
+      if(start + size > block->committed) {
+        _arena_grow_commit(block, start + size);
+      }
+
+      block->used = start + size;
+      arena->tail = block;
+
+      return &block->region[start];
+    }
+
+    // Reuse blocks left over from a release
+    if(block->next != NULL) {
+      block = block->next;
+      block->used = 0;
+      continue;
+    }
+
+    break;
   }
 
-  size_t allocation_size = size > last->capacity ? size : last->capacity * 2;
+  Arena* next;
+
+  if(block->reservation != NULL) {
+    next = _arena_create_virtual(size + alignment > block->capacity ? size + alignment : block->capacity);
+  }
+  else {
+    next = _arena_create(size + alignment > block->capacity * 2 ? size + alignment : block->capacity * 2);
+  }
 
-  Arena* next = _arena_create(allocation_size);
+  block->next = next;
+  arena->tail = next;
 
-  last->next = next;
-  next->used += size;
+  size_t start = _arena_align(next, alignment);
 
-  return next->region;
+  if(start + size > next->committed) {
+    _arena_grow_commit(next, start + size);
+  }
+
+  next->used = start + size;
+
+  return &next->region[start];
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+  return arena_alloc_aligned(arena, size, ARENA_DEFAULT_ALIGNMENT);
+}
+
+ArenaMark arena_mark(Arena* arena) {
+  ArenaMark mark;
+  mark.block = arena->tail;
+  mark.used = arena->tail->used;
+
+  return mark;
+}
+
+// Frees everything allocated since mark. Later blocks are kept and reused.
+void arena_release(Arena* arena, ArenaMark mark) {
+  mark.block->used = mark.used;
+  arena->tail = mark.block;
 }
 
 void arena_destroy(Arena *arena) {
   Arena *next, *last = arena;
   do {
     next = last->next;
-    free(last->region);
+
+    if(last->reservation != NULL) {
+      _arena_unreserve(last->reservation, last->capacity + ARENA_COMMIT_SIZE);
+    }
+    else {
+      free(last->region);
+    }
+
     free(last);
     last = next;
-  } 
+  }
   while(next != NULL);
-}
\ No newline at end of file
+}
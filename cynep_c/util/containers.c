@@ -84,6 +84,8 @@ DOCUMENTATION
 
 #pragma once
 
+#include <stddef.h>
+
 #define array_length    stbds_arrlen
 #define arrlenu         stbds_arrlenu
 #define array_push      stbds_arrput
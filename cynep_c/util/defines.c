@@ -4,6 +4,7 @@
 #define float64 double
 #define int64 int64_t
 #define uint64 uint64_t
+#define uint32 uint32_t
 #define uint8  uint8_t
 
 #define u8  uint8_t
@@ -1,7 +1,15 @@
 #pragma once
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
 int64 timestamp() {
     struct timeval tv;
+#ifdef _WIN32
     mingw_gettimeofday(&tv,NULL);
+#else
+    gettimeofday(&tv,NULL);
+#endif
     return tv.tv_sec*(uint64_t)1000000+tv.tv_usec;
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #pragma once
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 typedef struct TextFile TextFile;
 
 struct TextFile {
     size_t length;
-    char* buffer;
+    char* buffer; // Always null terminated
     char* path;
+    bool mapped; // Buffer is a read only file mapping
 };
 
 TextFile* read_entire_file(char* filename) {
@@ -34,9 +44,113 @@ TextFile* read_entire_file(char* filename) {
     return_file->buffer = contents;
     return_file->path = filename;
     return_file->length = size;
- 
+    return_file->mapped = false;
+
     int64 t2 = timestamp();
     printf("File read: %d ms\n", t2/1000-t1/1000);
 
     return return_file;
-}
\ No newline at end of file
+}
+
+// Maps the file read only instead of copying it. Falls back to read_entire_file when mapping is not possible.
+// The lexer relies on a null terminator, so the mapping is followed by at least one zero byte.
+TextFile* map_entire_file(char* filename) {
+    int64 t1 = timestamp();
+
+    char* contents = NULL;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    LARGE_INTEGER file_size;
+
+    if(handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &file_size)) {
+        return read_entire_file(filename);
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size = file_size.QuadPart;
+
+    // The view is zero filled up to the next page, unless the file ends exactly on a page boundary.
+    if(size == 0 || size % info.dwPageSize == 0) {
+        CloseHandle(handle);
+        return read_entire_file(filename);
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+
+    if(mapping == NULL) {
+        return read_entire_file(filename);
+    }
+
+    contents = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if(contents == NULL) {
+        return read_entire_file(filename);
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+
+    if(fd == -1 || fstat(fd, &st) == -1) {
+        if(fd != -1) close(fd);
+        return read_entire_file(filename);
+    }
+
+    size = st.st_size;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t reserved = (size / page_size + 1) * page_size;
+
+    // Reserve zeroed pages for the file plus the terminator, then map the file over the start.
+    // Bytes past the end of the file in its last page read as zero as well.
+    char* region = mmap(NULL, reserved, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(region == MAP_FAILED) {
+        close(fd);
+        return read_entire_file(filename);
+    }
+
+    if(size > 0) {
+        if(mmap(region, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(region, reserved);
+            close(fd);
+            return read_entire_file(filename);
+        }
+
+        madvise(region, size, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+    contents = region;
+#endif
+
+    TextFile* return_file = malloc(sizeof(TextFile));
+    return_file->buffer = contents;
+    return_file->path = filename;
+    return_file->length = size;
+    return_file->mapped = true;
+
+    int64 t2 = timestamp();
+    printf("File map: %d ms\n", t2/1000-t1/1000);
+
+    return return_file;
+}
+
+// Line and column (both starting at 1) of a byte offset. Only meant for error reporting.
+void source_location(TextFile* file, size_t offset, size_t* line, size_t* column) {
+    *line = 1;
+    *column = 1;
+
+    for (size_t i = 0; i < offset && i < file->length; i++) {
+        if(file->buffer[i] == '\n') {
+            (*line)++;
+            *column = 1;
+        }
+        else {
+            (*column)++;
+        }
+    }
+}
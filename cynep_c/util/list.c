@@ -43,4 +43,24 @@ ListNode* listNode_create(ListNode* node, void* value) {
     node->value = value;
 
     return node;
-}
\ No newline at end of file
+}
+
+// Moves all nodes of other to the end of list, leaving other empty
+void list_concat(List* list, List* other) {
+    if(other->first == NULL){
+        return;
+    }
+
+    if(list->first == NULL){
+        list->first = other->first;
+    }
+    else{
+        list->last->next = other->first;
+        other->first->prev = list->last;
+    }
+
+    list->last = other->last;
+    list->count += other->count;
+
+    list_create(other);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <sched.h>
+
+typedef struct Ring Ring;
+
+// Bounded single producer, single consumer queue of 64 bit values. Lock free, each side only ever
+// writes its own index. Both sides spin with a yield when the ring is full or empty.
+
+#define RING_CAPACITY 256 // Power of two
+#define RING_MASK (RING_CAPACITY - 1)
+
+struct Ring {
+    uint64 slots[RING_CAPACITY];
+    _Alignas(64) _Atomic size_t head; // Next slot to read, written by the consumer
+    _Alignas(64) _Atomic size_t tail; // Next slot to write, written by the producer
+    _Atomic bool closed;
+};
+
+Ring* ring_create() {
+    Ring* ring = malloc(sizeof(Ring));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, false);
+
+    return ring;
+}
+
+void ring_push(Ring* ring, uint64 value) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    while(tail - atomic_load_explicit(&ring->head, memory_order_acquire) == RING_CAPACITY) {
+        sched_yield();
+    }
+
+    ring->slots[tail & RING_MASK] = value;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+// No more pushes after this
+void ring_close(Ring* ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+bool ring_try_pop(Ring* ring, uint64* value) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if(head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+        return false;
+    }
+
+    *value = ring->slots[head & RING_MASK];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+// Waits for a value. Returns false once the ring is closed and drained.
+bool ring_pop(Ring* ring, uint64* value) {
+    while(!ring_try_pop(ring, value)) {
+        if(atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            // Values pushed right before closing
+            return ring_try_pop(ring, value);
+        }
+
+        sched_yield();
+    }
+
+    return true;
+}
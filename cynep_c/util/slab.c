@@ -0,0 +1,159 @@
+#pragma once
+
+#include <pthread.h>
+
+typedef struct SlabClass SlabClass;
+typedef struct SlabCache SlabCache;
+typedef struct SlabBlock SlabBlock;
+
+void* slab_alloc(size_t size);
+void slab_free(void* memory, size_t size);
+
+// Size class allocator for small objects. Every class hands out blocks of one size, carved out of
+// SLAB_SIZE chunks and recycled through a free list. Each thread allocates from its own cache of free
+// blocks without locking. It only takes the lock of a class to fetch SLAB_BATCH blocks when its cache is
+// empty, or to give SLAB_BATCH back when it holds too many. Sizes above the largest class go to malloc.
+// Chunks are never given back to the system, freed blocks stay with their class.
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_BATCH 32
+#define SLAB_SMALL_LIMIT 256 // Classes up to here are 16 bytes apart
+#define SLAB_CLASS_COUNT 20
+
+static const uint32_t _slab_sizes[SLAB_CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240, 256,
+    384, 512, 768, 1024
+};
+
+struct SlabBlock {
+    SlabBlock* next;
+};
+
+// Shared by all threads
+struct SlabClass {
+    pthread_mutex_t lock;
+    SlabBlock* free;
+    uint8_t* top; // Next unused block of the newest chunk
+    uint8_t* end;
+};
+
+struct SlabCache {
+    SlabBlock* free[SLAB_CLASS_COUNT];
+    uint32_t count[SLAB_CLASS_COUNT];
+};
+
+static SlabClass _slab_classes[SLAB_CLASS_COUNT] = {
+    [0 ... SLAB_CLASS_COUNT - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER, .free = NULL, .top = NULL, .end = NULL }
+};
+
+static __thread SlabCache _slab_cache;
+
+// Off sends everything to malloc and free, for comparing the two
+bool _slab_enabled = true;
+
+static inline size_t _slab_class(size_t size){
+    if(size <= SLAB_SMALL_LIMIT){
+        return size == 0 ? 0 : (size - 1) >> 4;
+    }
+
+    size_t index = SLAB_SMALL_LIMIT / 16;
+
+    while(_slab_sizes[index] < size){
+        index++;
+    }
+
+    return index;
+}
+
+// Moves up to SLAB_BATCH blocks from the shared class into the cache of this thread
+static void _slab_refill(size_t index){
+    SlabClass* class = &_slab_classes[index];
+    size_t size = _slab_sizes[index];
+
+    SlabBlock* list = _slab_cache.free[index];
+    uint32_t count = _slab_cache.count[index];
+
+    pthread_mutex_lock(&class->lock);
+
+    for (size_t i = 0; i < SLAB_BATCH; i++) {
+        SlabBlock* block = class->free;
+
+        if(block != NULL){
+            class->free = block->next;
+        }
+        else{
+            if(class->top == class->end){
+                class->top = malloc(SLAB_SIZE);
+                class->end = class->top + (SLAB_SIZE / size) * size;
+            }
+
+            block = (SlabBlock*)class->top;
+            class->top += size;
+        }
+
+        block->next = list;
+        list = block;
+        count++;
+    }
+
+    pthread_mutex_unlock(&class->lock);
+
+    _slab_cache.free[index] = list;
+    _slab_cache.count[index] = count;
+}
+
+// Gives SLAB_BATCH blocks of the cache back to the shared class
+static void _slab_flush(size_t index){
+    SlabClass* class = &_slab_classes[index];
+
+    SlabBlock* first = _slab_cache.free[index];
+    SlabBlock* last = first;
+
+    for (size_t i = 1; i < SLAB_BATCH; i++) {
+        last = last->next;
+    }
+
+    _slab_cache.free[index] = last->next;
+    _slab_cache.count[index] -= SLAB_BATCH;
+
+    pthread_mutex_lock(&class->lock);
+    last->next = class->free;
+    class->free = first;
+    pthread_mutex_unlock(&class->lock);
+}
+
+void* slab_alloc(size_t size){
+    if(size > _slab_sizes[SLAB_CLASS_COUNT - 1] || !_slab_enabled){
+        return malloc(size);
+    }
+
+    size_t index = _slab_class(size);
+
+    if(_slab_cache.free[index] == NULL){
+        _slab_refill(index);
+    }
+
+    SlabBlock* block = _slab_cache.free[index];
+    _slab_cache.free[index] = block->next;
+    _slab_cache.count[index]--;
+
+    return block;
+}
+
+// size has to be the one memory was allocated with
+void slab_free(void* memory, size_t size){
+    if(size > _slab_sizes[SLAB_CLASS_COUNT - 1] || !_slab_enabled){
+        free(memory);
+        return;
+    }
+
+    size_t index = _slab_class(size);
+
+    SlabBlock* block = memory;
+    block->next = _slab_cache.free[index];
+    _slab_cache.free[index] = block;
+
+    if(++_slab_cache.count[index] > 2 * SLAB_BATCH){
+        _slab_flush(index);
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+typedef uint32 Symbol;
+typedef struct SymbolTable SymbolTable;
+
+// Global intern table. Every distinct identifier and string literal is stored once and
+// gets a stable id, so later phases compare symbols instead of strings.
+
+struct SymbolTable {
+    Table lookup; // Name -> symbol
+    char** names; // Symbol -> name
+    Arena* arena; // Storage for the names
+};
+
+SymbolTable _symbols;
+bool _symbols_initialized = false;
+
+// Keywords are interned first so the lexer can map them to token types by id.
+char* _keywords[] = { "type", "var", "if", "else", "while", "func", "return", "const" };
+
+#define KEYWORD_COUNT (sizeof(_keywords) / sizeof(_keywords[0]))
+
+Symbol symbol_intern(char* start, size_t length);
+
+static void _symbols_init() {
+    _symbols_initialized = true;
+
+    table_init(&_symbols.lookup);
+    _symbols.names = NULL;
+    _symbols.arena = arena_create(4096);
+
+    for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+        symbol_intern(_keywords[i], strlen(_keywords[i]));
+    }
+}
+
+// Interns the first length bytes of start.
+Symbol symbol_intern(char* start, size_t length) {
+    if(!_symbols_initialized) {
+        _symbols_init();
+    }
+
+    int64 existing = table_get_span(&_symbols.lookup, start, length);
+
+    if(existing != -1) {
+        return (Symbol)existing;
+    }
+
+    char* name = arena_alloc_aligned(_symbols.arena, length + 1, 1);
+    memcpy(name, start, length);
+    name[length] = NULL_CHAR;
+
+    Symbol symbol = array_length(_symbols.names);
+    array_push(_symbols.names, name);
+    table_set(&_symbols.lookup, name, symbol);
+
+    return symbol;
+}
+
+Symbol symbol_intern_string(char* str) {
+    return symbol_intern(str, strlen(str));
+}
+
+char* symbol_name(Symbol symbol) {
+    return _symbols.names[symbol];
+}
+
+bool symbol_is_keyword(Symbol symbol) {
+    return symbol < KEYWORD_COUNT;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+typedef struct TableEntry TableEntry;
+typedef struct Table Table;
+
+// Open addressing hash table with linear probing. Maps string or integer keys to int64 values.
+// Lookups return -1 when the key is missing. Entries are never removed, overwrite them instead.
+
+struct TableEntry {
+    char* key; // NULL for integer keys
+    uint64 hash; // The key itself for integer keys
+    int64 value;
+    bool used;
+};
+
+struct Table {
+    TableEntry* entries;
+    size_t count;
+    size_t capacity; // Always a power of two
+};
+
+#define TABLE_MIN_CAPACITY 16
+
+// FNV-1a
+uint64 hash_bytes(char* start, size_t length) {
+    uint64 hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)start[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint64 hash_string(char* str) {
+    return hash_bytes(str, strlen(str));
+}
+
+// Spreads integer keys over the slots, they are often small and sequential.
+static inline uint64 _table_mix(uint64 x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+Table* table_init(Table* table) {
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+
+    return table;
+}
+
+void table_free(Table* table) {
+    free(table->entries);
+    table_init(table);
+}
+
+// String keys are compared against the first length bytes of key, so key does not need to be null terminated.
+static TableEntry* _table_find(TableEntry* entries, size_t capacity, char* key, size_t length, uint64 hash) {
+    size_t mask = capacity - 1;
+    size_t index = (key ? hash : _table_mix(hash)) & mask;
+
+    while(true) {
+        TableEntry* entry = &entries[index];
+
+        if(!entry->used) {
+            return entry;
+        }
+
+        if(entry->hash == hash) {
+            if(key == NULL && entry->key == NULL) {
+                return entry;
+            }
+            if(key != NULL && entry->key != NULL && strncmp(entry->key, key, length) == 0 && entry->key[length] == NULL_CHAR) {
+                return entry;
+            }
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+static void _table_grow(Table* table) {
+    size_t capacity = table->capacity < TABLE_MIN_CAPACITY ? TABLE_MIN_CAPACITY : table->capacity * 2;
+    TableEntry* entries = calloc(capacity, sizeof(TableEntry));
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        TableEntry* entry = &table->entries[i];
+
+        if(entry->used) {
+            *_table_find(entries, capacity, entry->key, entry->key ? strlen(entry->key) : 0, entry->hash) = *entry;
+        }
+    }
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+static int64 _table_get(Table* table, char* key, size_t length, uint64 hash) {
+    if(table->count == 0) {
+        return -1;
+    }
+
+    TableEntry* entry = _table_find(table->entries, table->capacity, key, length, hash);
+
+    return entry->used ? entry->value : -1;
+}
+
+static void _table_set(Table* table, char* key, size_t length, uint64 hash, int64 value) {
+    // Keep load factor below 1/2
+    if((table->count + 1) * 2 > table->capacity) {
+        _table_grow(table);
+    }
+
+    TableEntry* entry = _table_find(table->entries, table->capacity, key, length, hash);
+
+    if(!entry->used) {
+        entry->used = true;
+        entry->key = key;
+        entry->hash = hash;
+        table->count++;
+    }
+
+    entry->value = value;
+}
+
+int64 table_get(Table* table, char* key) {
+    size_t length = strlen(key);
+    return _table_get(table, key, length, hash_bytes(key, length));
+}
+
+// Looks up the first length bytes of key.
+int64 table_get_span(Table* table, char* key, size_t length) {
+    return _table_get(table, key, length, hash_bytes(key, length));
+}
+
+// The table keeps the key pointer, it must be null terminated and outlive the table.
+void table_set(Table* table, char* key, int64 value) {
+    size_t length = strlen(key);
+    _table_set(table, key, length, hash_bytes(key, length), value);
+}
+
+int64 table_get_int(Table* table, uint64 key) {
+    return _table_get(table, NULL, 0, key);
+}
+
+void table_set_int(Table* table, uint64 key, int64 value) {
+    _table_set(table, NULL, 0, key, value);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdatomic.h>
+
+typedef struct ThreadPool ThreadPool;
+typedef void (*ThreadJob)(void* context, size_t job, size_t worker);
+
+// Minimal fork/join pool. Workers pull job indices from a shared counter until all jobs are taken,
+// the calling thread works as worker 0. The worker index lets jobs use per thread resources.
+
+struct ThreadPool {
+    ThreadJob job;
+    void* context;
+    size_t job_count;
+    _Atomic size_t next_job;
+};
+
+typedef struct ThreadWorker ThreadWorker;
+
+struct ThreadWorker {
+    ThreadPool* pool;
+    size_t index;
+};
+
+size_t cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+#endif
+}
+
+static void* _thread_worker(void* argument) {
+    ThreadWorker* worker = argument;
+    ThreadPool* pool = worker->pool;
+
+    while(true) {
+        size_t job = atomic_fetch_add_explicit(&pool->next_job, 1, memory_order_relaxed);
+
+        if(job >= pool->job_count) {
+            break;
+        }
+
+        pool->job(pool->context, job, worker->index);
+    }
+
+    return NULL;
+}
+
+// Runs job(context, i, worker) for every i below job_count and waits for all of them.
+void parallel_for(size_t job_count, size_t worker_count, ThreadJob job, void* context) {
+    ThreadPool pool;
+    pool.job = job;
+    pool.context = context;
+    pool.job_count = job_count;
+    atomic_init(&pool.next_job, 0);
+
+    if(worker_count < 1) worker_count = 1;
+    if(worker_count > job_count) worker_count = job_count > 0 ? job_count : 1;
+
+    pthread_t threads[worker_count];
+    ThreadWorker workers[worker_count];
+
+    for (size_t i = 0; i < worker_count; i++) {
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+
+    for (size_t i = 1; i < worker_count; i++) {
+        pthread_create(&threads[i], NULL, _thread_worker, &workers[i]);
+    }
+
+    _thread_worker(&workers[0]);
+
+    for (size_t i = 1; i < worker_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}